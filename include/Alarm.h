@@ -4,71 +4,120 @@
 #define Alarm_H_
 
 
-#include "Network.h"
+#include "Hal.h"
 #include "RealTime.h"
 #include "Display.h"
 #include "Sound.h"
+#include "Power.h"
+#include "AlarmTable.h"
+#include "AlarmCalendar.h"
+#include "AlarmStore.h"
+#include "TaskScheduler.h"
+#include "Buttons.h"
+#include "Histogram.h"
+#include "Uplink.h"
+#include "LocalApi.h"
+#include "HouseSync.h"
 
 using std::vector;
 
-class AlarmItem;
+const uint32_t SECONDS_PER_DAY = 86400;
+
+// Boot Stages, Clock Comes Up First and the Rest Follows in the Background
+enum BootStage {
+    BOOT_CLOCK, // Display and RTC Up
+    BOOT_AUDIO, // Waiting on the DFPlayer
+    BOOT_CLOUD, // Alarms can Ring, Waiting on Firebase
+    BOOT_DONE
+};
 
 class Alarm {
     private:
         long lastPressed = 0; // When button to turn off alarm was last pressed
-        vector<AlarmItem> alarms; // Will be an array of alarms
+        AlarmTable alarms; // Every Alarm, Slots are Reused in Place
+        AlarmCalendar calendar; // Alarm Rules Compiled for the Loop
+        bool rulesChanged = true; // Calendar is Recompiled before it's Next Used
+        uint32_t nextMinute = 0; // First Epoch Minute the Weekday Rules haven't been Checked for
+        AlarmStore store; // Last Synced Alarms in Flash
+
+        uint32_t ringStopAt = 0; // When the Current Alarm Stops Ringing on its Own
+        uint32_t ringStartedAt = 0; // When the Current Alarm Started Ringing, for how Long it Rang
+        uint32_t lastSetSeq = 0; // Sequence of the Last Full Alarm Set, Older Patches are Stale
 
 
         int alarmStopPin = 12; // Gray
 
+        // Boot Timing
+        BootStage bootStage = BOOT_CLOCK;
+        unsigned long bootStarted = 0;
+        unsigned long firstFrameAt = 0; // When the Clock was First Drawn
+        unsigned long alarmReadyAt = 0; // When an Alarm could First Ring
+
+        // Serial Console
+        String serialLine; // Characters Typed since the Last Newline
+        bool pushLoopStats = false; // Also Upload Loop Stats to Firebase with Every Stats Print
+
     public:
-        Alarm();
+        Alarm(Hal &hal);
         ~Alarm();
 
+        // Hardware (Real on the ESP32, Fakes on the Native Build)
+        Hal &hal;
+
         // Public Alarm Components
-        Network *network;
         RealTime *rtc;
         Display *display;
         Sound *sound;
+        Power *power;
+        LocalApi *localApi;
+        HouseSync *houseSync;
+
+        // Runs Every Component's Loop when it is Due
+        TaskScheduler scheduler;
+        Buttons buttons; // Debounced Button Events for Every Component
+        Uplink uplink; // Device State Batched up for Firebase
+        Histogram stopLatency; // Microseconds from Stop Button Press to the Player Stopping
+        Histogram fireLateness; // Milliseconds an Alarm Started Ringing after its Time
+        uint16_t alarmsDropped = 0; // Alarms the Last Full Sync Sent that didn't Fit the Table
+        int volumeTask = -1; // Volume Display Task, Sound Pulls it Forward on Button Presses
+        int alarmTask = -1; // Alarm Check Task, Power Pulls it Forward when an Alarm is Due
 
         // Tracks Current Alarm
-        AlarmItem *currentAlarm = nullptr;
+        AlarmHandle currentAlarm; // None when Nothing is Ringing
         int maxRingTime = 60;
 
         void initAll(); // Initializes All Alarm Components 
         void updateAll(); // Updates All Alarm Components
+        void updateBoot(); // Tracks Background Bring-Up and Reports how Long Each Stage Took
+        bool isBooted() { return bootStage == BOOT_DONE; }
+        const AlarmItem *getRingingAlarm() { return alarms.get(currentAlarm); } // nullptr when Nothing is Ringing
+        AlarmTable &getAlarms() { return alarms; } // Only Changed through the Alarm Functions Below
+        void checkSerial(); // Answers Commands Typed into the Serial Monitor
+        void printStats(); // Prints Loop, LCD and Clock Statistics
 
         void initAlarm(); // Loads Alarms
         void updateAlarm();  // Runs Alarm Loop - Checks for Alarms
+        int64_t microsUntilNextAlarm(); // Microseconds until the Earliest Scheduled Alarm (-1 if None)
+        void onStopButton(const ButtonEvent& event); // Turns off Alarm when the Stop Button Goes Down
         
-        void addAlarm(RtcDateTime time); // Add New Alarm to Ring at Time
-        void syncAlarms(FirebaseJsonArray& arr); // Syncs Alarms from Firebase
-
-        void runAlarm(AlarmItem& alarmItem); // Fires Alarm Item & Rings
-
-        void stopAlarm(AlarmItem& alarmItem); // Stops Specific Alarm
-        bool turnOffAlarm(); // Turns off Alarm when button pressed.
-};
-
-class AlarmItem {
-    public:
-        RtcDateTime time;
-
-        int hour;
-        int minute;
-        String id;
-        bool active;
-        
-        bool hasRang = false;
-        bool currentlyRinging = false;
-
-
-        AlarmItem(RtcDateTime time) : time(time) {};
-        AlarmItem(RtcDateTime time, bool hasRang) : time(time), hasRang(hasRang) {};
-
-        AlarmItem(RtcDateTime now, int hour, int minute, String id, bool active) : hour(hour), minute(minute), id(id), active(active) {
-            time = RtcDateTime(now.Year(), now.Month(), now.Day(), hour, minute, 0);
-        };
+        void addAlarm(uint32_t time); // Add New Alarm to Ring at Time (Epoch Seconds)
+        void syncAlarms(const AlarmSet& set); // Syncs Alarms from Firebase
+        void saveAlarms(); // Writes Keyed Alarms (from Firebase or the LAN) to Flash if they Changed
+        void applyCloudUpdates(); // Applies Alarm Changes Handed Over by the Network Task
+        void applyAlarmPatch(const AlarmPatch& patch); // Adds, Updates or Removes One Alarm
+        void applyLocalEdit(const AlarmPatch& patch); // LAN Edit, Armed and Saved before it Returns
+        int newAlarm(const AlarmPatch& record); // Alarm from its Rules, -1 if Full
+        uint32_t nextDateOf(int hour, int minute); // Epoch Day hour:minute Comes Next, for One-Shots Sent without a Date
+        uint8_t soundOf(const AlarmPatch& patch); // Sound Number, Looked Up if it was Sent by Name
+        void removeAlarm(int slot); // Removes Alarm in Slot, Stopping it if it's Ringing
+
+        void runAlarm(AlarmItem& alarmItem, uint32_t fireAt); // Fires Alarm Item & Rings, Together with the House if it's Shared
+        void startRing(AlarmItem& alarmItem, uint32_t fireAt); // Starts Ringing Right Now, Replacing Whatever Rings
+        void fireAlarm(int slot, uint32_t fireAt, uint32_t now); // Rings One Occurrence, Unless it's Skipped or Too Late
+        void refreshCalendar(); // Recompiles the Calendar if the Rules Changed
+
+        void stopAlarm(AlarmItem& alarmItem, StopReason reason); // Stops Specific Alarm
+        bool turnOffAlarm(StopReason reason = STOP_DISMISSED); // Turns off Alarm when button pressed.
 };
 
 #endif
\ No newline at end of file
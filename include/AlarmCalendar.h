@@ -0,0 +1,66 @@
+// Alarm Rules Compiled into a Week of Minutes
+// Weekday rules become bits in a minute-of-week map plus a list of their occurrences sorted by minute,
+// dated alarms become a list sorted by firing time. Both are rebuilt only when the rules change,
+// so the loop's checks are a bit test and a cached next time.
+
+#ifndef AlarmCalendar_H_
+#define AlarmCalendar_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <stddef.h>
+
+// Project Specific Headers
+#include "AlarmTable.h"
+
+const uint32_t MINUTES_PER_WEEK = 7 * 1440;
+const int WEEKLY_CAPACITY = MAX_ALARMS * 7; // Every Alarm on Every Day
+
+// Minute of the Week (Sunday 00:00 is 0) for Epoch Minutes
+inline uint32_t minuteOfWeek(uint32_t epochMinute)
+{
+    return (epochMinute + 4 * 1440) % MINUTES_PER_WEEK; // 1970-01-01 was a Thursday
+}
+
+// One Weekday Rule on One Day
+struct WeeklyOccurrence {
+    uint16_t minute; // Minute of the Week
+    int16_t slot;
+};
+
+// One Alarm on a Date, to the Second
+struct DatedOccurrence {
+    uint32_t fireAt; // Epoch Seconds
+    int16_t slot;
+};
+
+class AlarmCalendar {
+    private:
+        uint32_t occupied[MINUTES_PER_WEEK / 32]; // Bit per Minute of the Week Any Weekday Rule Fires in
+        WeeklyOccurrence weekly[WEEKLY_CAPACITY]; // Sorted by Minute
+        int weeklyCount = 0;
+        DatedOccurrence dated[MAX_ALARMS]; // Sorted by Firing Time
+        int datedCount = 0;
+        int datedNext = 0; // First Dated Occurrence not Taken Yet
+
+        // Next Weekly Firing, Good until Asked about a Time Past it
+        uint32_t cachedFrom = 1;
+        uint32_t cachedNext = 0;
+
+        int firstWeeklyAt(uint32_t minute) const; // Index of the First Occurrence at or after a Minute of the Week
+
+    public:
+        AlarmCalendar();
+
+        // Rebuilds Both Lists from the Active Alarms, Dated Ones that Already Rang are Left Out
+        void compile(AlarmTable &alarms);
+
+        bool isOccupied(uint32_t epochMinute) const; // Does Any Weekday Rule Fire in this Minute
+        int dueAt(uint32_t epochMinute, int16_t *slots, int maxSlots) const; // Slots Whose Weekday Rule Fires in this Minute
+        bool takeDue(uint32_t now, DatedOccurrence &occurrence); // Next Dated Occurrence at or before now, false if None
+
+        uint32_t nextFireAt(uint32_t from); // Earliest Firing at or after from (Epoch Seconds), 0 if Nothing is Set
+        int size() const { return weeklyCount + datedCount - datedNext; }
+};
+
+#endif
@@ -0,0 +1,31 @@
+// Reads Alarm JSON Straight from the Payload Text
+// Single pass, no DOM and no heap: records are filled as their fields go by,
+// and values the alarms don't use are skipped by counting brackets.
+
+#ifndef AlarmParser_H_
+#define AlarmParser_H_
+
+// Standard Libraries
+#include <stddef.h>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "AlarmTable.h"
+
+const size_t MAX_FIELD_TEXT = 40; // Longest Key or Value Kept, Longer Ones are Cut Off
+
+// Reads One Alarm Field into a Patch, Unknown Keys are Ignored
+// "hour", "minute", "id", "active", "sound" (Number or Name, see Sound.h), "days" (Weekday Mask, Bit 0 is Sunday),
+// "date" (YYYY-MM-DD, Rings Once then if days is 0, without it days 0 Rings Once at the Next hour:minute)
+// and "skip" (YYYY-MM-DD it Doesn't Ring on)
+void readAlarmField(const char *key, const char *value, AlarmPatch &patch);
+
+// Whole Alarm List, an Array (Keys are Indexes) or an Object of Alarms
+// Null holes and non-object entries are skipped, alarms past MAX_ALARMS are dropped and counted in set.dropped
+// Returns false if the payload isn't valid JSON
+bool parseAlarmList(const char *json, size_t length, AlarmSet &set);
+
+// One Alarm Object into a Patch, Returns false if it isn't an Object
+bool parseAlarm(const char *json, size_t length, AlarmPatch &patch);
+
+#endif
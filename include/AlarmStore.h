@@ -0,0 +1,33 @@
+// Keeps the Last Synced Alarms in Flash so They Ring without the Network
+
+#ifndef AlarmStore_H_
+#define AlarmStore_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <vector>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "AlarmTable.h"
+
+const size_t MAX_STORED_ALARMS = MAX_ALARMS;
+const size_t STORE_CHUNK = 32; // Records per Flash Record, NVS Needs Room for a Second Copy of One while Rewriting it
+
+// Alarms are Saved as a Header with a Version and CRC, then Fixed-Size Records in Chunks of STORE_CHUNK
+// Only chunks that changed are rewritten, and the header goes last so a save cut short fails the CRC
+class AlarmStore {
+    private:
+        Storage &storage;
+        std::vector<uint8_t> image; // What Flash Holds Now (Header then Records), so Unchanged Chunks are Never Rewritten
+
+        void encode(const AlarmSet &set, std::vector<uint8_t> &out);
+
+    public:
+        AlarmStore(Storage &storage);
+
+        bool load(AlarmSet &set); // Returns false if Nothing Valid is Stored
+        bool save(const AlarmSet &set); // Writes only if Different, Returns true if Flash was Written
+};
+
+#endif
@@ -0,0 +1,75 @@
+// Fixed-Capacity Table of Alarms, Updated in Place so the Alarm Path Never Touches the Heap
+
+#ifndef AlarmTable_H_
+#define AlarmTable_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <stddef.h>
+
+// Project Specific Headers
+#include "Hal.h"
+
+const int MAX_ALARMS = 256; // Shared Households and Several Users, about 15KB of Table
+
+// AlarmItem Flag Bits
+const uint8_t ALARM_USED = 1 << 0;      // Slot Holds an Alarm
+const uint8_t ALARM_ACTIVE = 1 << 1;
+const uint8_t ALARM_REPEATING = 1 << 2; // Rings on the Weekdays in days, Otherwise Once at fireAt
+const uint8_t ALARM_HAS_RANG = 1 << 3;
+const uint8_t ALARM_RINGING = 1 << 4;
+
+// One Alarm, Plain Data so Slots can be Cleared and Reused
+struct AlarmItem {
+    uint32_t fireAt; // Epoch Seconds a One-Shot Alarm Fires At
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t flags;
+    uint8_t generation; // Bumped Every Time the Slot is Freed, Old Handles Stop Matching
+    char key[ALARM_KEY_SIZE]; // Firebase Child Key
+    char id[ALARM_ID_SIZE];
+    uint8_t sound; // Ring Sequence
+    uint8_t days; // Weekday Mask of a Repeating Alarm, Bit 0 is Sunday
+    uint32_t skipDate; // Epoch Day a Repeating Alarm Doesn't Ring on, 0 if None
+
+    bool is(uint8_t flag) const { return (flags & flag) != 0; }
+    void set(uint8_t flag, bool on) { flags = on ? (flags | flag) : (flags & ~flag); }
+};
+
+// Stable Reference to an Alarm, Goes Stale once the Alarm is Removed
+struct AlarmHandle {
+    int16_t slot = -1;
+    uint8_t generation = 0;
+
+    bool isNone() const { return slot < 0; }
+};
+
+// Copies Text into a Fixed Field, Always Null Terminated
+void copyField(char *field, size_t size, const char *value);
+inline void copyField(char *field, size_t size, const String &value) { copyField(field, size, value.c_str()); }
+// Returns if a Fixed Field Holds value (as Cut Off to Fit)
+bool fieldEquals(const char *field, size_t size, const char *value);
+
+class AlarmTable {
+    private:
+        AlarmItem items[MAX_ALARMS];
+        int count = 0;
+
+    public:
+        AlarmTable();
+
+        int add(); // Claims a Cleared Slot, -1 if the Table is Full
+        void remove(int slot); // Frees the Slot, Handles to it Go Stale
+        void clear();
+
+        bool isUsed(int slot) const { return items[slot].is(ALARM_USED); }
+        AlarmItem &operator[](int slot) { return items[slot]; }
+
+        AlarmHandle handleOf(int slot) const;
+        AlarmItem *get(AlarmHandle handle); // nullptr if the Alarm is Gone
+        int find(const char *key) const; // Slot of the Alarm with Key, -1 if Missing
+
+        int size() const { return count; }
+};
+
+#endif
@@ -0,0 +1,67 @@
+// Queues Player Commands so the Loop Never Waits on the Player's Acks
+
+#ifndef AudioQueue_H_
+#define AudioQueue_H_
+
+// Standard Libraries
+#include <stdint.h>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "Histogram.h"
+
+const int AUDIO_QUEUE_SIZE = 4; // Commands Coalesce, so Only a Volume, a Playback and a Query Command are Ever Waiting
+const unsigned long AUDIO_ACK_TIMEOUT = 500; // Milliseconds before an Unanswered Command is Given Up On
+
+// Sends One Command at a Time and the Next Once it's Acked
+// Waiting volume commands merge into the newest one, a new playback command replaces a waiting one,
+// and stop goes out right away without waiting for the last ack. A query's answer counts as its ack.
+class AudioQueue {
+    private:
+        struct QueuedCommand {
+            AudioCommand command;
+            uint16_t argument;
+            bool retried; // Timed Out Once Already
+        };
+
+        AudioPlayer &player;
+        ClockSource &clock;
+
+        QueuedCommand queue[AUDIO_QUEUE_SIZE];
+        int count = 0;
+
+        bool awaitingAck = false;
+        QueuedCommand inFlight = {AUDIO_STOP, 0, false};
+        int64_t sentAt = 0;
+
+        // Statistics
+        Histogram ackLatency; // Microseconds from Sending to the Ack
+        uint32_t sent = 0;
+        uint32_t coalesced = 0; // Commands Merged into One Already Waiting
+        uint32_t timeouts = 0;
+        int maxDepth = 0;
+
+        void add(AudioCommand command, uint16_t argument); // Queues a Command, Merging it with One of its Kind
+        void removeAt(int index);
+        void sendNext(); // Sends the Oldest Command if the Player is Free
+        void transmit(const QueuedCommand &queued);
+
+    public:
+        AudioQueue(AudioPlayer &player, ClockSource &clock);
+
+        void volume(uint8_t volume); // 0-30
+        void loop(int track); // Plays a Track on Repeat
+        void playFolder(uint8_t folder, uint8_t track); // Plays SD:/folder/track.mp3 Once
+        void stop(); // Goes Ahead of Everything Waiting
+        void queryFiles(); // Answered with AUDIO_FILE_COUNT
+        void queryFolder(uint8_t folder); // Answered with AUDIO_FOLDER_COUNT, or AUDIO_ERROR if it's Missing
+
+        AudioEvent poll(int &value); // Next Player Event, Acks are Taken Here and Never Returned
+        void update(); // Gives Up on Late Acks and Sends what's Next
+        bool isIdle(); // Nothing Waiting or Unacked
+
+        void printStats(); // Prints Commands Sent, Merged and Timed Out, and Ack Latency
+        void resetStats();
+};
+
+#endif
@@ -0,0 +1,57 @@
+// Turns Raw Button Edges into Debounced Press Events
+
+#ifndef Buttons_H_
+#define Buttons_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// Project Specific Headers
+#include "Hal.h"
+
+const int64_t DEBOUNCE_MICROS = 30000;    // Edges this Soon after a Change are Contact Bounce
+const int64_t LONG_PRESS_MICROS = 800000; // Held this Long Counts as a Long Press
+
+enum ButtonEventType {
+    BUTTON_PRESS, // Went Down, Sent Right Away so Actions Aren't Held Up by Classification
+    BUTTON_SHORT, // Released before a Long Press
+    BUTTON_LONG   // Still Held after LONG_PRESS_MICROS
+};
+
+struct ButtonEvent {
+    ButtonEventType type;
+    int pin;
+    int64_t pressedAt; // micros() of the Edge that Started the Press
+};
+
+class Buttons {
+    private:
+        struct WatchedButton {
+            int pin;
+            std::function<void(const ButtonEvent &)> handler;
+
+            bool down = false;
+            bool longSent = false;
+            int64_t changedAt = 0; // When the Debounced State Last Changed
+            int64_t pressedAt = 0;
+        };
+
+        ButtonInput &input;
+        ClockSource &clock;
+        std::vector<WatchedButton> watched;
+
+        void change(WatchedButton &button, bool down, int64_t at); // Commits a Debounced State Change
+
+    public:
+        Buttons(ButtonInput &input, ClockSource &clock);
+
+        void watch(int pin, std::function<void(const ButtonEvent &)> handler); // Sets up the Pin and Sends its Events to handler
+        void update(); // Drains Captured Edges, Debounces them and Sends Events
+
+        bool isDown(int pin); // Debounced State
+        bool anyDown(); // Any Button Held, Long Press Timing Needs the Loop Awake
+};
+
+#endif
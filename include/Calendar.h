@@ -0,0 +1,27 @@
+// Converts Between Epoch Seconds and Calendar Dates
+
+#ifndef Calendar_H_
+#define Calendar_H_
+
+// Standard Libraries
+#include <stdint.h>
+
+// Broken Down Date and Time
+struct CivilTime {
+    uint16_t year;
+    uint8_t month;     // 1-12
+    uint8_t day;       // 1-31
+    uint8_t hour;      // 0-23
+    uint8_t minute;
+    uint8_t second;
+    uint8_t dayOfWeek; // 0 = Sunday
+
+    uint8_t hour12() const { return hour % 12 == 0 ? 12 : hour % 12; } // Hour on a 12 Hour Clock
+    bool isPM() const { return hour >= 12; }
+};
+
+CivilTime toCivil(uint32_t epoch); // Splits Epoch Seconds into a Date and Time
+uint32_t toEpoch(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second); // Joins a Date and Time into Epoch Seconds
+uint32_t parseCompileTime(const char *date, const char *time); // Reads __DATE__ and __TIME__ as Epoch Seconds
+
+#endif
@@ -3,16 +3,44 @@
 #ifndef Display_H_
 #define Display_H_
 
+// Standard Libraries
+#include <stdint.h>
+
+// Project Specific Headers
+#include "Calendar.h"
+
 class Alarm;
-class RtcDateTime;
+
+const int LCD_COLS = 16;
+const int LCD_ROWS = 2;
+
+// Bytes on the I2C Bus for One LCD Character or Command
+// The PCF8574 backpack sends each byte as two nibbles, each nibble as 3 expander writes of address + data
+const int I2C_BYTES_PER_LCD_WRITE = 12;
 
 class Display {
     private:
-        RtcDateTime getTimeInformation(); // Returns the Date and Time
+        CivilTime getTimeInformation(); // Returns the Date and Time
         void getWeatherInformation(); // Returns Weather Information
 
         Alarm *alarm;
 
+        // Shadow Framebuffer
+        char frame[LCD_ROWS][LCD_COLS]; // What Should be on Screen
+        char shown[LCD_ROWS][LCD_COLS]; // What the LCD is Actually Showing
+        int cursorCol = -1; // Where the LCD Cursor is (-1 when Unknown)
+        int cursorRow = -1;
+
+        // Flush Statistics
+        uint32_t i2cBytes = 0; // Since Last printStats
+        uint32_t flushCount = 0;
+        uint32_t flushMicros = 0;
+        uint32_t worstFlushMicros = 0;
+        unsigned long statsStarted = 0;
+
+        void printAt(int col, int row, const char *format, ...); // Draws Text into the Framebuffer
+        void flush(); // Sends Only Changed Cells to the LCD
+
     public:
         Display(Alarm &alarm);
 
@@ -24,6 +52,8 @@ class Display {
         void blinkScreen(); // Blinks when Alarm is Running
         void showVolume(); // Shows Volume
 
+        void printStats(); // Prints I2C Traffic and Flush Time
+
 };
 
 #endif
\ No newline at end of file
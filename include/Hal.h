@@ -0,0 +1,224 @@
+// Hardware Interfaces Used by the Alarm Logic
+// The ESP32 build backs these with real peripherals (HalEsp32.h, Network.h),
+// the native build backs them with in-memory fakes (src/native/FakeHal.h).
+
+#ifndef Hal_H_
+#define Hal_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <vector>
+
+// External Library Headers
+#include <Arduino.h>
+
+// Flags for Which Alarm Fields a Patch Carries
+const uint8_t PATCH_HOUR = 1 << 0;
+const uint8_t PATCH_MINUTE = 1 << 1;
+const uint8_t PATCH_ID = 1 << 2;
+const uint8_t PATCH_ACTIVE = 1 << 3;
+const uint8_t PATCH_SOUND = 1 << 4;
+const uint8_t PATCH_DAYS = 1 << 5;
+const uint8_t PATCH_DATE = 1 << 6;
+const uint8_t PATCH_SKIP = 1 << 7;
+
+const uint8_t EVERY_DAY = 0x7F; // Weekday Mask, Bit 0 is Sunday
+
+const size_t ALARM_KEY_SIZE = 21; // Null Terminated, Fits a 20 Character Firebase Push ID
+const size_t ALARM_ID_SIZE = 24; // Alarm Labels, Kept Short so a Household's Hundreds of Alarms Fit
+const size_t SOUND_NAME_SIZE = 12; // Ringtone Names like "gentle" or "02/003", see Sound.h
+
+// One Change to a Single Alarm, Taken from a Firebase Stream Event
+// Plain Data, so Copying it through the Handoff Never Allocates
+struct AlarmPatch {
+    // UPSERT Changes Only the Fields Sent, and Only on an Alarm the Table Already Holds
+    // REPLACE is a Whole Alarm, Fields not Sent go Back to their Defaults
+    enum Type { UPSERT, REPLACE, REMOVE };
+
+    Type type = UPSERT;
+    uint32_t seq = 0; // Order it was Published in, Older than the Latest Alarm Set Means Stale
+    char key[ALARM_KEY_SIZE] = {}; // Firebase Child Key of the Alarm (its Array Index)
+    uint8_t fields = 0; // Which of the Values Below were Sent
+
+    int hour = 0;
+    int minute = 0;
+    char id[ALARM_ID_SIZE] = {};
+    bool active = true;
+    uint8_t sound = 0; // Ring Sequence, see Sound.h
+    char soundName[SOUND_NAME_SIZE] = {}; // Sent as a Name Instead, Looked Up when it's Applied
+    uint8_t days = EVERY_DAY; // Weekdays it Rings on, 0 Rings Once on date
+    uint32_t date = 0;     // Epoch Day of a One-Shot Alarm
+    uint32_t skipDate = 0; // Epoch Day it Doesn't Ring on, 0 if None
+};
+
+// One LAN Edit on its Way to Firebase, so the Next Full Fetch doesn't Undo it
+const size_t ALARM_EDIT_SIZE = 192; // Whole Alarm as Firebase Keeps it, see LocalApi.cpp
+struct AlarmEdit {
+    char key[ALARM_KEY_SIZE] = {};
+    char json[ALARM_EDIT_SIZE] = {}; // "null" Deletes the Alarm
+};
+
+// Every Alarm from One Full Fetch
+struct AlarmSet {
+    uint32_t seq = 0;
+    std::vector<AlarmPatch> alarms; // One UPSERT per Alarm, Capacity is Kept Between Fetches
+    uint16_t dropped = 0; // Alarms past MAX_ALARMS that didn't Fit
+};
+
+// Monotonic Time, Waiting, and the Battery Backed RTC
+class ClockSource {
+    public:
+        virtual ~ClockSource() {}
+
+        virtual unsigned long millis() = 0;
+        virtual int64_t micros() = 0; // Microseconds since Boot, Never Wraps
+        virtual void delay(unsigned long ms) = 0; // Lets Other Tasks Run
+        virtual void lightSleep(unsigned long ms) = 0; // Sleeps the CPU, Wakes Early on a Button Press or Network Data
+        virtual uint32_t cycles() = 0; // Free-Running Cycle Counter for Timing Short Code, Wraps
+        virtual uint32_t cyclesPerMicro() = 0;
+
+        virtual void beginRtc() = 0; // Makes Sure the RTC is Running and Writable
+        virtual bool readRtc(uint32_t &epoch) = 0; // Returns false if the RTC Lost its Time
+        virtual void writeRtc(uint32_t epoch) = 0;
+};
+
+// 16x2 Character LCD
+class LcdDevice {
+    public:
+        virtual ~LcdDevice() {}
+
+        virtual void begin() = 0; // Initializes and Turns on the Backlight
+        virtual void clear() = 0;
+        virtual void setCursor(uint8_t col, uint8_t row) = 0;
+        virtual void write(char c) = 0;
+};
+
+// Events Reported by the Audio Player
+enum AudioEvent {
+    AUDIO_NONE,
+    AUDIO_ACK, // Last Command was Taken
+    AUDIO_PLAY_FINISHED,
+    AUDIO_CARD_INSERTED,
+    AUDIO_CARD_REMOVED,
+    AUDIO_ERROR,
+    AUDIO_FILE_COUNT,  // Answer to AUDIO_QUERY_FILES, value is the Count
+    AUDIO_FOLDER_COUNT // Answer to AUDIO_QUERY_FOLDER
+};
+
+// Commands the Player Takes
+enum AudioCommand {
+    AUDIO_VOLUME, // Argument 0-30
+    AUDIO_LOOP,   // Plays Track Argument on Repeat
+    AUDIO_PLAY_FOLDER, // Plays Track (Low Byte) from SD Folder (High Byte) Once
+    AUDIO_STOP,
+    AUDIO_QUERY_FILES, // Files on the SD Card
+    AUDIO_QUERY_FOLDER // Tracks in SD Folder Argument, a Missing Folder Answers with AUDIO_ERROR
+};
+
+// MP3 Player Module
+// send() never waits, the player answers each command with an AUDIO_ACK through poll(), and queries with their count
+class AudioPlayer {
+    public:
+        virtual ~AudioPlayer() {}
+
+        virtual void begin() = 0; // Starts Bringing the Player Online in the Background
+        virtual bool isOnline() = 0;
+
+        virtual void send(AudioCommand command, uint16_t argument) = 0; // Writes One Command, Only Once Online
+        virtual AudioEvent poll(int &value) = 0; // Returns the Next Event from the Player, AUDIO_NONE if Nothing
+};
+
+// One Raw Level Change on a Button Pin, Timestamped when it Happened
+struct ButtonEdge {
+    int pin;
+    bool pressed;
+    int64_t atMicros; // ClockSource::micros() Time
+};
+
+// Push Buttons (HIGH when Pressed)
+// Edges are captured as they happen (by interrupt on the ESP32), so presses during a slow loop aren't lost
+class ButtonInput {
+    public:
+        virtual ~ButtonInput() {}
+
+        virtual void setup(int pin) = 0; // Starts Capturing Edges on the Pin
+        virtual bool isPressed(int pin) = 0; // Level Right Now
+        virtual bool takeEdge(ButtonEdge &edge) = 0; // Oldest Captured Edge, false if None
+};
+
+// Small Named Records that Survive Power Loss
+class Storage {
+    public:
+        virtual ~Storage() {}
+
+        virtual size_t read(const char *key, void *data, size_t maxSize) = 0; // Returns Bytes Read, 0 if Missing
+        virtual bool write(const char *key, const void *data, size_t size) = 0;
+};
+
+// One NTP Exchange, the Server's Time at the Moment the Reply Arrived
+struct NtpSample {
+    int64_t epochMicros = 0; // Local Epoch Microseconds (Timezone Applied)
+    int64_t takenAt = 0;     // ClockSource::micros() when the Reply Arrived
+    uint32_t roundTrip = 0;  // Network Delay in Microseconds, Half of it Bounds the Error
+};
+
+// Where Alarms and Network Time Come From
+// start() may bring the connection up in the background, the take functions never block
+class CloudSource {
+    public:
+        virtual ~CloudSource() {}
+
+        virtual void start() = 0;
+        virtual bool isOnline() = 0;
+        virtual bool isBusy() = 0; // Connecting or Fetching, the CPU Shouldn't Sleep
+
+        virtual bool takeAlarmSet(AlarmSet &set) = 0; // Latest Full Alarm List, false if Nothing New
+        virtual bool takePatch(AlarmPatch &patch) = 0; // Next Single Alarm Change, false if None
+        virtual bool takeNtpSample(NtpSample &sample) = 0; // Newest Network Time, false if Nothing New
+        virtual void requestRefetch() = 0; // A Change Couldn't be Applied, so the Whole List is Fetched Again
+
+        virtual void pushStats(const String &json) = 0; // Uploads Loop Stats once Online, Only the Latest is Kept
+        virtual bool pushUpdate(const String &json) = 0; // Hands Over One Multi-Path Device Update, false while the Last One is Still Going Out
+        virtual bool pushAlarmEdit(const AlarmEdit &edit) = 0; // Queues an Alarm Written over the LAN for Firebase, false if the Queue is Full
+};
+
+const int LAN_CONNECTIONS = 4; // Clients the Local Server Holds at Once, lwIP only has a Few Sockets to Spare
+
+// TCP Listener for Clients on the Same Wi-Fi, Works without the Internet
+// Nothing waits: accept, read and write only do what can be done right now
+class LanServer {
+    public:
+        virtual ~LanServer() {}
+
+        virtual void begin(uint16_t port) = 0; // Listens once the Network is Up
+        virtual int accept() = 0; // New Connection, -1 if None is Waiting or LAN_CONNECTIONS are Open
+        virtual int read(int connection, char *buffer, size_t size) = 0; // Bytes Read, 0 if None Yet, -1 once Closed
+        virtual bool write(int connection, const char *data, size_t size) = 0; // false if it Couldn't all be Sent
+        virtual void close(int connection) = 0;
+};
+
+// Datagrams to the Other Clocks in the House, Multicast on the ESP32
+// Best effort like any UDP: messages can be lost or doubled, and nothing waits
+class PeerLink {
+    public:
+        virtual ~PeerLink() {}
+
+        virtual void begin() = 0; // Joins the Group once the Network is Up
+        virtual uint32_t localId() = 0; // Unique in the House and Never 0
+        virtual bool send(const void *data, size_t size) = 0; // To Every Other Clock
+        virtual size_t receive(void *data, size_t maxSize) = 0; // Next Datagram, 0 if None
+};
+
+// Every Peripheral the Alarm Uses
+struct Hal {
+    ClockSource &clock;
+    LcdDevice &lcd;
+    AudioPlayer &audio;
+    ButtonInput &buttons;
+    Storage &storage;
+    CloudSource &cloud;
+    LanServer &lan;
+    PeerLink &peers;
+};
+
+#endif
@@ -0,0 +1,110 @@
+// ESP32 Implementations of the Hardware Interfaces
+
+#ifndef HalEsp32_H_
+#define HalEsp32_H_
+
+// Standard Libraries
+#include <atomic>
+
+// External Library Headers
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+// Project Specific Headers
+#include "Hal.h"
+
+// esp_timer, millis() and the DS1302
+class Esp32Clock : public ClockSource {
+    public:
+        unsigned long millis() override;
+        int64_t micros() override;
+        void delay(unsigned long ms) override;
+        void lightSleep(unsigned long ms) override;
+        uint32_t cycles() override;
+        uint32_t cyclesPerMicro() override;
+
+        void beginRtc() override;
+        bool readRtc(uint32_t &epoch) override;
+        void writeRtc(uint32_t epoch) override;
+};
+
+// LCD on a PCF8574 I2C Backpack
+class Esp32Lcd : public LcdDevice {
+    public:
+        void begin() override;
+        void clear() override;
+        void setCursor(uint8_t col, uint8_t row) override;
+        void write(char c) override;
+};
+
+// DFPlayer Mini on Serial1
+class Esp32Audio : public AudioPlayer {
+    private:
+        std::atomic<bool> online{false}; // Set by the Background Bring-Up Task
+
+        // Reply Frame being Read from the Player
+        uint8_t reply[10];
+        int replyLength = 0;
+
+        friend void audioBeginTask(void *param);
+
+    public:
+        void begin() override;
+        bool isOnline() override;
+
+        void send(AudioCommand command, uint16_t argument) override; // Writes the Frame into the UART Buffer, Never Waits
+        AudioEvent poll(int &value) override; // Reads Whatever Reply Bytes have Arrived
+};
+
+// Buttons Wired to GPIO with Pull-Downs, Edges Captured by Interrupt
+class Esp32Buttons : public ButtonInput {
+    public:
+        void setup(int pin) override;
+        bool isPressed(int pin) override;
+        bool takeEdge(ButtonEdge &edge) override;
+};
+
+// NVS Flash through Preferences
+class Esp32Storage : public Storage {
+    private:
+        bool opened = false;
+
+        void open(); // Opens the Namespace on First Use
+
+    public:
+        size_t read(const char *key, void *data, size_t maxSize) override;
+        bool write(const char *key, const void *data, size_t size) override;
+};
+
+// WiFiServer on the Station Interface, Connections are Slots in clients
+class Esp32Lan : public LanServer {
+    private:
+        WiFiServer server;
+        WiFiClient clients[LAN_CONNECTIONS];
+        uint16_t port = 0;
+        bool listening = false;
+
+    public:
+        void begin(uint16_t port) override; // Listener Starts in accept() once Wi-Fi is Connected
+        int accept() override;
+        int read(int connection, char *buffer, size_t size) override;
+        bool write(int connection, const char *data, size_t size) override;
+        void close(int connection) override;
+};
+
+// UDP Multicast Group on the Station Interface, Ids Come from the MAC Address
+class Esp32Peers : public PeerLink {
+    private:
+        WiFiUDP udp;
+        bool joined = false;
+
+    public:
+        void begin() override {} // Joins in send() or receive() once Wi-Fi is Connected
+        uint32_t localId() override;
+        bool send(const void *data, size_t size) override;
+        size_t receive(void *data, size_t maxSize) override;
+
+        bool join(); // Returns if the Group is Joined
+};
+
+#endif
@@ -0,0 +1,152 @@
+// Lock-Free Handoff Between the Network Core and the Alarm Core
+
+#ifndef Handoff_H_
+#define Handoff_H_
+
+// Standard Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <utility>
+
+// Single-Producer / Single-Consumer Ring Queue
+// Only one task may push and only one task may pop. Size must be a power of two.
+template <typename T, size_t Size>
+class SpscQueue {
+    private:
+        static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+        T items[Size];
+        std::atomic<size_t> head{0}; // Next Slot to Pop (Consumer Owned)
+        std::atomic<size_t> tail{0}; // Next Slot to Push (Producer Owned)
+
+    public:
+        // Adds an Item, Returns false if the Queue is Full
+        bool push(const T &item) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == Size) {
+                return false;
+            }
+            items[t & (Size - 1)] = item;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Takes the Oldest Item, Returns false if the Queue is Empty
+        bool pop(T &item) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = std::move(items[h & (Size - 1)]);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t count() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+};
+
+// Multi-Producer / Single-Consumer Ring Queue
+// Any task on either core may push, only one task may pop. Size must be a power of two.
+// Each slot carries a sequence number, so producers claim slots without a lock and the
+// consumer only takes a slot once its producer has finished writing it.
+template <typename T, size_t Size>
+class MpscQueue {
+    private:
+        static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+        struct Slot {
+            std::atomic<size_t> sequence;
+            T item;
+        };
+
+        Slot slots[Size];
+        std::atomic<size_t> tail{0}; // Next Slot to Claim (Shared by Producers)
+        size_t head = 0;             // Next Slot to Pop (Consumer Owned)
+
+    public:
+        MpscQueue() {
+            for (size_t i = 0; i < Size; i++) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // Adds an Item, Returns false if the Queue is Full
+        bool push(const T &item) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            Slot *slot;
+            while (true) {
+                slot = &slots[t & (Size - 1)];
+                intptr_t ready = (intptr_t)slot->sequence.load(std::memory_order_acquire) - (intptr_t)t;
+                if (ready == 0) {
+                    if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (ready < 0) {
+                    return false; // Consumer hasn't freed this slot yet
+                }
+                else {
+                    t = tail.load(std::memory_order_relaxed); // Another producer claimed it
+                }
+            }
+            slot->item = item;
+            slot->sequence.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Takes the Oldest Item, Returns false if the Queue is Empty
+        bool pop(T &item) {
+            Slot &slot = slots[head & (Size - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                return false;
+            }
+            item = std::move(slot.item);
+            slot.sequence.store(head + Size, std::memory_order_release);
+            head++;
+            return true;
+        }
+
+        // Items Claimed but not Popped Yet, Only Exact on the Consumer
+        size_t count() const {
+            return tail.load(std::memory_order_acquire) - head;
+        }
+};
+
+// Triple Buffer Holding the Latest Value Published by One Task for Another
+// Older values the consumer never took are simply replaced.
+template <typename T>
+class TripleBuffer {
+    private:
+        static const uint8_t FRESH = 0x4; // Set when the Middle Slot Holds an Unread Value
+
+        T slots[3];
+        uint8_t back = 0;                // Slot the Producer Writes
+        std::atomic<uint8_t> middle{1};  // Slot Passed Between Them (Index | FRESH)
+        uint8_t front = 2;               // Slot the Consumer Reads
+
+    public:
+        // Slot to Fill before Calling publish()
+        T &writeSlot() {
+            return slots[back];
+        }
+
+        // Hands the Filled Slot to the Consumer
+        void publish() {
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+        }
+
+        // Swaps the Latest Published Value into value, Returns false if Nothing New
+        bool take(T &value) {
+            if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+                return false;
+            }
+            front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+            std::swap(value, slots[front]);
+            return true;
+        }
+};
+
+#endif
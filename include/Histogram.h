@@ -0,0 +1,31 @@
+// Fixed-Bucket Latency Histogram
+
+#ifndef Histogram_H_
+#define Histogram_H_
+
+// Standard Libraries
+#include <stdint.h>
+
+// Two Buckets per Power of Two Microseconds, so Percentiles are Within 50%
+// Bucket 0 is 0us, 1 is 1us, then 2, 3, 4-5, 6-7, 8-11, 12-15 ... up to about 1s
+const int HISTOGRAM_BUCKETS = 40;
+
+class Histogram {
+    private:
+        uint32_t buckets[HISTOGRAM_BUCKETS] = {};
+        uint32_t count = 0;
+        uint32_t max = 0;
+
+        static int bucketOf(uint32_t micros);
+        static uint32_t bucketTop(int bucket); // Largest Value that Lands in the Bucket
+
+    public:
+        void record(uint32_t micros); // Adds One Sample, Constant Time
+        void reset();
+
+        uint32_t getCount() const { return count; }
+        uint32_t getMax() const { return max; }
+        uint32_t percentile(uint8_t percent) const; // Upper Bound of the Bucket Holding that Percentile
+};
+
+#endif
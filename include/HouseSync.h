@@ -0,0 +1,145 @@
+// Rings Shared Alarms on Every Clock in the House at Once
+// Clocks announce themselves over the peer link, and the one with the best time (fresh NTP, then lowest id)
+// is the reference. The others measure their offset to it with two-way exchanges, keeping the sample with the
+// shortest round trip, since that one waited least in either loop.
+// The first clock to fire an alarm sends "ring at house instant T", a little ahead so every clock hears it in time.
+// Every clock with that alarm starts at T on its own clock plus its offset.
+// A stop, dismissed or timed out, goes out the same way and stops the rest.
+
+#ifndef HouseSync_H_
+#define HouseSync_H_
+
+// Standard Libraries
+#include <stdint.h>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "AlarmTable.h"
+#include "Uplink.h"
+
+class Alarm;
+
+const int HOUSE_PEERS = 8;                    // Other Clocks Tracked, More are Ignored
+const unsigned long ANNOUNCE_PERIOD = 2000;   // Milliseconds between Announcements
+const unsigned long PEER_TIMEOUT = 7000;      // A Clock not Heard from this Long has Left
+const unsigned long EXCHANGE_PERIOD = 1000;   // Milliseconds between Offset Exchanges with the Reference
+const int OFFSET_SAMPLES = 8;                 // Exchanges the Shortest Round Trip is Picked from
+const int64_t RING_LEAD = 200000;             // Microseconds from an Alarm's Time to the Shared Start
+const int HANDLED_OCCURRENCES = 8;            // Recent Rings Remembered, so Late Messages and Firings are Ignored
+const uint8_t MESSAGE_REPEATS = 2;            // Extra Copies of Ring and Stop Messages, Wi-Fi Multicast Drops Some
+
+enum HouseMessageType : uint8_t {
+    HOUSE_ANNOUNCE = 1, // I'm Here, with my Clock Quality
+    HOUSE_REQUEST,      // Offset Exchange to the Reference, t1
+    HOUSE_REPLY,        // From the Reference, t1 Echoed with t2 and t3
+    HOUSE_RING,         // Start key's fireAt Occurrence at House Time at
+    HOUSE_STOP          // key's fireAt Occurrence Stopped, reason says Why
+};
+
+// Wire Format, the Same Layout on Every Clock (All Little-Endian)
+struct HouseMessage {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t quality; // 2 Fresh NTP, 1 RTC Only
+    uint8_t reason;  // StopReason of a Stop
+    uint8_t reserved;
+    uint32_t from;
+    uint32_t to; // 0 for Everyone
+    int64_t t1;  // Request Sent, Requester's Clock
+    int64_t t2;  // Request Received, Reference's Clock
+    int64_t t3;  // Reply Sent, Reference's Clock
+    int64_t at;  // House Epoch Microseconds to Start Ringing
+    uint32_t fireAt; // Occurrence, Epoch Seconds on the Alarm's Schedule
+    char key[ALARM_KEY_SIZE];
+};
+
+class HouseSync {
+    private:
+        struct Peer {
+            uint32_t id;
+            uint8_t quality;
+            unsigned long seenAt;
+        };
+
+        struct OffsetSample {
+            int64_t offset; // Reference Clock minus Ours
+            int64_t roundTrip;
+        };
+
+        struct Occurrence {
+            char key[ALARM_KEY_SIZE];
+            uint32_t fireAt;
+        };
+
+        Alarm *alarm;
+        uint32_t id = 0;
+
+        Peer peers[HOUSE_PEERS];
+        int peerCount = 0;
+        uint32_t referenceId = 0; // Our Own id when We're the Reference
+        unsigned long nextAnnounceAt = 0;
+        unsigned long nextExchangeAt = 0;
+
+        OffsetSample samples[OFFSET_SAMPLES];
+        int sampleCount = 0;
+        int sampleNext = 0;
+        int64_t offset = 0; // Added to Our Clock to get House Time
+        int64_t offsetRoundTrip = -1; // Of the Sample in Use, -1 until the First
+
+        // Ring Waiting for its Shared Instant, and the One Ringing
+        Occurrence pending = {};
+        int64_t pendingStartAt = 0; // Our Epoch Microseconds
+        bool hasPending = false;
+        Occurrence ringing = {};
+        bool hasRinging = false;
+        bool stopping = false; // Stopping for a Stop Message, so it isn't Sent Back
+
+        Occurrence handled[HANDLED_OCCURRENCES];
+        int handledNext = 0;
+
+        HouseMessage lastEvent = {}; // Ring or Stop being Repeated
+        uint8_t repeatsLeft = 0;
+
+        // Statistics
+        uint32_t exchanges = 0;
+        uint32_t ringsSent = 0;
+        uint32_t ringsJoined = 0; // Started from Another Clock's Message before Firing Here
+        uint32_t stopsSent = 0;
+        uint32_t stopsJoined = 0;
+        uint32_t referenceChanges = 0;
+
+        void receive(HouseMessage &message);
+        void send(HouseMessage &message);
+        void sendEvent(HouseMessage &message); // Sends it Now and Repeats it on the Next Polls
+        void seePeer(uint32_t peerId, uint8_t quality);
+        void electReference();
+        void addSample(const HouseMessage &reply, int64_t receivedAt);
+        bool schedule(const char *key, uint32_t fireAt, int64_t houseStartAt); // Returns false if this Clock doesn't Ring the Alarm then
+        bool firesAt(const AlarmItem &alarmItem, uint32_t fireAt); // Our Own Copy of the Alarm Rings at fireAt
+        void startPending();
+        void remember(const char *key, uint32_t fireAt);
+        bool isHandled(const char *key, uint32_t fireAt);
+        uint8_t quality();
+        int64_t localNow(); // Our Clock, Epoch Microseconds
+
+    public:
+        HouseSync(Alarm &alarm);
+
+        int task = -1; // Pulled Forward to the Shared Start
+
+        void begin();
+        void update(); // Reads Messages, Announces, Exchanges and Starts a Waiting Ring
+
+        bool hasPeers(); // Any Other Clock Heard from Lately
+        bool isWaiting() { return hasPending; } // A Ring is Waiting for its Instant, the CPU Shouldn't Sleep
+        int64_t houseNow() { return localNow() + offset; } // House Epoch Microseconds
+
+        // An Alarm Fired Here, Returns true if the Start is Shared (it Starts from update()) or Already Done
+        bool holdRing(AlarmItem &alarmItem, uint32_t fireAt);
+        void ringStarted(AlarmItem &alarmItem, uint32_t fireAt); // Any Ring that Started, Shared or Not
+        void ringStopped(AlarmItem &alarmItem, StopReason reason); // Tells the Others, unless a Stop Message Caused it
+
+        void printStats(); // Prints Peers, Reference, Offset and Messages
+};
+
+#endif
@@ -0,0 +1,90 @@
+// Alarm Control over the Local Network, without the Cloud Round Trip
+// A small HTTP/1.1 server polled from the loop, edits go through the same patch path as Firebase
+// and are armed before the response goes out. State changes are pushed to WebSocket clients.
+//
+//   GET    /state                 Time, Sync Age, Volume, Ringing Alarm and Alarm Count
+//   GET    /alarms                Every Synced Alarm, Keyed like Firebase
+//   GET    /alarms/<key>
+//   PUT    /alarms/<key>          Whole Alarm as Firebase Takes it (see AlarmParser.h), Needs hour and minute if it's New
+//                                 Keys are Firebase Child Keys, an Alarm the App Keeps in an Array is Edited by Index,
+//                                 and a New One can Only Take the Next Index
+//   PATCH  /alarms/<key>          Only the Fields Sent Change, the Alarm must Exist
+//   DELETE /alarms/<key>
+//   GET    /volume, PUT /volume   {"volume":n}
+//   GET    /ring, DELETE /ring    Ringing Alarm, Deleting it Stops the Ring
+//   GET    /ringtones             Every Sound an Alarm can Name, with Track Lengths Once they've Played
+//   GET    /events                WebSocket, Sends the State then {"<path>":value} for Every Change
+//
+// Build with -DLAN_API_TOKEN=\"...\" to require "Authorization: Bearer ..." on every request.
+// Every edit is queued for Firebase, which stays the source of truth, so the next full sync keeps it.
+
+#ifndef LocalApi_H_
+#define LocalApi_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <stddef.h>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "AlarmTable.h"
+#include "Histogram.h"
+
+class Alarm;
+
+const uint16_t LAN_PORT = 80;
+const size_t LAN_REQUEST_SIZE = 1024;         // Request Line, Headers and Body, Bigger Requests get a 413
+const unsigned long LAN_IDLE_TIMEOUT = 30000; // Keep-Alive Connections Quiet this Long are Closed
+
+class LocalApi {
+    private:
+        struct Client {
+            int connection = -1; // -1 when the Slot is Free
+            bool webSocket = false;
+            unsigned long lastActive = 0;
+            size_t length = 0;
+            char buffer[LAN_REQUEST_SIZE + 1]; // Null Terminated
+        };
+
+        Alarm *alarm;
+        Client clients[LAN_CONNECTIONS];
+
+        // Statistics
+        uint32_t requests = 0;
+        uint32_t edits = 0;
+        uint32_t rejected = 0; // Answered with a 4xx
+        uint32_t pushes = 0;   // WebSocket Messages Sent
+        uint32_t unsent = 0;   // Edits the Cloud Queue had No Room for
+
+        void acceptClients();
+        void readClient(Client &client);
+        void closeClient(Client &client);
+        bool handleRequest(Client &client, size_t &used); // Returns false to Close, used is 0 until a Whole Request is In
+        int route(const char *method, const char *path, const char *body, String &response); // Returns the Status
+        int editAlarm(const char *method, const char *key, const char *body, String &response);
+        void writeBack(const char *key, const String &json); // Queues the Alarm as it Now Stands for Firebase
+        long arrayEnd(); // One Past the Highest Array Index Held, 0 if No Alarm has a Numeric Key
+        bool handleFrame(Client &client, size_t &used); // Client WebSocket Frames, only Close and Ping Matter
+        bool respond(Client &client, int status, const String &body, bool keepAlive);
+        bool sendFrame(Client &client, uint8_t opcode, const char *data, size_t size);
+        void broadcast(const String &json);
+        bool hasListeners(); // Any Event Sockets Open
+
+        String alarmJson(AlarmItem &alarmItem);
+        String alarmsJson();
+        String stateJson();
+        String ringtonesJson();
+
+    public:
+        LocalApi(Alarm &alarm);
+
+        Histogram editToArmed; // Microseconds from a Whole Edit Request to its Alarm being Armed
+
+        void begin(); // Starts Listening once Wi-Fi is Up
+        void update(); // Accepts, Reads and Answers Whatever is Waiting, Never Waits
+        void pushValue(const char *path, const char *value); // One Device State Change to Every Event Socket
+        void alarmsChanged(); // Whole Alarm List to Every Event Socket
+        void printStats(); // Prints Requests, Edits, Rejects and Pushes
+};
+
+#endif
@@ -0,0 +1,149 @@
+// Deferred Logging
+// Log calls only copy a small binary record (time, format, arguments) into a lock-free ring,
+// a low-priority task formats them later and writes only what fits in the UART buffer.
+// LOG_LEVEL and LOG_MODULES are build flags, calls they leave out compile to nothing.
+
+#ifndef Log_H_
+#define Log_H_
+
+// Standard Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "Handoff.h"
+
+// Levels, a Build Keeps Every Level up to LOG_LEVEL
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4 // Adds the Per-Second Clock Print and Every Stream Event
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Modules, a Build Keeps the Ones Set in LOG_MODULES
+#define LOG_ALARM (1 << 0)
+#define LOG_CLOCK (1 << 1)
+#define LOG_SOUND (1 << 2)
+#define LOG_NETWORK (1 << 3)
+#define LOG_STORE (1 << 4)
+
+#ifndef LOG_MODULES
+#define LOG_MODULES 0xFF
+#endif
+
+const int LOG_MAX_ARGS = 6;
+const size_t LOG_TEXT_SIZE = 48;  // Room for String Arguments, which are Copied (Longer Ones are Cut Off)
+const size_t LOG_QUEUE_SIZE = 32; // Records Waiting to be Printed, Newer Ones are Dropped when Full
+const size_t LOG_LINE_SIZE = 160;
+const int LOG_DRAIN_BATCH = 4;    // Most Records Formatted per Drain
+
+// One Log Call, Nothing is Formatted Yet
+struct LogRecord {
+    uint32_t at;        // Milliseconds since Boot
+    const char *format; // Always a Literal, so Only the Pointer is Kept
+    uint8_t level;
+    uint8_t module;
+    uint8_t argCount;
+    uint8_t textUsed;
+    uint32_t args[LOG_MAX_ARGS]; // Integers, Float Bits, or Offsets into text for Strings
+    char text[LOG_TEXT_SIZE];
+};
+
+class Logger {
+    private:
+        ClockSource *clock = nullptr;
+        MpscQueue<LogRecord, LOG_QUEUE_SIZE> records;
+        std::atomic<uint32_t> dropped{0};
+        uint32_t written = 0;
+
+        // Formatted Line Still Going Out
+        char line[LOG_LINE_SIZE];
+        size_t lineLength = 0;
+        size_t lineSent = 0;
+
+        // Packs One Argument into the Record
+        template <typename T>
+        static void pack(LogRecord &record, T value) {
+            static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Log arguments are numbers or C strings");
+            if (record.argCount >= LOG_MAX_ARGS) {
+                return;
+            }
+            record.args[record.argCount++] = bitsOf(value, std::is_floating_point<T>());
+        }
+        template <typename T>
+        static uint32_t bitsOf(T value, std::false_type) { return (uint32_t)value; }
+        template <typename T>
+        static uint32_t bitsOf(T value, std::true_type) {
+            float f = (float)value; // Printed as float, doubles only lose digits nobody reads
+            uint32_t bits;
+            memcpy(&bits, &f, sizeof(bits));
+            return bits;
+        }
+        static void pack(LogRecord &record, const char *text);
+        static void pack(LogRecord &record, char *text) { pack(record, (const char *)text); }
+
+        size_t format(const LogRecord &record, char *out, size_t size);
+
+    public:
+        void begin(ClockSource &clock); // Records Before this are Stamped 0
+
+        // Queues a Record, Never Waits, Counts a Drop if the Ring is Full
+        // Use the LOG_ macros, they check the format and strip disabled calls
+        template <typename... Args>
+        void write(uint8_t level, uint8_t module, const char *format, Args... args) {
+            LogRecord record;
+            record.at = clock != nullptr ? clock->millis() : 0;
+            record.format = format;
+            record.level = level;
+            record.module = module;
+            record.argCount = 0;
+            record.textUsed = 0;
+            int unpack[] = {0, (pack(record, args), 0)...};
+            (void)unpack;
+
+            if (!records.push(record)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void drain(); // Formats Waiting Records and Writes what Fits in the UART Buffer
+        bool isEmpty(); // Nothing Waiting or Half Written
+
+        uint32_t getDropped() { return dropped.load(std::memory_order_relaxed); }
+        uint32_t getWritten() { return written; }
+        void printStats(); // Prints Records Written and Dropped
+};
+
+extern Logger logger;
+
+// Only Type Checks the Format, Never Called
+static inline void logCheckFormat(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static inline void logCheckFormat(const char *format, ...) { (void)format; }
+
+// Constant, so Work Done Only for a Log can be Skipped with it too
+#define LOG_ENABLED(level, module) ((level) <= LOG_LEVEL && ((module) & LOG_MODULES) != 0)
+
+#define LOG_AT(level, module, ...)                    \
+    do {                                              \
+        if (false) {                                  \
+            logCheckFormat(__VA_ARGS__);              \
+        }                                             \
+        if (LOG_ENABLED(level, module)) {             \
+            logger.write(level, module, __VA_ARGS__); \
+        }                                             \
+    } while (0)
+
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#define LOG_WARN(module, ...) LOG_AT(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#define LOG_INFO(module, ...) LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#define LOG_DEBUG(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+
+#endif
@@ -5,34 +5,116 @@
 
 // Standard Libraries
 #include <string>
+#include <vector>
+#include <atomic>
 
 #include <WiFi.h>
 #include <Firebase_ESP_Client.h>
 
-class Alarm;
+// Project Specific Headers
+#include "Hal.h"
+#include "Handoff.h"
 
-class Network {
-    private:
-        Alarm* alarm; // Reference to Alarm
+// Bring-Up Stages of the Network Task
+enum NetworkStage {
+    NET_WIFI,  // Connecting to Wifi
+    NET_TIME,  // Starting NTP, Replies are Picked Up from then On
+    NET_AUTH,  // Signing In to Firebase
+    NET_ONLINE // Streaming Alarms
+};
 
+// Wifi, NTP and Firebase, the ESP32 Cloud Source
+class Network : public CloudSource {
+    private:
         FirebaseAuth auth;
         FirebaseConfig config;
 
         String uid;
 
+        std::atomic<NetworkStage> stage{NET_WIFI};
+        unsigned long authStarted = 0; // When Firebase Sign-In was Last Started
+
+        // Stream Health, Watched by superviseStream
+        std::atomic<bool> streamUp{false};
+        unsigned long streamDownSince = 0;
+        unsigned long reconnectAt = 0;
+        unsigned long reconnectBackoff = 0; // Doubles with Every Failed Reconnect, 0 while Healthy
+        uint32_t reconnects = 0;
+        uint32_t drops = 0;
+
+        // Conditional Refetch, the App Bumps alarmsVersion with Every Change
+        long appliedVersion = -1; // Version of the Alarms Handed Over, -1 if Unknown
+        bool versionMissing = false; // The App doesn't Keep a Version, Every Refetch is Full
+        String appliedETag; // ETag of the Last Full Alarm List Parsed
+        unsigned long lastRefetchCheck = 0;
+        uint32_t refetchesSkipped = 0;
+
+        // Handoff to the Alarm Core, Network Task is the Only Producer
+        TaskHandle_t task = nullptr;
+        SpscQueue<AlarmPatch, 16> patches;
+        TripleBuffer<AlarmSet> alarmSets;
+        TripleBuffer<String> statsOut; // Loop Stats from the Alarm Core, Uploaded from the Network Task
+        String updateOut; // Device Update being Sent, Only Touched by the Alarm Core while updatePending is false
+        std::atomic<bool> updatePending{false};
+        std::atomic<bool> refetchRequested{false}; // Set by the Alarm Core, Taken by the Network Task
+        unsigned long updateRetryAt = 0;
+        unsigned long updateBackoff = 0; // Doubles on Every Failure, 0 after a Success
+        SpscQueue<AlarmEdit, 16> editsOut; // LAN Edits from the Alarm Core, Written Back One at a Time
+        AlarmEdit editOut; // Taken from editsOut and being Written, Only Touched by the Network Task
+        bool editHeld = false;
+        unsigned long editRetryAt = 0;
+        unsigned long editBackoff = 0; // Doubles on Every Failure, 0 after a Success
+        uint32_t nextSeq = 1;
+
+        // NTP Exchange, Run by the Network Task (isBusy Reads ntpWaiting)
+        std::atomic<bool> ntpWaiting{false}; // Request Sent, Reply not In Yet
+        int64_t ntpSentMicros = 0;
+        unsigned long ntpSentAt = 0;
+        unsigned long nextNtpAt = 0;
+        TripleBuffer<NtpSample> ntpSamples; // Newest Sample for the Alarm Core
+
+        void requestNtp();
+        void readNtpReply(); // Server Time when the Reply Arrived is its Send Time plus Half the Network Delay
+        void sendUpdate(); // Sends the Waiting Device Update, Backing Off when it Fails
+        void sendAlarmEdit(); // Writes the Oldest LAN Edit to Firebase, Backing Off when it Fails
+        bool editsWaiting() { return editHeld || editsOut.count() > 0; }
+        void superviseStream(); // Reopens a Dropped or Silent Stream with Jittered Backoff
+        void refetchAlarms(); // Full Alarm List, Skipped when alarmsVersion hasn't Changed
+        void forceFullRefetch(); // Stream Changes were Lost, so the Version Can't be Trusted
+        void publishPatch(AlarmPatch &patch); // Queues One Alarm Change for the Alarm Core
+        bool publishAlarmSet(const String &payload); // Parses and Hands Over a Full Alarm List, Returns false if the Payload isn't Valid
+
         friend void WiFiEventConnected(WiFiEvent_t event, WiFiEventInfo_t info);
         friend void WiFiEventGotIP(WiFiEvent_t event, WiFiEventInfo_t info);
         friend void WiFiEventDisconnected(WiFiEvent_t event, WiFiEventInfo_t info);
 
+        // Turns a Stream Event into an Alarm Change
+        void applyStreamEvent(const String &eventType, const String &dataPath, const String &dataType, const String &data);
+
 
     public:
-        Network(Alarm& alarm);
+        void start() override; // Sets up Wifi and Starts the Network Task
 
         bool initWiFi();
         void initFirebase();
+        void startStream(); // Opens the Alarm Stream once Signed In
+        void startTask(); // Runs Network Bring-Up and the Firebase Loop on its Own Task on Core 0
+        void runNetworkLoop(); // Brings Up Wifi, Time and Firebase One Stage at a Time, then Runs Firebase
         void runFirebaseLoop();
+        bool isOnline() override; // Returns if Firebase is Signed In and Streaming
+        bool isBusy() override; // Bringing Up, Refetching or Applying Stream Events
         bool connectWiFi();
+        void updateNtp(); // Asks the NTP Server for the Time every NTP_PERIOD, Never Waiting on the Reply
         void firebaseDataUpdate();
+
+        // Alarm Core Side, Returns false when Nothing New
+        bool takeAlarmSet(AlarmSet &set) override;
+        bool takePatch(AlarmPatch &patch) override;
+        bool takeNtpSample(NtpSample &sample) override;
+        void requestRefetch() override;
+        void pushStats(const String &json) override;
+        bool pushUpdate(const String &json) override;
+        bool pushAlarmEdit(const AlarmEdit &edit) override;
 };
 
 #endif
\ No newline at end of file
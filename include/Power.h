@@ -0,0 +1,35 @@
+// Sleeps between Real Deadlines and Tracks how Much the CPU is Awake
+
+#ifndef Power_H_
+#define Power_H_
+
+// Standard Libraries
+#include <stdint.h>
+
+class Alarm;
+
+const unsigned long MIN_LIGHT_SLEEP = 20; // Milliseconds, Shorter Waits aren't Worth Waking Up from
+
+class Power {
+    private:
+        Alarm *alarm;
+        bool sleepEnabled = false;
+
+        // Since the Last Stats Print
+        int64_t windowStart = 0;
+        int64_t idleMicros = 0; // Waiting or Asleep
+        uint32_t wakeups = 0;   // Waits that Ended
+        uint32_t sleeps = 0;    // Waits that were Light Sleeps
+
+        bool canSleep(); // Returns if Nothing Needs Polling
+
+    public:
+        Power(Alarm &alarm);
+
+        void idle(); // Waits for the Next Deadline, Light Sleeping through it when Nothing Needs Polling
+        void setSleep(bool on);
+        bool isSleepEnabled();
+        void printStats(); // Prints Awake Percentage and Wake-Ups per Minute, then Starts Over
+};
+
+#endif
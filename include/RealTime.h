@@ -3,24 +3,86 @@
 #ifndef RealTime_H_
 #define RealTime_H_
 
-// External Library Headers
-#include <RtcDS1302.h>
-#include <NTPClient.h>
-#include <WiFiUdp.h>
-#include <Wire.h> 
+// Standard Libraries
+#include <stdint.h>
+
+// Project Specific Headers
+#include "Calendar.h"
+#include "Hal.h"
+
+class Alarm;
 
 
 class RealTime {
     private:
         Alarm *alarm; // Reference to the Alarm Object
 
+        // Software Clock, Served from esp_timer between Reference Checks
+        int64_t anchorEpochMicros = 0; // Epoch Microseconds at the Anchor
+        int64_t anchorMicros = 0;      // esp_timer Time at the Anchor
+        int32_t ratePpb = 0;           // How much Faster the Reference Runs than esp_timer, Parts per Billion
+        bool haveRate = false;
+        int64_t slewMicros = 0;        // Correction Still being Worked in from the Anchor, Never Faster than SLEW_PPB
+        uint32_t steps = 0;            // Corrections too Big to Slew
+
+        // NTP, the Reference while the Network is Up
+        bool haveNtp = false;
+        NtpSample lastNtp;             // Start of the Current Rate Baseline
+        int64_t ntpOffsetMicros = 0;   // NTP minus Software Clock at the Last Sample
+        uint32_t ntpRoundTrip = 0;
+        unsigned long lastNtpSync = 0;
+
+        // DS1302 Error against NTP, so it can Stand In when the Network is Down
+        int64_t rtcErrorMicros = 0;    // DS1302 minus True Time at rtcErrorTakenAt
+        int64_t rtcErrorTakenAt = 0;
+        int32_t rtcPpb = 0;            // How much Faster the DS1302 Runs than True Time, Parts per Billion
+        bool haveRtcPpb = false;
+        bool haveRtcBase = false;      // Start of the Current Drift Baseline
+        int64_t rtcBaseError = 0;
+        int64_t rtcBaseAt = 0;
+        uint32_t rtcSetAt = 0;         // Epoch the DS1302 was Last Set from NTP
+        bool rtcRewrite = false;       // Set the DS1302 at the Next Second Boundary
+
+        // DS1302 Second Edge Capture
+        bool capturing = false;
+        uint32_t captureEpoch = 0;   // DS1302 Second being Watched
+        int64_t captureReadAt = 0;   // esp_timer Time of the Last Read in that Second
+        bool haveEdge = false;
+        uint32_t lastEdgeEpoch = 0;
+        int64_t lastEdgeMicros = 0;
+        unsigned long lastDisciplined = 0;
+
+        void anchorClock(int64_t epochMicros, int64_t atMicros); // Restarts the Software Clock from a Known Time
+        int64_t epochMicrosAt(int64_t timerMicros); // Software Clock Time at an esp_timer Time
+        int64_t slewAppliedAt(int64_t timerMicros); // Part of slewMicros Worked in by then
+        void reanchor(int64_t atMicros); // Moves the Anchor Up without Changing the Time
+        void correct(int64_t offset, bool step); // Slews the Clock by offset, or Steps if it's too Big
+        uint32_t readRtcEpoch(); // Reads the DS1302 and Makes Sure It's Valid
+
+        void applyNtp(const NtpSample &sample); // Corrects the Clock and its Rate from an NTP Sample
+        void onRtcEdge(uint32_t rtcEpoch, int64_t edgeMicros); // Learns the DS1302's Drift, or Follows it when NTP is Stale
+        bool rewriteRtc(); // Sets the DS1302 if the Clock is at the Start of a Second
+        int64_t predictRtcError(int64_t timerMicros); // DS1302 minus True Time, from its Learned Drift
+        void saveCalibration();
+
     public:
         RealTime(Alarm& alarm); // Initialize Real Time Clock and Sync Time
         
-        void initRTC(); // Initialize the RTC/NCP and Sync Time
-        void runRTCLoop(); // Runs RTC Loop
+        void initRTC(); // Initialize the RTC and Load its Saved Time
+        void runRTCLoop(); // Runs RTC Loop, Applies NTP Samples from the Network
+        void disciplineClock(); // Checks the Software Clock Against the DS1302
+
+        CivilTime getTimeNow(); // Returns the current time
+        uint32_t getEpochNow(); // Returns the current time in Epoch Seconds
+        int64_t getEpochMicros(); // Software Clock Now in Epoch Microseconds
+        int64_t microsUntil(uint32_t epoch); // Microseconds until the Software Clock Reaches epoch, Negative once Past
+        bool isCapturing() { return capturing || rtcRewrite; } // Polling the DS1302 for a Second Tick, or to Set it
+        bool isNtpFresh(); // Synced Recently Enough to be the Reference
 
-        RtcDateTime getTimeNow(); // Returns the current time
+        int64_t getNtpOffset() { return ntpOffsetMicros; } // NTP minus Software Clock at the Last Sample
+        int32_t getRtcDriftPpb() { return rtcPpb; } // How much Faster the DS1302 Runs than True Time
+        long getSyncAge(); // Seconds since the Last NTP Sample, -1 if None
+        void printClock(); // Prints NTP Offset, Rate and the DS1302's Drift
 
 };
 
@@ -0,0 +1,80 @@
+// Index of the Tracks on the Player's SD Card, Kept in Flash
+// Loaded at boot without asking the player anything. The card is only counted again when one is inserted,
+// or when a single file count after boot doesn't match, and every query goes through the command queue
+// while nothing rings. Track lengths are learned from the player's finished events as they play.
+
+#ifndef Ringtones_H_
+#define Ringtones_H_
+
+// Standard Libraries
+#include <stdint.h>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "AudioQueue.h"
+
+const int RINGTONE_FOLDERS = 8;  // SD Folders /01 to /08 are Indexed
+const int RINGTONE_TRACKS = 16;  // Tracks per Folder that can be Picked by Name and have their Length Kept
+const unsigned long RINGTONE_ANSWER_TIMEOUT = 2000; // Milliseconds a Query Gets, the Queue Retries it Once in Between
+const unsigned long RINGTONE_RETRY = 60000;         // Milliseconds before an Unanswered Scan is Tried Again
+
+// What's on the Card, Saved as One Blob
+struct RingtoneIndex {
+    uint16_t version;
+    uint16_t files;       // Every File on the Card, Counted by the Player
+    uint32_t fingerprint; // Hash of the Counts, Tells Cards Apart without Reading Them
+    uint8_t tracks[RINGTONE_FOLDERS]; // Tracks in Each Folder, 0 if it's Missing
+    uint16_t seconds[RINGTONE_FOLDERS][RINGTONE_TRACKS]; // Length of Each Track, 0 until it has Played to the End
+};
+
+class Ringtones {
+    private:
+        enum ScanStep { SCAN_IDLE, SCAN_CHECK, SCAN_FILES, SCAN_FOLDERS };
+
+        Storage &storage;
+        ClockSource &clock;
+        AudioQueue &commands;
+
+        RingtoneIndex index = {};
+        bool known = false; // index Describes a Card, Loaded or Scanned
+        bool dirty = false; // Learned Lengths not Saved Yet
+
+        // Scan in Progress, index is Only Replaced once it's Done
+        ScanStep step = SCAN_IDLE;
+        bool scanWanted = false;  // Count Everything once the Player is Free
+        bool checkWanted = false; // Count Files Once, to Catch a Card Swapped while Powered Off
+        unsigned long nextTryAt = 0;
+        unsigned long askedAt = 0;
+        uint8_t folder = 0; // Being Counted
+        uint16_t files = 0;
+        uint8_t tracks[RINGTONE_FOLDERS];
+
+        // Statistics
+        bool loaded = false; // Came from Flash at Boot
+        uint32_t queries = 0;
+        uint32_t scans = 0;
+
+        void ask(); // Sends the Query for the Current Step
+        void finishScan();
+        void save();
+        static uint32_t fingerprintOf(uint16_t files, const uint8_t *tracks);
+
+    public:
+        Ringtones(Storage &storage, ClockSource &clock, AudioQueue &commands);
+
+        void begin(); // Loads the Saved Index, Never Waits on the Player
+        void update(bool free); // Sends the Next Query and Saves Learned Lengths, only while free (Online and not Ringing)
+        void onEvent(AudioEvent event, int value); // Card Changes and Query Answers from the Player
+
+        void trackFinished(uint8_t folder, uint8_t track, unsigned long ms); // A Track Played to its End
+        bool has(uint8_t folder, uint8_t track); // On the Card, Assumed to be until the Card has been Counted
+        bool firstTrack(uint8_t &folder, uint8_t &track); // Any Track on the Card, false if there's None
+        uint16_t secondsOf(uint8_t folder, uint8_t track); // 0 if Not Known
+        uint8_t tracksIn(uint8_t folder);
+        bool isKnown() { return known; }
+        uint32_t fingerprint() { return known ? index.fingerprint : 0; }
+
+        void printStats(); // Prints the Card, Where the Index Came from and Queries Sent
+};
+
+#endif
@@ -3,28 +3,82 @@
 #ifndef Sound_H_
 #define Sound_H_
 
+// Standard Libraries
+#include <stdint.h>
+
+// Project Specific Headers
+#include "Buttons.h"
+#include "AudioQueue.h"
+#include "Ringtones.h"
+
 class Alarm;
 
+// One Way of Ringing, Picked per Alarm by its "sound" Field, as a Number or by Name
+// Tracks live on the SD card as /01/001.mp3, /02/001.mp3, ...
+struct RingSequence {
+    const char *name;
+    uint8_t folder;
+    uint8_t track;
+    uint8_t startVolume; // Ramps from here up to the Set Volume
+    uint16_t rampSeconds; // 0 Starts Right at the Set Volume
+    uint16_t escalateAfter; // Seconds of Ringing before Switching to the Escalation Track at Max Volume, 0 Never
+    uint8_t escalateFolder;
+    uint8_t escalateTrack;
+};
+
+const unsigned long RAMP_STEP_MS = 250; // Fewest Milliseconds between Ramp Volume Commands, the Player's UART is Slow
+// Sounds from here up Play a Single Track with the Standard Ramp, Named by its Path like "02/003"
+// Bits 4-6 are the Folder minus 1, Bits 0-3 the Track minus 1
+const uint8_t TRACK_SOUND = 0x80;
+const unsigned long MIN_TRACK_MS = 1000; // Finished Events this Soon after Starting a Track are Duplicates of the Last One
+
 class Sound {
     private:
         bool ringing = false;
-        int volume = 15;
+        int volume = 15; // Set Volume, Ramps End Here
         Alarm *alarm;
 
+        // Ring Sequence State
+        const RingSequence *sequence = nullptr;
+        RingSequence trackSequence; // A Single Track Picked by Name
+        unsigned long ringStartedAt = 0;
+        unsigned long nextRampAt = 0;
+        bool ramping = false;
+        bool escalated = false;
+        uint8_t playingFolder = 0;
+        uint8_t playingTrack = 0;
+        bool trackPlaying = false; // From the Player's Finished Events
+        unsigned long trackStartedAt = 0;
+        int playerVolume = -1; // Last Volume Sent, -1 Before the First
+
+        void playTrack(uint8_t folder, uint8_t track);
+        const RingSequence *sequenceOf(uint8_t sound); // Unknown Sounds Ring the Standard Sequence
+        void sendVolume(int level);
+        void updateRing(unsigned long now); // Steps the Ramp, Escalates and Replays Finished Tracks
+
 
         int volumeDecreasePin = 13; // Tan
         int volumeIncreasePin = 14; // Green
+        unsigned long volumeChangedAt = 0; // Volume Display Hides 1.5s after this
 
     public:
         Sound(Alarm &alarm);
 
         bool recentlyChangedVolume = false; // When true, it will display the volume
         int maxVolume = 30;
+        AudioQueue commands; // Every Player Command Goes through Here, Never Waits on the Player
+        Ringtones ringtones; // What's on the SD Card, Checked before Ringing without Asking the Player
 
-        void initSound();
+        void initSound(); // Sets up Buttons and Starts DFPlayer Bring-Up in the Background
+        bool isReady(); // Returns if the DFPlayer is Online
+        bool isAudioIdle(); // Returns if no Player Command is Waiting on the Player
 
         void updateSound(); // Handles Updating Sound (Turning it off or on)
-        void startRinging(); // Starts Alarm Ringing
+        void onVolumeButton(const ButtonEvent &event, int direction); // Steps the Volume on a Press, and a Bigger Jump when Held
+        void startRinging(uint8_t sound = 0); // Starts Alarm Ringing with a Ring Sequence
+        int findSound(const char *name); // Sound Number of a Sequence or Track Name, -1 if there's No Such Sound
+        int sequenceCount(); // Sequences are Sounds 0 up to this
+        void nameOf(uint8_t sound, char *name, size_t size); // Sequence or Track Name of a Sound Number
         void stopRinging(); // Stops Alarm Ringing
         bool checkIsRinging(); // Returns if the Alarm is ringing or not
         
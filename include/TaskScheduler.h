@@ -0,0 +1,59 @@
+// Runs Each Alarm Component only when it is Due
+
+#ifndef TaskScheduler_H_
+#define TaskScheduler_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "Histogram.h"
+
+// How a Task's Deadline Limits Sleep
+enum TaskKind {
+    TASK_TIMED, // Has to Run on Time, Sleep Ends at its Deadline
+    TASK_POLLED // Polls for Something that Wakes the CPU Itself (Buttons, Network), Runs Whenever the Loop Wakes
+};
+
+// One Periodic Job in the Main Loop
+struct ScheduledTask {
+    const char *name;
+    uint32_t period;  // Milliseconds Between Runs
+    uint8_t priority; // Lower Runs First when Several are Due
+    TaskKind kind;
+    std::function<void()> run;
+
+    unsigned long nextDue = 0; // millis() when it Runs Next
+
+    // Run Statistics
+    Histogram runTime;            // Microseconds per Run
+    uint32_t missedDeadlines = 0; // Runs that Started more than a Period Late
+};
+
+class TaskScheduler {
+    private:
+        std::vector<ScheduledTask> tasks; // Indexed by Task Id
+        std::vector<size_t> order;        // Task Ids Sorted by Priority
+        ClockSource &clock;
+        Histogram loopTime; // Microseconds of Work per runDue() that Ran Something
+
+    public:
+        TaskScheduler(ClockSource &clock);
+
+        int addTask(const char *name, uint32_t period, uint8_t priority, std::function<void()> run, TaskKind kind = TASK_TIMED); // Registers a Task, Returns its Id
+        void runSoon(int taskId, unsigned long at); // Pulls a Task's Next Run Forward to millis() Time at
+
+        void runDue(); // Runs Every Task that is Due, Most Important First
+        unsigned long untilNextDeadline(bool timedOnly = false); // Milliseconds until the Earliest (Timed) Task is Due
+        void idle(); // Waits until the Earliest Task is Due
+        void wokeUp(); // Polled Tasks Run Right Away after a Sleep, without Counting as Late
+
+        void printStats(); // Prints Run Time Percentiles of Every Task and the Whole Loop
+        void resetStats();
+        String statsJson(); // Same Statistics as a JSON Object for Uploading
+};
+
+#endif
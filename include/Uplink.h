@@ -0,0 +1,70 @@
+// Collects Device State for Firebase and Sends it in Batches
+// Events only overwrite a small table keyed by path, so a value that changes again before the
+// flush is sent once. A flush hands the whole table to the network task as one multi-path update.
+
+#ifndef Uplink_H_
+#define Uplink_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <functional>
+
+// Project Specific Headers
+#include "Hal.h"
+
+const int UPLINK_SLOTS = 24;                // Distinct Paths Waiting, New Paths are Dropped when Full
+const int UPLINK_FLUSH_AT = 16;             // Paths Waiting that Flush without Waiting for the Period
+const unsigned long UPLINK_PERIOD = 30000;  // Longest a Value Waits before it's Sent
+const size_t UPLINK_PATH_SIZE = 40;         // Under the Device Node, "alarms/<key>/<field>" Fits
+const size_t UPLINK_VALUE_SIZE = 16;        // JSON Text, Numbers or Short Quoted Strings
+
+// Why a Ringing Alarm Stopped
+enum StopReason {
+    STOP_DISMISSED, // Stop Button
+    STOP_TIMED_OUT, // Rang for maxRingTime
+    STOP_REPLACED,  // Another Alarm Fired
+    STOP_REMOVED    // Deleted while Ringing
+};
+
+class Uplink {
+    private:
+        struct Entry {
+            char path[UPLINK_PATH_SIZE];
+            char value[UPLINK_VALUE_SIZE];
+        };
+
+        CloudSource &cloud;
+        ClockSource &clock;
+
+        Entry entries[UPLINK_SLOTS];
+        int count = 0;
+        unsigned long lastFlush = 0;
+
+        // Statistics
+        uint32_t events = 0;
+        uint32_t coalesced = 0; // Values that Replaced One Not Sent Yet
+        uint32_t dropped = 0;
+        uint32_t batches = 0;
+        uint32_t busy = 0; // Flushes Put Off because the Last Batch was Still Going Out
+
+        void set(const char *path, const char *value); // Replaces a Waiting Value for the Same Path
+        void setNumber(const char *path, long value);
+        void setAlarm(const char *key, const char *field, const char *value); // Skipped for Keyless Alarms
+
+    public:
+        Uplink(CloudSource &cloud, ClockSource &clock);
+
+        std::function<void(const char *path, const char *value)> onChange; // Every Value as it's Set, before it's Merged
+
+        void alarmFired(const char *key, uint32_t at);
+        void alarmStopped(const char *key, StopReason reason, uint32_t at, uint32_t rangFor);
+        void volumeChanged(int volume);
+        void clockSynced(uint32_t at, long offsetMillis, long rtcDriftPpb);
+
+        void flush(); // Sends the Table if the Period is Up or it's Filling, Never Waits on the Network
+        bool isEmpty() { return count == 0; }
+
+        void printStats(); // Prints Events, Merges, Drops and Batches Sent
+};
+
+#endif
@@ -2,251 +2,712 @@
 
 // Project Specific Headers
 #include "Alarm.h"
+#include "Log.h"
 
 // External Library Headers
 
 // Alarm Constructor
-Alarm::Alarm() : network(nullptr), rtc(nullptr), display(nullptr), sound(nullptr)
+Alarm::Alarm(Hal &hal) : store(hal.storage), hal(hal), rtc(nullptr), display(nullptr), sound(nullptr), power(nullptr), localApi(nullptr), houseSync(nullptr), scheduler(hal.clock), buttons(hal.buttons, hal.clock), uplink(hal.cloud, hal.clock)
 {
-    network = new Network(*this);
     rtc = new RealTime(*this);
     display = new Display(*this);
     sound = new Sound(*this);
+    power = new Power(*this);
+    localApi = new LocalApi(*this);
+    houseSync = new HouseSync(*this);
 }
 
 // Alarm Destructor
 Alarm::~Alarm()
 {
-    delete network; // Deallocate memory
     delete rtc;     // Deallocate memory
     delete display; // Deallocate memory
     delete sound;   // Deallocate memory
+    delete power;   // Deallocate memory
+    delete localApi; // Deallocate memory
+    delete houseSync; // Deallocate memory
 }
 
+// Boot only waits on the Display and RTC, everything else comes up in the background
 void Alarm::initAll()
 {
+    bootStarted = hal.clock.millis();
+    logger.begin(hal.clock);
+
     display->initLCD();      // Start running the LCD
-    sound->initSound();      // Setup Alarm Sound
-    network->initWiFi();     // Setup Wifi
     rtc->initRTC();          // Start running the RTC
-    network->initFirebase(); // Setup Firebase Connection
     initAlarm();             // Load Alarms
     display->clearLCD();     // Clear LCD after Init is Done
+    display->updateDisplay(); // Show the Time Right Away
+    firstFrameAt = hal.clock.millis();
+
+    sound->initSound();      // Setup Alarm Sound (DFPlayer Comes Online in the Background)
+    hal.cloud.start();       // Connect Wifi, NTP and Firebase in the Background
+    localApi->begin();       // LAN Control, Listens once Wifi is Up
+    houseSync->begin();      // Other Clocks in the House, Found once Wifi is Up
+    uplink.onChange = [this](const char *path, const char *value) { localApi->pushValue(path, value); };
+    buttons.watch(alarmStopPin, [this](const ButtonEvent &event) { onStopButton(event); });
+
+    // Register Component Loops, Lower Priority Number Runs First
+    // Polled tasks keep their period while awake, but only the display tick and the next alarm end a light sleep
+    scheduler.addTask("buttons", 10, 0, [this]() { buttons.update(); }, TASK_POLLED);    // Stop & Volume Button Events (GPIO Wakes)
+    scheduler.addTask("sound", 20, 0, [this]() { sound->updateSound(); }, TASK_POLLED);  // DFPlayer Events
+    scheduler.addTask("clock", 20, 0, [this]() { rtc->disciplineClock(); }, TASK_POLLED); // Catches DS1302 Second Ticks (Stays Awake while Capturing)
+    alarmTask = scheduler.addTask("alarm", 500, 1, [this]() { updateAlarm(); }, TASK_POLLED); // Check for Alarms (Power Wakes for the Next One)
+    houseSync->task = scheduler.addTask("house", 10, 1, [this]() { houseSync->update(); }, TASK_POLLED); // Other Clocks, Pulled Forward to a Shared Start
+    scheduler.addTask("display", 1000, 2, [this]() { display->updateDisplay(); }); // Time & Date
+    volumeTask = scheduler.addTask("volume", 500, 2, [this]() { display->showVolume(); }, TASK_POLLED);
+    scheduler.addTask("rtc", 1000, 3, [this]() { rtc->runRTCLoop(); }, TASK_POLLED);
+    scheduler.addTask("cloud", 50, 3, [this]() { applyCloudUpdates(); }, TASK_POLLED); // Alarm Changes from the Network Task (Wi-Fi Wakes)
+    scheduler.addTask("lan", 20, 3, [this]() { localApi->update(); }, TASK_POLLED); // Local Edits, Answered after they're Armed (Wi-Fi Wakes)
+    scheduler.addTask("uplink", 1000, 4, [this]() { uplink.flush(); }, TASK_POLLED); // Device State to Firebase in Batches
+    scheduler.addTask("stats", 60000, 5, [this]() { printStats(); }, TASK_POLLED);
+    scheduler.addTask("serial", 100, 5, [this]() { checkSerial(); }, TASK_POLLED);   // Stats Queries over Serial
+    scheduler.addTask("boot", 100, 5, [this]() { updateBoot(); }, TASK_POLLED);
+    scheduler.addTask("log", 20, 6, []() { logger.drain(); }, TASK_POLLED); // Prints Queued Log Records, Last so it Never Delays Anything
+}
+
+// Tracks Background Bring-Up and Reports how Long Each Stage Took
+void Alarm::updateBoot()
+{
+    if (bootStage == BOOT_CLOCK)
+    {
+        LOG_INFO(LOG_ALARM, "Boot: First clock frame after %lums", firstFrameAt - bootStarted);
+        bootStage = BOOT_AUDIO;
+    }
+
+    // Alarms can ring once the player is online
+    if (bootStage == BOOT_AUDIO && sound->isReady())
+    {
+        alarmReadyAt = hal.clock.millis();
+        LOG_INFO(LOG_ALARM, "Boot: Alarm ready after %lums", alarmReadyAt - bootStarted);
+        bootStage = BOOT_CLOUD;
+    }
+
+    if (bootStage == BOOT_CLOUD && hal.cloud.isOnline())
+    {
+        LOG_INFO(LOG_ALARM, "Boot: Firebase online after %lums", hal.clock.millis() - bootStarted);
+        bootStage = BOOT_DONE;
+    }
+}
+
+// Answers Commands Typed into the Serial Monitor
+//   stats - Prints Loop Timing Now
+//   reset - Clears Loop Timing
+//   push  - Toggles Uploading Loop Timing to Firebase
+//   sleep - Toggles Light Sleep between Deadlines
+void Alarm::checkSerial()
+{
+    while (Serial.available() > 0)
+    {
+        char c = Serial.read();
+        if (c != '\n' && c != '\r')
+        {
+            if (serialLine.length() < 16)
+            {
+                serialLine += c;
+            }
+            continue;
+        }
+
+        if (serialLine == "stats")
+        {
+            printStats();
+        }
+        else if (serialLine == "reset")
+        {
+            scheduler.resetStats();
+            stopLatency.reset();
+            fireLateness.reset();
+            sound->commands.resetStats();
+            Serial.println("Loop stats cleared");
+        }
+        else if (serialLine == "push")
+        {
+            pushLoopStats = !pushLoopStats;
+            Serial.printf("Loop stats upload %s\n", pushLoopStats ? "on" : "off");
+        }
+        else if (serialLine == "sleep")
+        {
+            power->setSleep(!power->isSleepEnabled());
+            Serial.printf("Light sleep %s\n", power->isSleepEnabled() ? "on" : "off");
+        }
+        else if (serialLine.length() > 0)
+        {
+            Serial.println("Commands: stats, reset, push, sleep");
+        }
+        serialLine = "";
+    }
+}
+
+// Prints Loop, LCD and Clock Statistics
+void Alarm::printStats()
+{
+    scheduler.printStats();
+    Serial.printf("Stop button: %u presses, p50 %uus, p99 %uus, max %uus\n",
+                  stopLatency.getCount(), stopLatency.percentile(50), stopLatency.percentile(99), stopLatency.getMax());
+    Serial.printf("Alarms: %d of %d slots, %u dropped by the last sync, %u rang, p99 %ums late, max %ums\n",
+                  alarms.size(), MAX_ALARMS, alarmsDropped,
+                  fireLateness.getCount(), fireLateness.percentile(99), fireLateness.getMax());
+    sound->commands.printStats();
+    sound->ringtones.printStats();
+    uplink.printStats();
+    localApi->printStats();
+    houseSync->printStats();
+    power->printStats();
+    display->printStats();
+    rtc->printClock();
+    logger.printStats();
+
+    if (pushLoopStats)
+    {
+        hal.cloud.pushStats(scheduler.statsJson());
+    }
 }
 
 void Alarm::updateAll()
 {
-    // Serial.print(1);
-    network->runFirebaseLoop();
-    // Serial.print(2);
-    rtc->runRTCLoop(); // Start running the RTC
-    // Serial.print(3);
-    display->updateDisplay(); // Update the Display with the new time
-    // Serial.print(4);
-    updateAlarm(); // Check for Alarms
-    // Serial.print(5);
-    sound->updateSound(); // Update Sound
-    // Serial.print(6);
+    scheduler.runDue(); // Run whatever is due
+    power->idle();      // Then wait (or sleep) until the next deadline
 }
 
 // Loads Alarms
 void Alarm::initAlarm()
 {
-    // Implementation here
+    // Alarms Due Less than maxRingTime Ago Still Ring
+    nextMinute = (rtc->getEpochNow() - maxRingTime) / 60 + 1;
+
+    // Last Synced Alarms, so they Ring even if the Network Never Comes Up
+    AlarmSet saved;
+    if (store.load(saved))
+    {
+        LOG_INFO(LOG_ALARM, "Loaded %u alarms from flash", (unsigned)saved.alarms.size());
+        syncAlarms(saved);
+        return;
+    }
 
     // Set Alarm 45 Seconds From Start Time
-    RtcDateTime curTime = rtc->getTimeNow();
-    RtcDateTime newTime = curTime.operator+(15);
+    uint32_t newTime = rtc->getEpochNow() + 15;
 
     addAlarm(newTime);
 
-    // addAlarm(newTime.operator+(80));
+    // addAlarm(newTime + 80);
+}
+
+// Turns off Alarm when the Stop Button Goes Down
+void Alarm::onStopButton(const ButtonEvent &event)
+{
+    if (event.type != BUTTON_PRESS)
+    {
+        return;
+    }
+
+    if (turnOffAlarm())
+    {
+        // Press to Player Stopped, Including Time the Edge Waited in the Queue
+        uint32_t took = hal.clock.micros() - event.pressedAt;
+        stopLatency.record(took);
+        LOG_INFO(LOG_ALARM, "Alarm stopped %lums after the press", (unsigned long)(took / 1000));
+    }
 }
 
 // Runs Alarm Loop - Checks for Alarms
 void Alarm::updateAlarm()
 {
-    static unsigned long timer = millis();
-    static unsigned long debounce = millis(); // Temporarily prohibits turning off alarm during short period.
+    // Checks for Alarms
+    uint32_t now = rtc->getEpochNow();
+
+    // Stop the Ringing Alarm once its Ring Time is Up
+    // Uses >= so a stalled loop can't skip past the stop second
+    AlarmItem *ringing = alarms.get(currentAlarm);
+    if (ringing != nullptr && now >= ringStopAt)
+    {
+        stopAlarm(*ringing, STOP_TIMED_OUT);
+    }
+
+    refreshCalendar();
 
-    // Checks for Attempt to Stop Alarm
-    if (millis() - debounce > 500)
+    // Weekday Rules, One Minute at a Time so Minutes Slept or Stalled Through are Caught Up
+    // Most minutes are a single bit test, a stepped clock starts over instead of replaying or skipping ahead
+    uint32_t minute = now / 60;
+    int32_t behind = (int32_t)(minute - nextMinute); // -1 when Caught Up
+    if (behind < -1 || behind > (int32_t)MINUTES_PER_WEEK)
     {
-        // Only set debounce if you do something
-        if (digitalRead(alarmStopPin) == HIGH && turnOffAlarm())
-        { // Is true only if Alarm Turned Off
-            // Set Debounce
-            debounce = millis();
+        nextMinute = (now - maxRingTime) / 60 + 1;
+    }
+    for (; nextMinute <= minute; nextMinute++)
+    {
+        int16_t slots[MAX_ALARMS];
+        int due = calendar.dueAt(nextMinute, slots, MAX_ALARMS);
+        for (int i = 0; i < due; i++)
+        {
+            fireAlarm(slots[i], nextMinute * 60, now);
         }
     }
 
-    // Checks for Alarms
-    if (millis() - timer > 1000 || timer == 0)
+    // Dated Alarms, to the Second
+    DatedOccurrence occurrence;
+    while (calendar.takeDue(now, occurrence))
     {
-        timer = millis();
+        fireAlarm(occurrence.slot, occurrence.fireAt, now);
+    }
+}
 
-        RtcDateTime now = rtc->getTimeNow();
+// Rings One Occurrence, Unless it's Skipped or Too Late
+void Alarm::fireAlarm(int slot, uint32_t fireAt, uint32_t now)
+{
+    AlarmItem &alarmItem = alarms[slot];
+    if (!alarms.isUsed(slot))
+    {
+        return;
+    }
 
-        // Loop through Alarms
-        for (size_t i = 0; i < alarms.size(); i++)
-        {
-            AlarmItem &alarmItem = alarms[i];
-            RtcDateTime alarmTime = alarmItem.time;
-           
+    if (alarmItem.is(ALARM_REPEATING) && alarmItem.skipDate == fireAt / SECONDS_PER_DAY)
+    {
+        LOG_INFO(LOG_ALARM, "Skipped Alarm %s today", alarmItem.id);
+    }
+    else if (now - fireAt < (uint32_t)maxRingTime) // Late Alarms (Loop Stalled) Still Ring as Long as They're Inside Their Ring Time
+    {
+        runAlarm(alarmItem, fireAt);
+    }
+    else
+    {
+        LOG_WARN(LOG_ALARM, "Missed Alarm %s by %us", alarmItem.id, now - fireAt);
+    }
 
-            if (alarmItem.active && !alarmItem.hasRang && !alarmItem.currentlyRinging && (now.operator==(alarmTime) || (now.operator>=(alarmTime) && now.operator<=(alarmTime.operator+(10)))))
-            {
-                runAlarm(alarmItem);
-                Serial.printf("AlarmItem currentlyRinging is true? %s\n", alarmItem.currentlyRinging ? "true" : "false");
-            }
-            else if (alarmItem.currentlyRinging && now.operator==(alarmTime.operator+(maxRingTime)))
-            {
-                stopAlarm(alarmItem);
-            }
-            else if (now.operator==(alarmTime.operator+(maxRingTime)))
+    if (!alarmItem.is(ALARM_REPEATING))
+    {
+        alarmItem.set(ALARM_HAS_RANG, true); // Dated Alarm is Done, the Next Compile Leaves it Out
+    }
+}
+
+// Recompiles the Calendar if the Rules Changed
+void Alarm::refreshCalendar()
+{
+    if (rulesChanged)
+    {
+        calendar.compile(alarms);
+        rulesChanged = false;
+    }
+}
+
+// Microseconds until the Earliest Scheduled Alarm (-1 if None)
+// A skipped occurrence only means waking early for nothing
+int64_t Alarm::microsUntilNextAlarm()
+{
+    refreshCalendar();
+    uint32_t next = calendar.nextFireAt(nextMinute * 60);
+    if (next == 0)
+    {
+        return -1;
+    }
+
+    int64_t until = rtc->microsUntil(next);
+    return until > 0 ? until : 0;
+}
+
+void Alarm::addAlarm(uint32_t time)
+{
+    CivilTime civil = toCivil(time);
+    LOG_INFO(LOG_ALARM, "New Alarm Set at %02d:%02d:%02d", civil.hour, civil.minute, civil.second);
+
+    int slot = alarms.add();
+    if (slot < 0)
+    {
+        LOG_WARN(LOG_ALARM, "Alarm table is full, alarm not set");
+        return;
+    }
+
+    // One-Shot Alarm at a Specific Time
+    AlarmItem &alarmItem = alarms[slot];
+    alarmItem.fireAt = time;
+    alarmItem.hour = civil.hour;
+    alarmItem.minute = civil.minute;
+    alarmItem.set(ALARM_ACTIVE, true);
+    rulesChanged = true;
+}
+
+// Epoch Day hour:minute Comes Next, for One-Shots Sent without a Date
+uint32_t Alarm::nextDateOf(int hour, int minute)
+{
+    uint32_t now = rtc->getEpochNow();
+    uint32_t today = now / SECONDS_PER_DAY;
+    return today * SECONDS_PER_DAY + hour * 3600 + minute * 60 > now ? today : today + 1;
+}
+
+// Alarm from its Rules, -1 if Full
+// Weekday alarms ring every week from now on, a dated one rings once at hour:minute on its date
+// and one with neither rings once at the next hour:minute
+int Alarm::newAlarm(const AlarmPatch &record)
+{
+    int slot = alarms.add();
+    if (slot < 0)
+    {
+        LOG_WARN(LOG_ALARM, "Alarm table is full, dropping alarm %s", record.id);
+        return -1;
+    }
+
+    AlarmItem &alarmItem = alarms[slot];
+    alarmItem.hour = record.hour;
+    alarmItem.minute = record.minute;
+    copyField(alarmItem.id, sizeof(alarmItem.id), record.id);
+    copyField(alarmItem.key, sizeof(alarmItem.key), record.key);
+    alarmItem.sound = soundOf(record);
+    alarmItem.days = record.days;
+    alarmItem.skipDate = record.skipDate;
+    uint32_t date = record.days == 0 && record.date == 0 ? nextDateOf(record.hour, record.minute) : record.date;
+    alarmItem.fireAt = date * SECONDS_PER_DAY + record.hour * 3600 + record.minute * 60;
+    alarmItem.set(ALARM_ACTIVE, record.active);
+    alarmItem.set(ALARM_REPEATING, record.days != 0);
+    rulesChanged = true;
+    return slot;
+}
+
+// Sound Number, Looked Up if it was Sent by Name
+// Names are resolved here, off the ring path, unknown ones ring the standard sequence
+uint8_t Alarm::soundOf(const AlarmPatch &patch)
+{
+    if (patch.soundName[0] == '\0')
+    {
+        return patch.sound;
+    }
+
+    int found = sound->findSound(patch.soundName);
+    if (found < 0)
+    {
+        LOG_WARN(LOG_ALARM, "No sound named %s for alarm %s, using the standard one", patch.soundName, patch.id);
+        return 0;
+    }
+    return found;
+}
+
+// Removes Alarm in Slot, Stopping it if it's Ringing
+void Alarm::removeAlarm(int slot)
+{
+    if (alarms[slot].is(ALARM_RINGING))
+    {
+        stopAlarm(alarms[slot], STOP_REMOVED);
+    }
+    alarms.remove(slot);
+    rulesChanged = true;
+}
+
+// Syncs Alarms from Firebase
+// Alarms are Updated in Place, Unchanged Ones Keep their State so they don't Ring Twice
+void Alarm::syncAlarms(const AlarmSet &set)
+{
+    bool kept[MAX_ALARMS] = {};     // Slots Matched by the New Set
+    bool matched[MAX_ALARMS] = {};  // Records that Matched an Existing Alarm
+    size_t count = set.alarms.size() < (size_t)MAX_ALARMS ? set.alarms.size() : MAX_ALARMS;
+
+    alarmsDropped = set.dropped + (set.alarms.size() - count);
+    if (alarmsDropped > 0)
+    {
+        LOG_WARN(LOG_ALARM, "%u alarms don't fit the table of %d, dropping them", alarmsDropped, MAX_ALARMS);
+    }
+
+    // Match Records to Unchanged Alarms, even if their Key Moved
+    for (size_t i = 0; i < count; i++)
+    {
+        const AlarmPatch &alarmRecord = set.alarms[i];
+        for (int slot = 0; slot < MAX_ALARMS; slot++)
+        {
+            AlarmItem &alarmItem = alarms[slot];
+            if (alarms.isUsed(slot) && !kept[slot] && alarmItem.key[0] != '\0' &&
+                alarmItem.hour == alarmRecord.hour && alarmItem.minute == alarmRecord.minute &&
+                alarmItem.is(ALARM_REPEATING) == (alarmRecord.days != 0) &&
+                (alarmItem.is(ALARM_REPEATING) || alarmRecord.date == 0 || alarmItem.fireAt / SECONDS_PER_DAY == alarmRecord.date) &&
+                fieldEquals(alarmItem.id, sizeof(alarmItem.id), alarmRecord.id))
             {
-                Serial.println("Alarm Item CurrentlyRinging is false ig");
-                Serial.println(alarmItem.currentlyRinging);
-                stopAlarm(alarmItem);
+                copyField(alarmItem.key, sizeof(alarmItem.key), alarmRecord.key);
+                alarmItem.set(ALARM_ACTIVE, alarmRecord.active);
+                alarmItem.sound = soundOf(alarmRecord);
+                alarmItem.days = alarmRecord.days;
+                alarmItem.skipDate = alarmRecord.skipDate;
+                kept[slot] = true;
+                matched[i] = true;
+                break;
             }
         }
     }
+
+    // Drop Alarms that Aren't in the Set Anymore
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        if (alarms.isUsed(slot) && !kept[slot])
+        {
+            removeAlarm(slot);
+        }
+    }
+
+    // Then Add the New Ones into the Freed Slots
+    for (size_t i = 0; i < count; i++)
+    {
+        const AlarmPatch &alarmRecord = set.alarms[i];
+        if (matched[i])
+        {
+            continue;
+        }
+
+        newAlarm(alarmRecord);
+    }
+    rulesChanged = true; // Active flags and weekdays may have changed in place
+
+    // Print Updated Alarms
+    LOG_INFO(LOG_ALARM, "Updated Alarms: %d", alarms.size());
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        if (alarms.isUsed(slot))
+        {
+            AlarmItem &alarmItem = alarms[slot];
+            LOG_DEBUG(LOG_ALARM, "Alarm %s: %02d:%02d", alarmItem.id, alarmItem.hour, alarmItem.minute);
+        }
+    }
 }
 
-void Alarm::addAlarm(RtcDateTime time)
+// Applies Alarm Changes Handed Over by the Network Task
+void Alarm::applyCloudUpdates()
 {
-    Serial.printf("New Alarm Set at %02d:%02d:%02d\n", time.Hour(), time.Minute(), time.Second());
+    static AlarmSet set; // Reused so its buffer isn't reallocated every sync
+    bool changed = false;
+
+    if (hal.cloud.takeAlarmSet(set))
+    {
+        lastSetSeq = set.seq;
+        syncAlarms(set);
+        changed = true;
+    }
+
+    AlarmPatch patch;
+    while (hal.cloud.takePatch(patch))
+    {
+        // Patches made before the latest full set are already part of it
+        if (patch.seq > lastSetSeq)
+        {
+            applyAlarmPatch(patch);
+            changed = true;
+        }
+    }
 
-    AlarmItem newAlarm(time);
-    alarms.push_back(newAlarm);
+    if (changed)
+    {
+        saveAlarms();
+        localApi->alarmsChanged();
+    }
 }
 
-void Alarm::syncAlarms(FirebaseJsonArray &arr)
+// LAN Edit, Armed and Saved before it Returns
+// Same path as a Firebase patch, the app's write to Firebase comes back later as the same change
+void Alarm::applyLocalEdit(const AlarmPatch &patch)
 {
-    vector<AlarmItem> newAlarms; // Will be an array of alarms
-
-    FirebaseJsonData result;
+    applyAlarmPatch(patch);
+    refreshCalendar();
+    saveAlarms();
+    localApi->alarmsChanged();
+}
 
-    for (size_t i = 0; i < arr.size(); i++)
+// Writes Keyed Alarms (from Firebase or the LAN) to Flash if they Changed
+// Alarms added on the clock itself, like the boot alarm, have no key and aren't saved
+void Alarm::saveAlarms()
+{
+    AlarmSet set;
+    set.alarms.reserve(alarms.size());
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
     {
-        // result now used as temporary object to get the parse results
-        arr.get(result, i);
+        AlarmItem &alarmItem = alarms[slot];
+        if (!alarms.isUsed(slot) || alarmItem.key[0] == '\0')
+        {
+            continue;
+        }
 
-        // Print its value
-        // Serial.print("Array index: ");
-        // Serial.print(i);
-        // Serial.print(", type: ");
-        // Serial.print(result.type);
-        // Serial.print(", value: ");
-        // Serial.println(result.to<String>());
+        AlarmPatch record;
+        record.hour = alarmItem.hour;
+        record.minute = alarmItem.minute;
+        copyField(record.id, sizeof(record.id), alarmItem.id);
+        copyField(record.key, sizeof(record.key), alarmItem.key);
+        record.active = alarmItem.is(ALARM_ACTIVE);
+        record.sound = alarmItem.sound;
+        record.days = alarmItem.is(ALARM_REPEATING) ? alarmItem.days : 0;
+        record.date = alarmItem.is(ALARM_REPEATING) ? 0 : alarmItem.fireAt / SECONDS_PER_DAY;
+        record.skipDate = alarmItem.skipDate;
+        set.alarms.push_back(record);
+    }
+
+    if (store.save(set))
+    {
+        LOG_INFO(LOG_ALARM, "Saved %u alarms to flash", (unsigned)set.alarms.size());
+    }
+}
 
-        FirebaseJson json;
-        // Get FirebaseJson data
-        result.get<FirebaseJson>(json);
+// Adds, Updates or Removes One Alarm
+// A field change for an alarm the table doesn't hold means an earlier change was missed, so everything is refetched
+void Alarm::applyAlarmPatch(const AlarmPatch &patch)
+{
+    int slot = alarms.find(patch.key);
 
-        // Parse the JSON object as list
-        // Get the number of items
-        size_t len = json.iteratorBegin();
-        FirebaseJson::IteratorValue value;
+    if (patch.type == AlarmPatch::REMOVE)
+    {
+        if (slot >= 0)
+        {
+            LOG_INFO(LOG_ALARM, "Removed Alarm %s", alarms[slot].id);
+            removeAlarm(slot);
+        }
+        return;
+    }
 
-        int hour;
-        int minute;
-        String id;
-        bool active;
+    if (slot < 0 && patch.type == AlarmPatch::UPSERT)
+    {
+        LOG_WARN(LOG_ALARM, "Change to unknown alarm %s, fetching every alarm again", patch.key);
+        hal.cloud.requestRefetch();
+        return;
+    }
 
-        for (size_t i = 0; i < len; i++)
+    if (slot < 0)
+    {
+        // New Alarm
+        slot = newAlarm(patch);
+        if (slot < 0)
         {
-            value = json.valueAt(i);
+            return;
+        }
 
-            // Serial.printf("%d, Type: %s, Name: %s, Value: %s\n", i, value.type == FirebaseJson::JSON_OBJECT ? "object" : "array", value.key.c_str(), value.value.c_str());
+        AlarmItem &alarmItem = alarms[slot];
 
-            if (value.key == "hour")
-            {
-                hour = value.value.toInt();
-            }
-            else if (value.key == "minute")
-            {
-                minute = value.value.toInt();
-            }
-            else if (value.key == "id")
-            {
-                id = value.value;
-            }
-            else if (value.key == "active")
-            {
-                active = value.value == "true" ? true : false;
-            }
-            else
+        LOG_INFO(LOG_ALARM, "Added Alarm %s: %02d:%02d", alarmItem.id, alarmItem.hour, alarmItem.minute);
+        return;
+    }
+
+    // Update Existing Alarm in Place, a Replacement Sets Every Field
+    AlarmItem &alarmItem = alarms[slot];
+    uint8_t fields = patch.type == AlarmPatch::REPLACE ? 0xFF : patch.fields;
+
+    if (fields & PATCH_ID)
+    {
+        copyField(alarmItem.id, sizeof(alarmItem.id), patch.id);
+    }
+    if (fields & PATCH_ACTIVE)
+    {
+        // Turned back on, a one-shot rings again, at the next hour:minute if its day has gone by
+        if (patch.active && !alarmItem.is(ALARM_ACTIVE) && !alarmItem.is(ALARM_REPEATING))
+        {
+            alarmItem.set(ALARM_HAS_RANG, false);
+            if (alarmItem.fireAt <= rtc->getEpochNow())
             {
-                // Serial.print("No match: ");
-                // Serial.println(value.key);
+                alarmItem.fireAt = nextDateOf(alarmItem.hour, alarmItem.minute) * SECONDS_PER_DAY +
+                                   alarmItem.hour * 3600 + alarmItem.minute * 60;
             }
         }
-        // Clear all list to free memory
-        json.iteratorEnd();
+        alarmItem.set(ALARM_ACTIVE, patch.active);
+        rulesChanged = true;
+    }
+    if (fields & PATCH_SOUND)
+    {
+        alarmItem.sound = soundOf(patch);
+    }
+    if (fields & PATCH_SKIP)
+    {
+        alarmItem.skipDate = patch.skipDate; // Checked when it fires, the calendar doesn't change
+    }
+    if (fields & (PATCH_HOUR | PATCH_MINUTE | PATCH_DAYS | PATCH_DATE))
+    {
+        uint32_t date = alarmItem.fireAt / SECONDS_PER_DAY;
+        bool wasRepeating = alarmItem.is(ALARM_REPEATING);
+        uint8_t hour = fields & PATCH_HOUR ? patch.hour : alarmItem.hour;
+        uint8_t minute = fields & PATCH_MINUTE ? patch.minute : alarmItem.minute;
+        uint8_t days = fields & PATCH_DAYS ? patch.days : (wasRepeating ? alarmItem.days : 0);
+
+        // A one-shot sent without a date rings at the next hour:minute, like a new alarm would,
+        // whether it was weekly or had its time moved, the day it was set for may be gone
+        if ((patch.fields & PATCH_DATE) && patch.date != 0)
+        {
+            date = patch.date;
+        }
+        else if (days == 0 && (wasRepeating || hour != alarmItem.hour || minute != alarmItem.minute))
+        {
+            date = nextDateOf(hour, minute);
+        }
+        uint32_t fireAt = date * SECONDS_PER_DAY + hour * 3600 + minute * 60;
 
-        RtcDateTime now = rtc->getTimeNow();
-        // Add Alarm to newAlarms vector
-        newAlarms.push_back(AlarmItem(now, hour, minute, id, active));
+        // Same rules sent again keep the alarm's state, so it doesn't ring twice
+        if (hour != alarmItem.hour || minute != alarmItem.minute || (days != 0) != wasRepeating ||
+            (days != 0 ? days != alarmItem.days : fireAt != alarmItem.fireAt))
+        {
+            alarmItem.hour = hour;
+            alarmItem.minute = minute;
+            alarmItem.days = days;
+            alarmItem.set(ALARM_REPEATING, days != 0);
+            alarmItem.fireAt = fireAt; // Dated alarm rings again at its new time
+            alarmItem.set(ALARM_HAS_RANG, false);
+            rulesChanged = true;
+        }
     }
 
-    // Update Alarms Array
-    alarms = newAlarms;
+    LOG_INFO(LOG_ALARM, "Updated Alarm %s: %02d:%02d", alarmItem.id, alarmItem.hour, alarmItem.minute);
+}
+
+// Fires Alarm Item & Rings, Together with the House if it's Shared
+void Alarm::runAlarm(AlarmItem &alarmItem, uint32_t fireAt)
+{
+    // Make sure Alarm hasn't rang and isn't currently ringing
+    if (alarmItem.is(ALARM_HAS_RANG) || alarmItem.is(ALARM_RINGING))
+    {
+        return;
+    }
 
-    // Print Updated Array Vector
-        Serial.println("Updated Alarms:");
-    for (size_t i = 0; i < alarms.size(); i++)
+    // Other clocks with this alarm start it at the same instant, a little after its time
+    if (houseSync->holdRing(alarmItem, fireAt))
     {
-        AlarmItem &alarmItem = alarms[i];
-        Serial.printf("Alarm %s: %02d:%02d\n", alarmItem.id.c_str(), alarmItem.time.Hour(), alarmItem.time.Minute());
+        return;
     }
+    startRing(alarmItem, fireAt);
 }
 
-// Fires Alarm Item & Rings
-void Alarm::runAlarm(AlarmItem &alarmItem)
+// Starts Ringing Right Now, Replacing Whatever Rings
+void Alarm::startRing(AlarmItem &alarmItem, uint32_t fireAt)
 {
     // Stop other alarms
-    turnOffAlarm();
+    turnOffAlarm(STOP_REPLACED);
 
-    // Make sure Alarm hasn't rang and isn't currently ringing
-    if (!alarmItem.hasRang && !alarmItem.currentlyRinging)
-    {
-        currentAlarm = &alarmItem;
-        alarmItem.hasRang = true;          // Alarm has Rang
-        alarmItem.currentlyRinging = true; // Currently Ringing now
+    currentAlarm = alarms.handleOf(&alarmItem - &alarms[0]);
+    int64_t late = -rtc->microsUntil(fireAt);
+    fireLateness.record(late > 0 ? late / 1000 : 0);
+    ringStopAt = fireAt + maxRingTime;
+    ringStartedAt = rtc->getEpochNow();
+    alarmItem.set(ALARM_RINGING, true);  // Currently Ringing now
 
-        Serial.printf("Check again: CurrentAlarm is currently Ringing: %s\n", currentAlarm->currentlyRinging ? "true" : "false");
+    LOG_INFO(LOG_ALARM, "Ringing Alarm %s", alarmItem.id);
 
-        sound->startRinging(); // Start Ringing It
-    }
+    sound->startRinging(alarmItem.sound); // Start Ringing It
+    uplink.alarmFired(alarmItem.key, ringStartedAt);
+    houseSync->ringStarted(alarmItem, fireAt);
 }
 
 // Stops Specific Alarm
-void Alarm::stopAlarm(AlarmItem &alarmItem)
+void Alarm::stopAlarm(AlarmItem &alarmItem, StopReason reason)
 {
-    Serial.println("Attempting to Stop");
-    if (alarmItem.currentlyRinging)
+    LOG_DEBUG(LOG_ALARM, "Attempting to Stop");
+    if (!alarmItem.is(ALARM_RINGING))
     {
-        currentAlarm = nullptr;
-        alarmItem.currentlyRinging = false; // Stop Ringing
-        sound->stopRinging();               // Stop Sound
-    }
-    else
-    {
-        Serial.println("Stop failed! Attempting to stop anyways");
-        currentAlarm = nullptr;
-        alarmItem.currentlyRinging = false; // Stop Ringing
-        sound->stopRinging();
+        LOG_WARN(LOG_ALARM, "Stop failed! Attempting to stop anyways");
     }
+
+    currentAlarm = AlarmHandle();
+    alarmItem.set(ALARM_RINGING, false); // Stop Ringing
+    sound->stopRinging();                // Stop Sound
+
+    uint32_t now = rtc->getEpochNow();
+    uplink.alarmStopped(alarmItem.key, reason, now, now - ringStartedAt);
+    houseSync->ringStopped(alarmItem, reason);
 }
 
 // Turns off Alarm when button pressed.
-bool Alarm::turnOffAlarm()
+bool Alarm::turnOffAlarm(StopReason reason)
 {
-    if (currentAlarm != nullptr)
+    AlarmItem *ringing = alarms.get(currentAlarm);
+    if (ringing != nullptr)
     {
-        stopAlarm(*currentAlarm);
+        stopAlarm(*ringing, reason);
         return true; // Successfully Turned off Alarm
     }
     return false; // Didn't turn off alarm
-}
\ No newline at end of file
+}
@@ -0,0 +1,133 @@
+// Alarm Rules Compiled into a Week of Minutes
+
+// Project Specific Headers
+#include "AlarmCalendar.h"
+
+// Standard Libraries
+#include <string.h>
+#include <algorithm>
+
+static bool weeklyEarlier(const WeeklyOccurrence &a, const WeeklyOccurrence &b)
+{
+    return a.minute < b.minute;
+}
+
+static bool datedEarlier(const DatedOccurrence &a, const DatedOccurrence &b)
+{
+    return a.fireAt < b.fireAt;
+}
+
+AlarmCalendar::AlarmCalendar()
+{
+    memset(occupied, 0, sizeof(occupied));
+}
+
+// Rebuilds Both Lists from the Active Alarms, Dated Ones that Already Rang are Left Out
+void AlarmCalendar::compile(AlarmTable &alarms)
+{
+    memset(occupied, 0, sizeof(occupied));
+    weeklyCount = 0;
+    datedCount = 0;
+    datedNext = 0;
+
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        AlarmItem &alarmItem = alarms[slot];
+        if (!alarms.isUsed(slot) || !alarmItem.is(ALARM_ACTIVE))
+        {
+            continue;
+        }
+
+        if (!alarmItem.is(ALARM_REPEATING))
+        {
+            if (!alarmItem.is(ALARM_HAS_RANG))
+            {
+                dated[datedCount++] = {alarmItem.fireAt, (int16_t)slot};
+            }
+            continue;
+        }
+
+        for (int day = 0; day < 7; day++)
+        {
+            if (alarmItem.days & (1 << day))
+            {
+                uint16_t minute = day * 1440 + alarmItem.hour * 60 + alarmItem.minute;
+                occupied[minute / 32] |= 1UL << (minute % 32);
+                weekly[weeklyCount++] = {minute, (int16_t)slot};
+            }
+        }
+    }
+
+    std::sort(weekly, weekly + weeklyCount, weeklyEarlier);
+    std::sort(dated, dated + datedCount, datedEarlier);
+
+    cachedFrom = 1;
+    cachedNext = 0; // Empty Range, the Next Ask Looks it Up
+}
+
+// Does Any Weekday Rule Fire in this Minute
+bool AlarmCalendar::isOccupied(uint32_t epochMinute) const
+{
+    uint32_t minute = minuteOfWeek(epochMinute);
+    return (occupied[minute / 32] >> (minute % 32)) & 1;
+}
+
+// Index of the First Occurrence at or after a Minute of the Week
+int AlarmCalendar::firstWeeklyAt(uint32_t minute) const
+{
+    WeeklyOccurrence key = {(uint16_t)minute, 0};
+    return std::lower_bound(weekly, weekly + weeklyCount, key, weeklyEarlier) - weekly;
+}
+
+// Slots Whose Weekday Rule Fires in this Minute
+int AlarmCalendar::dueAt(uint32_t epochMinute, int16_t *slots, int maxSlots) const
+{
+    if (!isOccupied(epochMinute))
+    {
+        return 0;
+    }
+
+    uint32_t minute = minuteOfWeek(epochMinute);
+    int found = 0;
+    for (int i = firstWeeklyAt(minute); i < weeklyCount && weekly[i].minute == minute && found < maxSlots; i++)
+    {
+        slots[found++] = weekly[i].slot;
+    }
+    return found;
+}
+
+// Next Dated Occurrence at or before now, false if None
+bool AlarmCalendar::takeDue(uint32_t now, DatedOccurrence &occurrence)
+{
+    if (datedNext >= datedCount || dated[datedNext].fireAt > now)
+    {
+        return false;
+    }
+
+    occurrence = dated[datedNext++];
+    return true;
+}
+
+// Earliest Firing at or after from (Epoch Seconds), 0 if Nothing is Set
+// The weekly answer holds until from passes it, so it's only searched for once per firing
+uint32_t AlarmCalendar::nextFireAt(uint32_t from)
+{
+    if (weeklyCount > 0 && (from < cachedFrom || from > cachedNext))
+    {
+        uint32_t epochMinute = (from + 59) / 60;
+        uint32_t minute = minuteOfWeek(epochMinute);
+        int next = firstWeeklyAt(minute);
+
+        uint32_t ahead = next < weeklyCount ? weekly[next].minute - minute
+                                            : weekly[0].minute + MINUTES_PER_WEEK - minute; // Wraps into Next Week
+        cachedFrom = from;
+        cachedNext = (epochMinute + ahead) * 60;
+    }
+
+    uint32_t next = weeklyCount > 0 ? cachedNext : 0;
+    if (datedNext < datedCount && (next == 0 || dated[datedNext].fireAt < next))
+    {
+        next = dated[datedNext].fireAt;
+    }
+    return next;
+}
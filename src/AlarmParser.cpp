@@ -0,0 +1,364 @@
+// Reads Alarm JSON Straight from the Payload Text
+
+// Project Specific Headers
+#include "AlarmParser.h"
+#include "Calendar.h"
+
+// Standard Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Position in the Payload, Never Read Past end
+struct Cursor {
+    const char *at;
+    const char *end;
+};
+
+static void skipSpace(Cursor &c)
+{
+    while (c.at < c.end && (*c.at == ' ' || *c.at == '\t' || *c.at == '\n' || *c.at == '\r'))
+    {
+        c.at++;
+    }
+}
+
+// Skips Space, then Takes ch if it's Next
+static bool consume(Cursor &c, char ch)
+{
+    skipSpace(c);
+    if (c.at < c.end && *c.at == ch)
+    {
+        c.at++;
+        return true;
+    }
+    return false;
+}
+
+static char peek(Cursor &c)
+{
+    skipSpace(c);
+    return c.at < c.end ? *c.at : '\0';
+}
+
+static int hexDigit(char ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Reads a Quoted String into out (Cut Off to Fit), out can be nullptr to Skip it
+// Escapes are decoded, \u Characters Outside ASCII Become '?'
+static bool readString(Cursor &c, char *out, size_t size)
+{
+    if (!consume(c, '"'))
+    {
+        return false;
+    }
+
+    size_t length = 0;
+    while (c.at < c.end && *c.at != '"')
+    {
+        char ch = *c.at++;
+        if (ch == '\\')
+        {
+            if (c.at >= c.end)
+            {
+                return false;
+            }
+
+            char escape = *c.at++;
+            switch (escape)
+            {
+            case 'n': ch = '\n'; break;
+            case 't': ch = '\t'; break;
+            case 'r': ch = '\r'; break;
+            case 'b': ch = '\b'; break;
+            case 'f': ch = '\f'; break;
+            case 'u':
+            {
+                int code = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    int digit = c.at < c.end ? hexDigit(*c.at++) : -1;
+                    if (digit < 0)
+                    {
+                        return false;
+                    }
+                    code = code * 16 + digit;
+                }
+                ch = code < 0x80 ? (char)code : '?';
+                break;
+            }
+            default: ch = escape; break; // \" \\ \/
+            }
+        }
+
+        if (out != nullptr && length + 1 < size)
+        {
+            out[length++] = ch;
+        }
+    }
+
+    if (out != nullptr && size > 0)
+    {
+        out[length] = '\0';
+    }
+    return consume(c, '"');
+}
+
+// Reads a String's Text, or a Number or Literal as Written
+static bool readScalar(Cursor &c, char *out, size_t size)
+{
+    if (peek(c) == '"')
+    {
+        return readString(c, out, size);
+    }
+
+    size_t length = 0;
+    while (c.at < c.end && *c.at != ',' && *c.at != '}' && *c.at != ']' &&
+           *c.at != ' ' && *c.at != '\t' && *c.at != '\n' && *c.at != '\r')
+    {
+        if (length + 1 < size)
+        {
+            out[length++] = *c.at;
+        }
+        c.at++;
+    }
+    out[length] = '\0';
+    return length > 0;
+}
+
+// Skips Any Value, Nested Ones by Counting Brackets so the Stack Never Grows
+static bool skipValue(Cursor &c)
+{
+    char first = peek(c);
+    if (first == '"')
+    {
+        return readString(c, nullptr, 0);
+    }
+    if (first != '{' && first != '[')
+    {
+        char scratch[MAX_FIELD_TEXT];
+        return readScalar(c, scratch, sizeof(scratch));
+    }
+
+    int depth = 0;
+    while (c.at < c.end)
+    {
+        char ch = *c.at;
+        if (ch == '"')
+        {
+            if (!readString(c, nullptr, 0))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        c.at++;
+        if (ch == '{' || ch == '[')
+        {
+            depth++;
+        }
+        else if ((ch == '}' || ch == ']') && --depth == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads Every Field of the Object at the Cursor into a Patch
+static bool readObject(Cursor &c, AlarmPatch &patch)
+{
+    if (!consume(c, '{'))
+    {
+        return false;
+    }
+    if (consume(c, '}'))
+    {
+        return true;
+    }
+
+    char key[MAX_FIELD_TEXT];
+    char value[MAX_FIELD_TEXT];
+    do
+    {
+        if (!readString(c, key, sizeof(key)) || !consume(c, ':'))
+        {
+            return false;
+        }
+
+        char next = peek(c);
+        if (next == '{' || next == '[')
+        {
+            if (!skipValue(c)) // Nothing Nested is Used
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (!readScalar(c, value, sizeof(value)))
+            {
+                return false;
+            }
+            readAlarmField(key, value, patch);
+        }
+    } while (consume(c, ','));
+
+    return consume(c, '}');
+}
+
+// Reads One List Entry, Keeping it if it's an Alarm and there's Room
+static bool readEntry(Cursor &c, const char *key, AlarmSet &set)
+{
+    if (peek(c) != '{')
+    {
+        return skipValue(c); // Deleted entries show up as null holes in the array
+    }
+
+    AlarmPatch record;
+    copyField(record.key, sizeof(record.key), key);
+    if (!readObject(c, record))
+    {
+        return false;
+    }
+
+    if (record.fields != 0 && set.alarms.size() < (size_t)MAX_ALARMS)
+    {
+        set.alarms.push_back(record);
+    }
+    else if (record.fields != 0)
+    {
+        set.dropped++;
+    }
+    return true;
+}
+
+// "YYYY-MM-DD" as an Epoch Day, 0 for null or Anything Else
+static uint32_t readDate(const char *value)
+{
+    int year, month, day;
+    if (sscanf(value, "%4d-%2d-%2d", &year, &month, &day) != 3 || year < 1970 || month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        return 0;
+    }
+    return toEpoch(year, month, day, 0, 0, 0) / 86400;
+}
+
+// Reads One Alarm Field into a Patch, Unknown Keys are Ignored
+void readAlarmField(const char *key, const char *value, AlarmPatch &patch)
+{
+    if (strcmp(key, "hour") == 0)
+    {
+        patch.hour = atoi(value);
+        patch.fields |= PATCH_HOUR;
+    }
+    else if (strcmp(key, "minute") == 0)
+    {
+        patch.minute = atoi(value);
+        patch.fields |= PATCH_MINUTE;
+    }
+    else if (strcmp(key, "id") == 0)
+    {
+        copyField(patch.id, sizeof(patch.id), value);
+        patch.fields |= PATCH_ID;
+    }
+    else if (strcmp(key, "active") == 0)
+    {
+        patch.active = strcmp(value, "true") == 0;
+        patch.fields |= PATCH_ACTIVE;
+    }
+    else if (strcmp(key, "sound") == 0)
+    {
+        patch.sound = atoi(value);
+        patch.soundName[0] = '\0';
+        if (value[0] < '0' || value[0] > '9')
+        {
+            copyField(patch.soundName, sizeof(patch.soundName), value); // Looked up when it's applied
+        }
+        patch.fields |= PATCH_SOUND;
+    }
+    else if (strcmp(key, "days") == 0)
+    {
+        patch.days = atoi(value) & EVERY_DAY;
+        patch.fields |= PATCH_DAYS;
+    }
+    else if (strcmp(key, "date") == 0)
+    {
+        patch.date = readDate(value);
+        patch.fields |= PATCH_DATE;
+    }
+    else if (strcmp(key, "skip") == 0)
+    {
+        patch.skipDate = readDate(value);
+        patch.fields |= PATCH_SKIP;
+    }
+}
+
+// Whole Alarm List, an Array (Keys are Indexes) or an Object of Alarms
+bool parseAlarmList(const char *json, size_t length, AlarmSet &set)
+{
+    Cursor c = {json, json + length};
+    set.alarms.clear();
+    set.alarms.reserve(32); // Only Allocates the First Time, then Grows to the Biggest List Seen
+    set.dropped = 0;
+
+    char key[ALARM_KEY_SIZE];
+    char open = peek(c);
+
+    if (open == '[')
+    {
+        consume(c, '[');
+        if (consume(c, ']'))
+        {
+            return true;
+        }
+
+        unsigned index = 0;
+        do
+        {
+            snprintf(key, sizeof(key), "%u", index++);
+            if (!readEntry(c, key, set))
+            {
+                return false;
+            }
+        } while (consume(c, ','));
+
+        return consume(c, ']');
+    }
+
+    if (open == '{')
+    {
+        consume(c, '{');
+        if (consume(c, '}'))
+        {
+            return true;
+        }
+
+        do
+        {
+            if (!readString(c, key, sizeof(key)) || !consume(c, ':') || !readEntry(c, key, set))
+            {
+                return false;
+            }
+        } while (consume(c, ','));
+
+        return consume(c, '}');
+    }
+
+    // No alarms at all
+    char literal[8];
+    return readScalar(c, literal, sizeof(literal)) && strcmp(literal, "null") == 0;
+}
+
+// One Alarm Object into a Patch, Returns false if it isn't an Object
+bool parseAlarm(const char *json, size_t length, AlarmPatch &patch)
+{
+    Cursor c = {json, json + length};
+    return readObject(c, patch);
+}
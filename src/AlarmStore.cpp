@@ -0,0 +1,178 @@
+// Keeps the Last Synced Alarms in Flash so They Ring without the Network
+
+// Project Specific Headers
+#include "AlarmStore.h"
+#include "Log.h"
+
+// Standard Libraries
+#include <stdio.h>
+#include <string.h>
+
+const char *STORE_KEY = "alarms";
+const uint32_t STORE_MAGIC = 0x4D524C41; // "ALRM"
+const uint16_t STORE_VERSION = 4; // 2 Added the Weekday, Date and Skip Rules, 3 Split the Records into Chunks, 4 Fit Push IDs
+
+// Blob Layout, Bump STORE_VERSION when it Changes
+struct StoredHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t crc; // Over Every Record after the Header
+};
+
+struct StoredAlarm {
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t active;
+    uint8_t sound;
+    char key[ALARM_KEY_SIZE]; // Null Terminated, Longer Keys are Cut Off
+    char id[ALARM_ID_SIZE];
+    uint8_t days;
+    uint8_t reserved;
+    uint16_t date;     // Epoch Day, Fits until 2149
+    uint16_t skipDate;
+};
+
+// Flash Record Holding One Chunk, "alarms0", "alarms1", ...
+static void chunkKey(char *key, size_t size, size_t chunk)
+{
+    snprintf(key, size, "%s%u", STORE_KEY, (unsigned)chunk);
+}
+
+// CRC-32 (IEEE), Bitwise since Records are Small and Rarely Checked
+static uint32_t crc32(const uint8_t *data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+AlarmStore::AlarmStore(Storage &storage) : storage(storage) {}
+
+void AlarmStore::encode(const AlarmSet &set, std::vector<uint8_t> &out)
+{
+    size_t count = set.alarms.size() < MAX_STORED_ALARMS ? set.alarms.size() : MAX_STORED_ALARMS;
+    out.assign(sizeof(StoredHeader) + count * sizeof(StoredAlarm), 0);
+
+    StoredAlarm *records = reinterpret_cast<StoredAlarm *>(out.data() + sizeof(StoredHeader));
+    for (size_t i = 0; i < count; i++)
+    {
+        const AlarmPatch &alarm = set.alarms[i];
+        records[i].hour = alarm.hour;
+        records[i].minute = alarm.minute;
+        records[i].active = alarm.active;
+        records[i].sound = alarm.sound;
+        records[i].days = alarm.days;
+        records[i].date = alarm.date;
+        records[i].skipDate = alarm.skipDate;
+        copyField(records[i].key, sizeof(records[i].key), alarm.key);
+        copyField(records[i].id, sizeof(records[i].id), alarm.id);
+    }
+
+    StoredHeader header;
+    header.magic = STORE_MAGIC;
+    header.version = STORE_VERSION;
+    header.count = count;
+    header.crc = crc32(reinterpret_cast<const uint8_t *>(records), count * sizeof(StoredAlarm));
+    memcpy(out.data(), &header, sizeof(header));
+}
+
+// Returns false if Nothing Valid is Stored
+bool AlarmStore::load(AlarmSet &set)
+{
+    StoredHeader header;
+    if (storage.read(STORE_KEY, &header, sizeof(header)) != sizeof(header))
+    {
+        image.clear();
+        return false; // Never Saved, or an Older Single-Blob Version
+    }
+
+    bool valid = header.magic == STORE_MAGIC && header.version == STORE_VERSION && header.count <= MAX_STORED_ALARMS;
+    image.assign(sizeof(StoredHeader) + (valid ? header.count : 0) * sizeof(StoredAlarm), 0);
+    memcpy(image.data(), &header, sizeof(header));
+    for (size_t first = 0; valid && first < header.count; first += STORE_CHUNK)
+    {
+        char key[16];
+        chunkKey(key, sizeof(key), first / STORE_CHUNK);
+        size_t size = (header.count - first < STORE_CHUNK ? header.count - first : STORE_CHUNK) * sizeof(StoredAlarm);
+        valid = storage.read(key, image.data() + sizeof(StoredHeader) + first * sizeof(StoredAlarm), size) == size;
+    }
+
+    const StoredAlarm *records = reinterpret_cast<const StoredAlarm *>(image.data() + sizeof(StoredHeader));
+    if (!valid || header.crc != crc32(reinterpret_cast<const uint8_t *>(records), header.count * sizeof(StoredAlarm)))
+    {
+        LOG_WARN(LOG_STORE, "Stored alarms are corrupt or from an older version, ignoring them");
+        image.clear();
+        return false;
+    }
+
+    set.alarms.clear();
+    for (size_t i = 0; i < header.count; i++)
+    {
+        AlarmPatch alarm;
+        alarm.fields = PATCH_HOUR | PATCH_MINUTE | PATCH_ID | PATCH_ACTIVE | PATCH_SOUND | PATCH_DAYS | PATCH_DATE | PATCH_SKIP;
+        alarm.hour = records[i].hour;
+        alarm.minute = records[i].minute;
+        alarm.active = records[i].active;
+        alarm.sound = records[i].sound;
+        alarm.days = records[i].days;
+        alarm.date = records[i].date;
+        alarm.skipDate = records[i].skipDate;
+        copyField(alarm.key, sizeof(alarm.key), records[i].key);
+        copyField(alarm.id, sizeof(alarm.id), records[i].id);
+        set.alarms.push_back(alarm);
+    }
+    return true;
+}
+
+// Writes only if Different, Returns true if Flash was Written
+bool AlarmStore::save(const AlarmSet &set)
+{
+    std::vector<uint8_t> encoded;
+    encode(set, encoded);
+
+    if (encoded == image)
+    {
+        return false; // Same as Flash Already Holds
+    }
+
+    // Chunks that Differ from Flash, Chunks Past the New Count are Left and Ignored
+    size_t count = (encoded.size() - sizeof(StoredHeader)) / sizeof(StoredAlarm);
+    size_t stored = image.size() < sizeof(StoredHeader) ? 0 : (image.size() - sizeof(StoredHeader)) / sizeof(StoredAlarm);
+    for (size_t first = 0; first < count; first += STORE_CHUNK)
+    {
+        size_t offset = sizeof(StoredHeader) + first * sizeof(StoredAlarm);
+        size_t size = (count - first < STORE_CHUNK ? count - first : STORE_CHUNK) * sizeof(StoredAlarm);
+        size_t storedSize = (stored > first ? (stored - first < STORE_CHUNK ? stored - first : STORE_CHUNK) : 0) * sizeof(StoredAlarm);
+        if (storedSize == size && memcmp(image.data() + offset, encoded.data() + offset, size) == 0)
+        {
+            continue;
+        }
+
+        char key[16];
+        chunkKey(key, sizeof(key), first / STORE_CHUNK);
+        if (!storage.write(key, encoded.data() + offset, size))
+        {
+            LOG_ERROR(LOG_STORE, "Couldn't save alarms to flash");
+            image.clear(); // Flash is Partly Written, Every Chunk Goes Out Next Time
+            return false;
+        }
+    }
+
+    if (!storage.write(STORE_KEY, encoded.data(), sizeof(StoredHeader)))
+    {
+        LOG_ERROR(LOG_STORE, "Couldn't save alarms to flash");
+        image.clear();
+        return false;
+    }
+
+    image.swap(encoded);
+    return true;
+}
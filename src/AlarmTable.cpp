@@ -0,0 +1,101 @@
+// Fixed-Capacity Table of Alarms, Updated in Place so the Alarm Path Never Touches the Heap
+
+// Project Specific Headers
+#include "AlarmTable.h"
+
+// Standard Libraries
+#include <string.h>
+
+// Copies Text into a Fixed Field, Always Null Terminated
+void copyField(char *field, size_t size, const char *value)
+{
+    strncpy(field, value, size - 1);
+    field[size - 1] = '\0';
+}
+
+// Returns if a Fixed Field Holds value (as Cut Off to Fit)
+bool fieldEquals(const char *field, size_t size, const char *value)
+{
+    return strncmp(field, value, size - 1) == 0;
+}
+
+AlarmTable::AlarmTable()
+{
+    memset(items, 0, sizeof(items));
+}
+
+// Claims a Cleared Slot, -1 if the Table is Full
+int AlarmTable::add()
+{
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        AlarmItem &item = items[slot];
+        if (!item.is(ALARM_USED))
+        {
+            uint8_t generation = item.generation;
+            memset(&item, 0, sizeof(item));
+            item.generation = generation;
+            item.flags = ALARM_USED;
+            count++;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+// Frees the Slot, Handles to it Go Stale
+void AlarmTable::remove(int slot)
+{
+    AlarmItem &item = items[slot];
+    if (item.is(ALARM_USED))
+    {
+        item.flags = 0;
+        item.generation++;
+        count--;
+    }
+}
+
+void AlarmTable::clear()
+{
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        remove(slot);
+    }
+}
+
+AlarmHandle AlarmTable::handleOf(int slot) const
+{
+    AlarmHandle handle;
+    handle.slot = slot;
+    handle.generation = items[slot].generation;
+    return handle;
+}
+
+// nullptr if the Alarm is Gone
+AlarmItem *AlarmTable::get(AlarmHandle handle)
+{
+    if (handle.isNone())
+    {
+        return nullptr;
+    }
+
+    AlarmItem &item = items[handle.slot];
+    if (!item.is(ALARM_USED) || item.generation != handle.generation)
+    {
+        return nullptr;
+    }
+    return &item;
+}
+
+// Slot of the Alarm with Key, -1 if Missing
+int AlarmTable::find(const char *key) const
+{
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        if (items[slot].is(ALARM_USED) && fieldEquals(items[slot].key, ALARM_KEY_SIZE, key))
+        {
+            return slot;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,205 @@
+// Queues Player Commands so the Loop Never Waits on the Player's Acks
+
+// Project Specific Headers
+#include "AudioQueue.h"
+#include "Log.h"
+
+static bool isQuery(AudioCommand command)
+{
+    return command == AUDIO_QUERY_FILES || command == AUDIO_QUERY_FOLDER;
+}
+
+// Commands of the Same Kind Replace Each Other, Only the Latest Matters
+static bool sameKind(AudioCommand a, AudioCommand b)
+{
+    // Volume, Query, or Playback (Loop/Stop)
+    return (a == AUDIO_VOLUME) == (b == AUDIO_VOLUME) && isQuery(a) == isQuery(b);
+}
+
+AudioQueue::AudioQueue(AudioPlayer &player, ClockSource &clock) : player(player), clock(clock) {}
+
+void AudioQueue::volume(uint8_t volume)
+{
+    add(AUDIO_VOLUME, volume);
+}
+
+void AudioQueue::loop(int track)
+{
+    add(AUDIO_LOOP, track);
+}
+
+// Plays SD:/folder/track.mp3 Once
+void AudioQueue::playFolder(uint8_t folder, uint8_t track)
+{
+    add(AUDIO_PLAY_FOLDER, folder << 8 | track);
+}
+
+void AudioQueue::queryFiles()
+{
+    add(AUDIO_QUERY_FILES, 0);
+}
+
+void AudioQueue::queryFolder(uint8_t folder)
+{
+    add(AUDIO_QUERY_FOLDER, folder);
+}
+
+// Goes Ahead of Everything Waiting
+// Sent right away even if the last command is unacked, a late ack for that one just counts as this one's
+void AudioQueue::stop()
+{
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (sameKind(queue[i].command, AUDIO_STOP))
+        {
+            removeAt(i);
+            coalesced++;
+        }
+    }
+
+    QueuedCommand queued = {AUDIO_STOP, 0, false};
+    if (player.isOnline())
+    {
+        transmit(queued);
+        return;
+    }
+
+    // Player isn't up yet, stop is the first thing it gets
+    for (int i = count; i > 0; i--)
+    {
+        queue[i] = queue[i - 1];
+    }
+    queue[0] = queued;
+    count++;
+}
+
+// Queues a Command, Merging it with One of its Kind
+void AudioQueue::add(AudioCommand command, uint16_t argument)
+{
+    QueuedCommand queued = {command, argument, false};
+
+    int i = 0;
+    while (i < count && !sameKind(queue[i].command, command))
+    {
+        i++;
+    }
+
+    if (i < count)
+    {
+        queue[i] = queued; // Keeps its Place in Line
+        coalesced++;
+    }
+    else if (count < AUDIO_QUEUE_SIZE)
+    {
+        queue[count++] = queued;
+        maxDepth = count > maxDepth ? count : maxDepth;
+    }
+
+    sendNext();
+}
+
+void AudioQueue::removeAt(int index)
+{
+    for (int i = index; i < count - 1; i++)
+    {
+        queue[i] = queue[i + 1];
+    }
+    count--;
+}
+
+// Sends the Oldest Command if the Player is Free
+void AudioQueue::sendNext()
+{
+    if (awaitingAck || count == 0 || !player.isOnline())
+    {
+        return;
+    }
+
+    QueuedCommand next = queue[0];
+    removeAt(0);
+    transmit(next);
+}
+
+void AudioQueue::transmit(const QueuedCommand &queued)
+{
+    player.send(queued.command, queued.argument);
+    inFlight = queued;
+    awaitingAck = true;
+    sentAt = clock.micros();
+    sent++;
+}
+
+// Next Player Event, Acks are Taken Here and Never Returned
+// A query is answered with its count, or an error if there's nothing to count, instead of an ack
+AudioEvent AudioQueue::poll(int &value)
+{
+    AudioEvent event;
+    while ((event = player.poll(value)) != AUDIO_NONE)
+    {
+        bool answer = event == AUDIO_FILE_COUNT || event == AUDIO_FOLDER_COUNT ||
+                      (event == AUDIO_ERROR && isQuery(inFlight.command));
+        if (awaitingAck && (event == AUDIO_ACK || answer))
+        {
+            ackLatency.record(clock.micros() - sentAt);
+            awaitingAck = false;
+        }
+        if (event != AUDIO_ACK)
+        {
+            return event;
+        }
+    }
+    return AUDIO_NONE;
+}
+
+// Gives Up on Late Acks and Sends what's Next
+void AudioQueue::update()
+{
+    if (awaitingAck && clock.micros() - sentAt > (int64_t)AUDIO_ACK_TIMEOUT * 1000)
+    {
+        awaitingAck = false;
+        timeouts++;
+        LOG_WARN(LOG_SOUND, "Player didn't ack command %d", inFlight.command);
+
+        // Try Once More, unless a Newer Command of its Kind is Already Waiting
+        bool replaced = false;
+        for (int i = 0; i < count; i++)
+        {
+            replaced |= sameKind(queue[i].command, inFlight.command);
+        }
+        if (!inFlight.retried && !replaced && count < AUDIO_QUEUE_SIZE)
+        {
+            for (int i = count; i > 0; i--)
+            {
+                queue[i] = queue[i - 1];
+            }
+            queue[0] = inFlight;
+            queue[0].retried = true;
+            count++;
+        }
+    }
+
+    sendNext();
+}
+
+// Nothing Waiting or Unacked
+bool AudioQueue::isIdle()
+{
+    return !awaitingAck && count == 0;
+}
+
+// Prints Commands Sent, Merged and Timed Out, and Ack Latency
+void AudioQueue::printStats()
+{
+    Serial.printf("Audio: %u sent, %u merged, %u timed out, ack p50 %uus, p99 %uus, max %uus, deepest queue %d\n",
+                  sent, coalesced, timeouts,
+                  ackLatency.percentile(50), ackLatency.percentile(99), ackLatency.getMax(), maxDepth);
+}
+
+void AudioQueue::resetStats()
+{
+    ackLatency.reset();
+    sent = 0;
+    coalesced = 0;
+    timeouts = 0;
+    maxDepth = count;
+}
@@ -0,0 +1,101 @@
+// Turns Raw Button Edges into Debounced Press Events
+
+// Project Specific Headers
+#include "Buttons.h"
+
+Buttons::Buttons(ButtonInput &input, ClockSource &clock) : input(input), clock(clock) {}
+
+// Sets up the Pin and Sends its Events to handler
+void Buttons::watch(int pin, std::function<void(const ButtonEvent &)> handler)
+{
+    WatchedButton button;
+    button.pin = pin;
+    button.handler = handler;
+    watched.push_back(button);
+
+    input.setup(pin);
+}
+
+// Drains Captured Edges, Debounces them and Sends Events
+// The first edge of a change acts right away, edges after it are ignored until the contacts settle
+void Buttons::update()
+{
+    ButtonEdge edge;
+    while (input.takeEdge(edge))
+    {
+        for (size_t i = 0; i < watched.size(); i++)
+        {
+            WatchedButton &button = watched[i];
+            if (button.pin == edge.pin && edge.pressed != button.down && edge.atMicros - button.changedAt >= DEBOUNCE_MICROS)
+            {
+                change(button, edge.pressed, edge.atMicros);
+            }
+        }
+    }
+
+    int64_t now = clock.micros();
+    for (size_t i = 0; i < watched.size(); i++)
+    {
+        WatchedButton &button = watched[i];
+
+        // Catch a Release (or Press) whose Edge was Bounced Away or Dropped
+        if (now - button.changedAt >= DEBOUNCE_MICROS)
+        {
+            bool level = input.isPressed(button.pin);
+            if (level != button.down)
+            {
+                change(button, level, now);
+            }
+        }
+
+        if (button.down && !button.longSent && now - button.pressedAt >= LONG_PRESS_MICROS)
+        {
+            button.longSent = true;
+            button.handler({BUTTON_LONG, button.pin, button.pressedAt});
+        }
+    }
+}
+
+// Commits a Debounced State Change
+void Buttons::change(WatchedButton &button, bool down, int64_t at)
+{
+    button.down = down;
+    button.changedAt = at;
+
+    if (down)
+    {
+        button.pressedAt = at;
+        button.longSent = false;
+        button.handler({BUTTON_PRESS, button.pin, at});
+    }
+    else if (!button.longSent)
+    {
+        button.handler({BUTTON_SHORT, button.pin, button.pressedAt});
+    }
+}
+
+// Debounced State
+bool Buttons::isDown(int pin)
+{
+    for (size_t i = 0; i < watched.size(); i++)
+    {
+        if (watched[i].pin == pin)
+        {
+            return watched[i].down;
+        }
+    }
+    return false;
+}
+
+// Any Button Held, Long Press Timing Needs the Loop Awake
+bool Buttons::anyDown()
+{
+    for (size_t i = 0; i < watched.size(); i++)
+    {
+        if (watched[i].down)
+        {
+            return true;
+        }
+    }
+    return false;
+}
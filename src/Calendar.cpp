@@ -0,0 +1,71 @@
+// Converts Between Epoch Seconds and Calendar Dates
+
+// Project Specific Headers
+#include "Calendar.h"
+
+// Standard Libraries
+#include <string.h>
+#include <stdlib.h>
+
+// Days since 1970-01-01 for a Date (Proleptic Gregorian)
+static int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day)
+{
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yearOfEra = year - era * 400;
+    uint32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (int32_t)dayOfEra - 719468;
+}
+
+// Splits Epoch Seconds into a Date and Time
+CivilTime toCivil(uint32_t epoch)
+{
+    CivilTime civil;
+
+    int32_t days = epoch / 86400;
+    uint32_t secondOfDay = epoch % 86400;
+
+    civil.hour = secondOfDay / 3600;
+    civil.minute = secondOfDay % 3600 / 60;
+    civil.second = secondOfDay % 60;
+    civil.dayOfWeek = (days + 4) % 7; // 1970-01-01 was a Thursday
+
+    // Date from Day Count
+    days += 719468;
+    int32_t era = days / 146097;
+    uint32_t dayOfEra = days - era * 146097;
+    uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    uint32_t monthIndex = (5 * dayOfYear + 2) / 153;
+
+    civil.day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    civil.month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    civil.year = yearOfEra + era * 400 + (civil.month <= 2);
+
+    return civil;
+}
+
+// Joins a Date and Time into Epoch Seconds
+uint32_t toEpoch(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+{
+    return (uint32_t)daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// Reads __DATE__ ("Mmm dd yyyy") and __TIME__ ("hh:mm:ss") as Epoch Seconds
+uint32_t parseCompileTime(const char *date, const char *time)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    uint8_t month = 1;
+    for (uint8_t i = 0; i < 12; i++)
+    {
+        if (strncmp(date, months + i * 3, 3) == 0)
+        {
+            month = i + 1;
+            break;
+        }
+    }
+
+    return toEpoch(atoi(date + 7), month, atoi(date + 4), atoi(time), atoi(time + 3), atoi(time + 6));
+}
@@ -5,21 +5,20 @@
 #include "RealTime.h"
 #include "Alarm.h"
 
-// External Library Headers
-#include <Wire.h> 
-#include <LiquidCrystal_I2C.h>
-
-// LCD Variables
-LiquidCrystal_I2C lcd(0x27,16,2);  // set the LCD address to 0x27 for a 16 chars and 2 line display
-// Default SDA = 21, SCL = 22
+// Standard Libraries
+#include <stdarg.h>
+#include <string.h>
 
 
 // Display Constructor
-Display::Display(Alarm &alarm) : alarm(&alarm) {}
+Display::Display(Alarm &alarm) : alarm(&alarm) {
+    memset(frame, ' ', sizeof(frame));
+    memset(shown, ' ', sizeof(shown));
+}
 
 
 // Returns the Date and Time
-RtcDateTime Display::getTimeInformation(){
+CivilTime Display::getTimeInformation(){
     return alarm->rtc->getTimeNow();
 } 
 // Returns Weather Information
@@ -29,79 +28,91 @@ void Display::getWeatherInformation(){
 
 // Starts LCD up
 void Display::initLCD() {
-    lcd.init();   // initialize the lcd 
+    alarm->hal.lcd.begin();   // initialize the lcd 
+    statsStarted = alarm->hal.clock.millis();
+
     // Print a message to the LCD.
-    lcd.backlight();
-    lcd.setCursor(2,1);
-    lcd.print("Loading...");
+
+    printAt(2,1,"Loading...");
+    flush();
 }
 
 // Clears LCD Screen
 void Display::clearLCD() {
-    lcd.clear();
+    alarm->hal.lcd.clear();
+    memset(frame, ' ', sizeof(frame));
+    memset(shown, ' ', sizeof(shown));
+    cursorCol = 0; // clear() homes the cursor
+    cursorRow = 0;
 }
 
+// Draws Text into the Framebuffer, Cut Off at the End of the Row
+void Display::printAt(int col, int row, const char *format, ...) {
+    char text[LCD_COLS + 1];
 
-// Updates Time, Date, and Weather on Screen
-void Display::updateDisplay() {
-    static unsigned long timer = millis();
-    static unsigned long timer2 = millis();
-    static RtcDateTime lastTime = getTimeInformation();
-    static int lastVolume = alarm->sound->getVolume();
-    
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
 
-    if (millis() - timer > 1000 || timer == 0) {
-        timer = millis();
+    for(int i = 0; text[i] != '\0' && col + i < LCD_COLS; i++){
+        frame[row][col + i] = text[i];
+    }
+}
 
-        // lcd.clear();
+// Sends Only Changed Cells to the LCD
+// Each character or cursor move is a full I2C transaction, so skipping unchanged cells is where the time goes
+void Display::flush() {
+    LcdDevice &lcd = alarm->hal.lcd;
+    int64_t start = alarm->hal.clock.micros();
+    int writes = 0;
+
+    for(int row = 0; row < LCD_ROWS; row++){
+        for(int col = 0; col < LCD_COLS; col++){
+            if(frame[row][col] == shown[row][col]){
+                continue;
+            }
 
-        // Set the Time
-        lcd.setCursor(0,0);
+            // Only move the cursor if the last write didn't already leave it here
+            if(col != cursorCol || row != cursorRow){
+                lcd.setCursor(col,row);
+                writes++;
+            }
 
-        RtcDateTime now = getTimeInformation();
+            lcd.write(frame[row][col]);
+            writes++;
 
-        // First, Clear what needs to be cleared.
-        // If the Hour Changes, Clear the Whole Row first
-        if(now.HourAmPm().Hour()!=lastTime.HourAmPm().Hour()){
-            lcd.print("                "); // Clears First Row
-            lcd.setCursor(0,0); // Sets Cursor back at the beginning
+            shown[row][col] = frame[row][col];
+            cursorCol = col + 1; // LCD moves the cursor right after each character
+            cursorRow = row;
         }
+    }
 
-        lcd.printf("%d:%02d:%02d %s",now.HourAmPm().Hour(), now.Minute(), now.Second(), now.HourAmPm().Meridiem() == Rtc_AM ? "AM" : "PM");
-
-        // Set the Date (Shouldn't need to ever clear)
-        lcd.setCursor(0,1);
-        lcd.printf("%02d/%02d/%04d", now.Month(), now.Day(), now.Year());     
+    if(writes == 0){
+        return; // Nothing changed
+    }
 
-        // Update Last Time
-        lastTime = now;   
+    uint32_t took = alarm->hal.clock.micros() - start;
+    i2cBytes += writes * I2C_BYTES_PER_LCD_WRITE;
+    flushCount++;
+    flushMicros += took;
+    if(took > worstFlushMicros){
+        worstFlushMicros = took;
     }
+}
 
-    if(millis() - timer2 > 500 || timer2 == 0){
-        timer2 = millis();
-        // Show Volume if recently edited
-        if(alarm->sound->recentlyChangedVolume){
-            int volume = alarm->sound->getVolume();
-
-            // Only change if volume is different than before
-            if(volume != lastVolume) {
-                lastVolume = volume;
-                if(volume < 10){
-                    lcd.setCursor(11,1);
-                    lcd.printf(" %d/%d",volume, alarm->sound->maxVolume);
-                } else {
-                    lcd.setCursor(11,1);
-                    lcd.printf("%d/%d",volume, alarm->sound->maxVolume);
-                }
-            }
+// Updates Time, Date, and Weather on Screen
+void Display::updateDisplay() {
+    CivilTime now = getTimeInformation();
 
-            
-        } else {
-            // Volume should not be showing, clear those lines
-            lcd.setCursor(11,1);
-            lcd.print("     ");
-        }
-    }
+    // Set the Time, Rest of the Row is Blanked so Shorter Times Don't Leave Characters Behind
+    memset(frame[0], ' ', LCD_COLS);
+    printAt(0,0,"%d:%02d:%02d %s",now.hour12(), now.minute, now.second, now.isPM() ? "PM" : "AM");
+
+    // Set the Date (Shouldn't need to ever clear)
+    printAt(0,1,"%02d/%02d/%04d", now.month, now.day, now.year);
+
+    flush(); // Usually only the seconds digits go out
 }
 
 // Blinks when Alarm is Running
@@ -111,5 +122,33 @@ void Display::blinkScreen(){
 
 // Shows Volume
 void Display::showVolume(){
+    // Show Volume if recently edited
+    if(alarm->sound->recentlyChangedVolume){
+        printAt(11,1,"%2d/%d", alarm->sound->getVolume(), alarm->sound->maxVolume);
+    } else {
+        // Volume should not be showing, clear those cells (costs nothing if already blank)
+        printAt(11,1,"     ");
+    }
+
+    flush();
+}
+
+// Prints I2C Traffic and Flush Time
+void Display::printStats(){
+    unsigned long seconds = (alarm->hal.clock.millis() - statsStarted) / 1000;
+    if(seconds == 0){
+        seconds = 1;
+    }
 
+    Serial.printf("LCD: %lu I2C bytes/s, %u flushes, avg %luus, worst %uus\n",
+                  i2cBytes / seconds,
+                  flushCount,
+                  flushCount > 0 ? flushMicros / flushCount : 0UL,
+                  worstFlushMicros);
+
+    i2cBytes = 0;
+    flushCount = 0;
+    flushMicros = 0;
+    worstFlushMicros = 0;
+    statsStarted = alarm->hal.clock.millis();
 }
\ No newline at end of file
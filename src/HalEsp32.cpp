@@ -0,0 +1,565 @@
+// ESP32 Implementations of the Hardware Interfaces
+
+// Project Specific Headers
+#include "HalEsp32.h"
+#include "Calendar.h"
+#include "Log.h"
+
+// External Library Headers
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <Wire.h> 
+#include <LiquidCrystal_I2C.h>
+#include <RtcDS1302.h>
+#include "DFRobotDFPlayerMini.h"
+#include <Preferences.h>
+
+// RTC Variables
+// CONNECTIONS:
+// DS1302 CLK/SCLK --> 5, DS1302 DAT/IO --> 4, DS1302 RST/CE --> 2, DS1302 VCC --> 3.3v - 5v, DS1302 GND --> GND
+ThreeWire myWire(4, 5, 2); // IO, SCLK, CE
+RtcDS1302<ThreeWire> Rtc(myWire);
+
+// LCD Variables
+LiquidCrystal_I2C lcd(0x27,16,2);  // set the LCD address to 0x27 for a 16 chars and 2 line display
+// Default SDA = 21, SCL = 22
+
+// Flash Variables
+Preferences preferences;
+
+// DF Setup
+#define FPSerial Serial1
+DFRobotDFPlayerMini myDFPlayer;
+void printDetail(uint8_t type, int value);
+
+/// Clock
+
+unsigned long Esp32Clock::millis()
+{
+    return ::millis();
+}
+
+int64_t Esp32Clock::micros()
+{
+    return esp_timer_get_time();
+}
+
+void Esp32Clock::delay(unsigned long ms)
+{
+    ::delay(ms);
+}
+
+// CPU Cycle Counter, Wraps about every 18s at 240MHz
+uint32_t Esp32Clock::cycles()
+{
+    return ESP.getCycleCount();
+}
+
+uint32_t Esp32Clock::cyclesPerMicro()
+{
+    return ESP.getCpuFreqMHz();
+}
+
+// Makes Sure the RTC is Running and Writable
+void Esp32Clock::beginRtc()
+{
+    Rtc.Begin(); // Begins Real Time Clock
+
+    if (Rtc.GetIsWriteProtected()) // Turn off Write Protected
+    {
+        LOG_WARN(LOG_CLOCK, "RTC was write protected, enabling writing now");
+        Rtc.SetIsWriteProtected(false);
+    }
+
+    if (!Rtc.GetIsRunning()) // Make sure RTC is running
+    {
+        LOG_WARN(LOG_CLOCK, "RTC was not actively running, starting now");
+        Rtc.SetIsRunning(true);
+    }
+}
+
+// Returns false if the RTC Lost its Time
+bool Esp32Clock::readRtc(uint32_t &epoch)
+{
+    RtcDateTime now = Rtc.GetDateTime();
+    epoch = now.Unix32Time();
+
+    // Common Causes:
+    //    1) the battery on the device is low or even missing and the power line was disconnected
+    return now.IsValid();
+}
+
+void Esp32Clock::writeRtc(uint32_t epoch)
+{
+    RtcDateTime timeToSet;
+    timeToSet.InitWithUnix32Time(epoch);
+    Rtc.SetDateTime(timeToSet);
+}
+
+/// LCD
+
+// Initializes and Turns on the Backlight
+void Esp32Lcd::begin()
+{
+    lcd.init();   // initialize the lcd 
+    lcd.backlight();
+}
+
+void Esp32Lcd::clear()
+{
+    lcd.clear();
+}
+
+void Esp32Lcd::setCursor(uint8_t col, uint8_t row)
+{
+    lcd.setCursor(col, row);
+}
+
+void Esp32Lcd::write(char c)
+{
+    lcd.write(c);
+}
+
+/// Audio
+
+// Brings the DFPlayer Online in the Background, Retrying until it Answers
+// Runs on Core 0 so a Missing Player or SD Card never Holds Up the Clock
+void audioBeginTask(void *param)
+{
+    Esp32Audio *audio = static_cast<Esp32Audio *>(param);
+
+    LOG_INFO(LOG_SOUND, "Initializing DFPlayer ... (May take 3~5 seconds)");
+
+    while (!myDFPlayer.begin(FPSerial, /*isACK = */true, /*doReset = */true)) {  //Use serial to communicate with mp3.
+        LOG_WARN(LOG_SOUND, "Unable to begin DFPlayer, retrying in 5s: Please recheck the connection and insert the SD card!");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+    }
+    LOG_INFO(LOG_SOUND, "DFPlayer Mini online.");
+
+    // Nothing is read back here, what's on the card comes from the saved index (Ringtones.h)
+    audio->online = true; // Alarm core may use the player from here on
+    vTaskDelete(nullptr);
+}
+
+// Starts Bringing the Player Online in the Background
+void Esp32Audio::begin()
+{
+    FPSerial.begin(9600, SERIAL_8N1, /*tx =*/26, /*rx =*/27);
+    xTaskCreatePinnedToCore(audioBeginTask, "audioBegin", 4096, this, 1, nullptr, 0);
+}
+
+bool Esp32Audio::isOnline()
+{
+    return online;
+}
+
+// DFPlayer Frame: 7E FF 06 Command Ack ArgHigh ArgLow SumHigh SumLow EF
+const uint8_t FRAME_START = 0x7E;
+const uint8_t FRAME_END = 0xEF;
+const int FRAME_LENGTH = 10;
+
+// Writes the Frame into the UART Buffer, Never Waits
+// Frames are built here instead of through myDFPlayer, whose ack mode blocks the next command until the last is acked
+void Esp32Audio::send(AudioCommand command, uint16_t argument)
+{
+    if (!online)
+    {
+        return;
+    }
+
+    uint8_t code = 0;
+    switch (command)
+    {
+    case AUDIO_VOLUME: code = 0x06; break;
+    case AUDIO_LOOP: code = 0x08; break;
+    case AUDIO_PLAY_FOLDER: code = 0x0F; break;
+    case AUDIO_STOP: code = 0x16; break;
+    case AUDIO_QUERY_FILES: code = 0x48; break;
+    case AUDIO_QUERY_FOLDER: code = 0x4E; break;
+    }
+
+    // Queries aren't acked, their answer is
+    uint8_t ack = code >= 0x40 ? 0x00 : 0x01;
+    uint8_t frame[FRAME_LENGTH] = {FRAME_START, 0xFF, 0x06, code, ack, (uint8_t)(argument >> 8), (uint8_t)argument, 0, 0, FRAME_END};
+    uint16_t sum = 0;
+    for (int i = 1; i < 7; i++)
+    {
+        sum -= frame[i];
+    }
+    frame[7] = sum >> 8;
+    frame[8] = sum;
+
+    FPSerial.write(frame, FRAME_LENGTH); // 10 bytes fit the TX buffer, so this only copies
+}
+
+// Reads Whatever Reply Bytes have Arrived, Returns the Next Event from the Player, AUDIO_NONE if Nothing
+AudioEvent Esp32Audio::poll(int &value)
+{
+    while (online && FPSerial.available() > 0)
+    {
+        uint8_t byte = FPSerial.read();
+        if (replyLength == 0 && byte != FRAME_START)
+        {
+            continue; // Wait for the start of a frame
+        }
+
+        reply[replyLength++] = byte;
+        if (replyLength < FRAME_LENGTH)
+        {
+            continue;
+        }
+        replyLength = 0;
+
+        uint16_t sum = 0;
+        for (int i = 1; i < 7; i++)
+        {
+            sum -= reply[i];
+        }
+        if (reply[9] != FRAME_END || sum != (uint16_t)(reply[7] << 8 | reply[8]))
+        {
+            continue; // Corrupt frame
+        }
+
+        value = reply[5] << 8 | reply[6];
+        switch (reply[3])
+        {
+        case 0x41:
+            return AUDIO_ACK;
+        case 0x3D:
+            printDetail(DFPlayerPlayFinished, value);
+            return AUDIO_PLAY_FINISHED;
+        case 0x3A:
+            printDetail(DFPlayerCardInserted, value);
+            return AUDIO_CARD_INSERTED;
+        case 0x3B:
+            printDetail(DFPlayerCardRemoved, value);
+            return AUDIO_CARD_REMOVED;
+        case 0x3F:
+            printDetail(DFPlayerCardOnline, value);
+            break;
+        case 0x40:
+            printDetail(DFPlayerError, value);
+            return AUDIO_ERROR;
+        case 0x48:
+            return AUDIO_FILE_COUNT;
+        case 0x4E:
+            return AUDIO_FOLDER_COUNT;
+        }
+    }
+    return AUDIO_NONE;
+}
+
+/// Buttons
+
+// Edge Ring Filled by the GPIO Interrupt and Drained by the Alarm Loop
+// Both run on core 1, the interrupt only ever moves edgeTail and the loop edgeHead
+const uint32_t EDGE_RING = 32; // Power of Two
+ButtonEdge edgeRing[EDGE_RING];
+std::atomic<uint32_t> edgeHead{0};
+std::atomic<uint32_t> edgeTail{0};
+
+// Pins with Edge Capture, Light Sleep Wakes on Any of Them
+const int MAX_BUTTONS = 8;
+int buttonPins[MAX_BUTTONS];
+int buttonCount = 0;
+
+// Queues the Pin's Level, Drops it if the Loop has Fallen 32 Edges Behind
+// Buttons::update() reads the pin level directly once things settle, so a dropped edge is never lost for good
+void IRAM_ATTR captureEdge(int pin, int64_t atMicros)
+{
+    uint32_t tail = edgeTail.load(std::memory_order_relaxed);
+
+    if (tail - edgeHead.load(std::memory_order_acquire) < EDGE_RING)
+    {
+        ButtonEdge &edge = edgeRing[tail & (EDGE_RING - 1)];
+        edge.pin = pin;
+        edge.pressed = digitalRead(pin) == HIGH;
+        edge.atMicros = atMicros;
+        edgeTail.store(tail + 1, std::memory_order_release);
+    }
+}
+
+// Timestamps Every Level Change
+void IRAM_ATTR buttonEdgeIsr(void *arg)
+{
+    captureEdge((int)(intptr_t)arg, esp_timer_get_time());
+}
+
+// Starts Capturing Edges on the Pin
+void Esp32Buttons::setup(int pin)
+{
+    pinMode(pin, INPUT_PULLDOWN); // 1 when Pushed, 0 when not Pushed
+    attachInterruptArg(digitalPinToInterrupt(pin), buttonEdgeIsr, (void *)(intptr_t)pin, CHANGE);
+
+    if (buttonCount < MAX_BUTTONS)
+    {
+        buttonPins[buttonCount++] = pin;
+    }
+}
+
+bool Esp32Buttons::isPressed(int pin)
+{
+    return digitalRead(pin) == HIGH;
+}
+
+// Oldest Captured Edge, false if None
+bool Esp32Buttons::takeEdge(ButtonEdge &edge)
+{
+    uint32_t head = edgeHead.load(std::memory_order_relaxed);
+    if (head == edgeTail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    edge = edgeRing[head & (EDGE_RING - 1)];
+    edgeHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+/// Light Sleep
+
+// Sleeps the CPU, Wakes Early on a Button Press or Network Data
+// GPIO wake needs a level trigger, so the button pins swap their edge interrupts out while asleep
+// and the press that woke it is queued by hand, since no edge interrupt saw it
+void Esp32Clock::lightSleep(unsigned long ms)
+{
+    for (int i = 0; i < buttonCount; i++)
+    {
+        gpio_num_t pin = (gpio_num_t)buttonPins[i];
+        gpio_intr_disable(pin);
+        gpio_wakeup_enable(pin, GPIO_INTR_HIGH_LEVEL);
+    }
+
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+    esp_sleep_enable_gpio_wakeup();
+#if SOC_PM_SUPPORT_WIFI_WAKEUP
+    esp_sleep_enable_wifi_wakeup();
+#endif
+    esp_light_sleep_start();
+    int64_t wokeAt = esp_timer_get_time();
+
+    // Edge interrupts stay off until the wake presses are queued, so the ring only ever has one producer at a time
+    for (int i = 0; i < buttonCount; i++)
+    {
+        gpio_num_t pin = (gpio_num_t)buttonPins[i];
+        gpio_wakeup_disable(pin);
+        gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+        if (digitalRead(pin) == HIGH)
+        {
+            captureEdge(pin, wokeAt);
+        }
+    }
+    for (int i = 0; i < buttonCount; i++)
+    {
+        gpio_intr_enable((gpio_num_t)buttonPins[i]);
+    }
+}
+
+/// Storage
+
+// Opens the Namespace on First Use
+void Esp32Storage::open()
+{
+    if (!opened)
+    {
+        opened = preferences.begin("alarm", false);
+    }
+}
+
+// Returns Bytes Read, 0 if Missing
+size_t Esp32Storage::read(const char *key, void *data, size_t maxSize)
+{
+    open();
+    if (!preferences.isKey(key))
+    {
+        return 0;
+    }
+
+    size_t length = preferences.getBytesLength(key);
+    if (length > maxSize)
+    {
+        return 0; // Bigger than Anything this Firmware Writes
+    }
+    return preferences.getBytes(key, data, length);
+}
+
+bool Esp32Storage::write(const char *key, const void *data, size_t size)
+{
+    open();
+    return preferences.putBytes(key, data, size) == size;
+}
+
+/// LAN
+
+// Listener Starts in accept() once Wi-Fi is Connected
+void Esp32Lan::begin(uint16_t port)
+{
+    this->port = port;
+}
+
+int Esp32Lan::accept()
+{
+    if (!listening)
+    {
+        if (port == 0 || WiFi.status() != WL_CONNECTED)
+        {
+            return -1;
+        }
+        server.begin(port);
+        server.setNoDelay(true); // Responses are One Write, Nagle would Only Hold them Back
+        listening = true;
+        LOG_INFO(LOG_NETWORK, "LAN API on %s:%u", WiFi.localIP().toString().c_str(), port);
+    }
+
+    if (!server.hasClient())
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        if (!clients[i])
+        {
+            clients[i] = server.available();
+            clients[i].setNoDelay(true);
+            return i;
+        }
+    }
+    return -1; // Stays in the Backlog until a Slot Frees Up
+}
+
+// Bytes Read, 0 if None Yet, -1 once Closed
+int Esp32Lan::read(int connection, char *buffer, size_t size)
+{
+    WiFiClient &client = clients[connection];
+    int waiting = client.available();
+    if (waiting <= 0)
+    {
+        return client.connected() ? 0 : -1;
+    }
+    return client.read((uint8_t *)buffer, (size_t)waiting < size ? waiting : size);
+}
+
+bool Esp32Lan::write(int connection, const char *data, size_t size)
+{
+    return clients[connection].write((const uint8_t *)data, size) == size;
+}
+
+void Esp32Lan::close(int connection)
+{
+    clients[connection].stop();
+}
+
+/// Peers
+
+// Group Every Clock in the House Joins, from the Administratively Scoped Range
+const IPAddress HOUSE_GROUP(239, 255, 42, 99);
+const uint16_t HOUSE_GROUP_PORT = 4299;
+
+uint32_t Esp32Peers::localId()
+{
+    uint64_t mac = ESP.getEfuseMac();
+    uint32_t id = (uint32_t)(mac >> 16) ^ (uint32_t)mac;
+    return id != 0 ? id : 1;
+}
+
+// Returns if the Group is Joined
+bool Esp32Peers::join()
+{
+    if (!joined && WiFi.status() == WL_CONNECTED)
+    {
+        joined = udp.beginMulticast(HOUSE_GROUP, HOUSE_GROUP_PORT);
+    }
+    return joined;
+}
+
+bool Esp32Peers::send(const void *data, size_t size)
+{
+    if (!join())
+    {
+        return false;
+    }
+    udp.beginMulticastPacket();
+    udp.write((const uint8_t *)data, size);
+    return udp.endPacket() == 1;
+}
+
+// Next Datagram, 0 if None, Longer Ones are Dropped
+size_t Esp32Peers::receive(void *data, size_t maxSize)
+{
+    if (!join())
+    {
+        return 0;
+    }
+
+    int size;
+    while ((size = udp.parsePacket()) > 0)
+    {
+        if ((size_t)size <= maxSize)
+        {
+            return udp.read((uint8_t *)data, size);
+        }
+        udp.flush();
+    }
+    return 0;
+}
+
+void printDetail(uint8_t type, int value){
+  switch (type) {
+    case TimeOut:
+      LOG_WARN(LOG_SOUND, "Time Out!");
+      break;
+    case WrongStack:
+      LOG_WARN(LOG_SOUND, "Stack Wrong!");
+      break;
+    case DFPlayerCardInserted:
+      LOG_INFO(LOG_SOUND, "Card Inserted!");
+      break;
+    case DFPlayerCardRemoved:
+      LOG_WARN(LOG_SOUND, "Card Removed!");
+      break;
+    case DFPlayerCardOnline:
+      LOG_INFO(LOG_SOUND, "Card Online!");
+      break;
+    case DFPlayerUSBInserted:
+      LOG_INFO(LOG_SOUND, "USB Inserted!");
+      break;
+    case DFPlayerUSBRemoved:
+      LOG_INFO(LOG_SOUND, "USB Removed!");
+      break;
+    case DFPlayerPlayFinished:
+      LOG_DEBUG(LOG_SOUND, "Number:%d Play Finished!", value);
+      break;
+    case DFPlayerError:
+      switch (value) {
+        case Busy:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:Card not found");
+          break;
+        case Sleeping:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:Sleeping");
+          break;
+        case SerialWrongStack:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:Get Wrong Stack");
+          break;
+        case CheckSumNotMatch:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:Check Sum Not Match");
+          break;
+        case FileIndexOut:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:File Index Out of Bound");
+          break;
+        case FileMismatch:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:Cannot Find File");
+          break;
+        case Advertise:
+          LOG_ERROR(LOG_SOUND, "DFPlayerError:In Advertise");
+          break;
+        default:
+          break;
+      }
+      break;
+    default:
+      break;
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Fixed-Bucket Latency Histogram
+
+// Project Specific Headers
+#include "Histogram.h"
+
+int Histogram::bucketOf(uint32_t micros)
+{
+    if (micros < 2)
+    {
+        return micros;
+    }
+
+    int exponent = 31 - __builtin_clz(micros);
+    int half = (micros >> (exponent - 1)) & 1; // Upper or Lower Half of the Power of Two
+    int bucket = exponent * 2 + half;
+
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// Largest Value that Lands in the Bucket
+uint32_t Histogram::bucketTop(int bucket)
+{
+    if (bucket < 2)
+    {
+        return bucket;
+    }
+
+    int exponent = bucket / 2;
+    uint32_t width = 1UL << (exponent - 1);
+    uint32_t bottom = (1UL << exponent) + (bucket & 1) * width;
+    return bottom + width - 1;
+}
+
+// Adds One Sample, Constant Time
+void Histogram::record(uint32_t micros)
+{
+    buckets[bucketOf(micros)]++;
+    count++;
+    if (micros > max)
+    {
+        max = micros;
+    }
+}
+
+void Histogram::reset()
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        buckets[i] = 0;
+    }
+    count = 0;
+    max = 0;
+}
+
+// Upper Bound of the Bucket Holding that Percentile
+uint32_t Histogram::percentile(uint8_t percent) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint32_t target = ((uint64_t)count * percent + 99) / 100; // Rounded Up, so p100 is the Last Sample
+    uint32_t seen = 0;
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+        {
+            if (i == HISTOGRAM_BUCKETS - 1)
+            {
+                return max; // Last Bucket has no Upper Bound
+            }
+            uint32_t top = bucketTop(i);
+            return top < max ? top : max; // Never Report more than was Measured
+        }
+    }
+    return max;
+}
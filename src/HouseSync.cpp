@@ -0,0 +1,394 @@
+// Rings Shared Alarms on Every Clock in the House at Once
+
+// Project Specific Headers
+#include "HouseSync.h"
+#include "Alarm.h"
+#include "Log.h"
+
+// Standard Libraries
+#include <string.h>
+
+const uint32_t HOUSE_MAGIC = 0x4E595348; // "HSYN"
+
+HouseSync::HouseSync(Alarm &alarm) : alarm(&alarm)
+{
+    memset(handled, 0, sizeof(handled));
+}
+
+void HouseSync::begin()
+{
+    id = alarm->hal.peers.localId();
+    referenceId = id;
+    alarm->hal.peers.begin();
+}
+
+// Our Clock, Epoch Microseconds
+int64_t HouseSync::localNow()
+{
+    return alarm->rtc->getEpochMicros();
+}
+
+uint8_t HouseSync::quality()
+{
+    return alarm->rtc->isNtpFresh() ? 2 : 1;
+}
+
+// Any Other Clock Heard from Lately
+bool HouseSync::hasPeers()
+{
+    return peerCount > 0;
+}
+
+// Reads Messages, Announces, Exchanges and Starts a Waiting Ring
+void HouseSync::update()
+{
+    HouseMessage message;
+    size_t size;
+    while ((size = alarm->hal.peers.receive(&message, sizeof(message))) > 0)
+    {
+        if (size == sizeof(message) && message.magic == HOUSE_MAGIC && message.from != id)
+        {
+            receive(message);
+        }
+    }
+
+    // Forget Clocks that Went Quiet
+    unsigned long now = alarm->hal.clock.millis();
+    for (int i = 0; i < peerCount;)
+    {
+        if (now - peers[i].seenAt > PEER_TIMEOUT)
+        {
+            LOG_INFO(LOG_NETWORK, "House clock %08lx left", (unsigned long)peers[i].id);
+            peers[i] = peers[--peerCount];
+            continue;
+        }
+        i++;
+    }
+    electReference();
+
+    if ((long)(now - nextAnnounceAt) >= 0)
+    {
+        HouseMessage announce = {};
+        announce.type = HOUSE_ANNOUNCE;
+        send(announce);
+        nextAnnounceAt = now + ANNOUNCE_PERIOD;
+    }
+
+    // Faster until there are Enough Samples to Pick From
+    if (referenceId != id && (long)(now - nextExchangeAt) >= 0)
+    {
+        HouseMessage request = {};
+        request.type = HOUSE_REQUEST;
+        request.to = referenceId;
+        request.t1 = localNow();
+        send(request);
+        nextExchangeAt = now + (sampleCount < OFFSET_SAMPLES / 2 ? EXCHANGE_PERIOD / 4 : EXCHANGE_PERIOD);
+    }
+
+    if (repeatsLeft > 0)
+    {
+        send(lastEvent);
+        repeatsLeft--;
+    }
+
+    if (hasPending)
+    {
+        int64_t until = pendingStartAt - localNow();
+        if (until <= 0)
+        {
+            startPending();
+        }
+        else
+        {
+            alarm->scheduler.runSoon(task, now + until / 1000);
+        }
+    }
+}
+
+void HouseSync::receive(HouseMessage &message)
+{
+    int64_t receivedAt = localNow();
+    message.key[ALARM_KEY_SIZE - 1] = '\0';
+    seePeer(message.from, message.quality);
+
+    switch (message.type)
+    {
+    case HOUSE_REQUEST:
+        if (message.to == id)
+        {
+            HouseMessage reply = {};
+            reply.type = HOUSE_REPLY;
+            reply.to = message.from;
+            reply.t1 = message.t1;
+            reply.t2 = receivedAt;
+            reply.t3 = localNow();
+            send(reply);
+        }
+        break;
+
+    case HOUSE_REPLY:
+        if (message.to == id && message.from == referenceId)
+        {
+            addSample(message, receivedAt);
+        }
+        break;
+
+    case HOUSE_RING:
+        if (!isHandled(message.key, message.fireAt) &&
+            message.at > houseNow() - (int64_t)alarm->maxRingTime * 1000000)
+        {
+            ringsJoined += schedule(message.key, message.fireAt, message.at) ? 1 : 0;
+        }
+        break;
+
+    case HOUSE_STOP:
+        if (hasPending && strcmp(pending.key, message.key) == 0 && pending.fireAt == message.fireAt)
+        {
+            hasPending = false; // Stopped before it Started Here
+            stopsJoined++;
+        }
+        else if (hasRinging && strcmp(ringing.key, message.key) == 0 && ringing.fireAt == message.fireAt)
+        {
+            int slot = alarm->getAlarms().find(message.key);
+            if (slot >= 0)
+            {
+                stopping = true;
+                alarm->stopAlarm(alarm->getAlarms()[slot], (StopReason)message.reason);
+                stopping = false;
+                stopsJoined++;
+            }
+        }
+        remember(message.key, message.fireAt);
+        break;
+    }
+}
+
+void HouseSync::send(HouseMessage &message)
+{
+    message.magic = HOUSE_MAGIC;
+    message.from = id;
+    message.quality = quality();
+    alarm->hal.peers.send(&message, sizeof(message));
+}
+
+// Sends it Now and Repeats it on the Next Polls
+void HouseSync::sendEvent(HouseMessage &message)
+{
+    send(message);
+    lastEvent = message;
+    repeatsLeft = MESSAGE_REPEATS;
+}
+
+void HouseSync::seePeer(uint32_t peerId, uint8_t quality)
+{
+    unsigned long now = alarm->hal.clock.millis();
+    for (int i = 0; i < peerCount; i++)
+    {
+        if (peers[i].id == peerId)
+        {
+            peers[i].quality = quality;
+            peers[i].seenAt = now;
+            return;
+        }
+    }
+
+    if (peerCount < HOUSE_PEERS)
+    {
+        peers[peerCount++] = {peerId, quality, now};
+        LOG_INFO(LOG_NETWORK, "House clock %08lx joined, %d others", (unsigned long)peerId, peerCount);
+    }
+}
+
+// Best Time Wins, then the Lowest id, so Every Clock Picks the Same One
+void HouseSync::electReference()
+{
+    uint32_t best = id;
+    uint8_t bestQuality = quality();
+    for (int i = 0; i < peerCount; i++)
+    {
+        if (peers[i].quality > bestQuality || (peers[i].quality == bestQuality && peers[i].id < best))
+        {
+            best = peers[i].id;
+            bestQuality = peers[i].quality;
+        }
+    }
+
+    if (best == referenceId)
+    {
+        return;
+    }
+
+    // The Old Offset Stays in Use until the New Reference Answers
+    referenceId = best;
+    sampleCount = 0;
+    sampleNext = 0;
+    nextExchangeAt = alarm->hal.clock.millis();
+    referenceChanges++;
+    if (best == id)
+    {
+        offset = 0;
+        offsetRoundTrip = -1;
+    }
+    LOG_INFO(LOG_NETWORK, "House reference is %08lx%s", (unsigned long)best, best == id ? " (this clock)" : "");
+}
+
+// Round trip is the time on the wire and in both loops, the offset is only off by how uneven that was
+void HouseSync::addSample(const HouseMessage &reply, int64_t receivedAt)
+{
+    OffsetSample &sample = samples[sampleNext];
+    sample.roundTrip = (receivedAt - reply.t1) - (reply.t3 - reply.t2);
+    sample.offset = ((reply.t2 - reply.t1) + (reply.t3 - receivedAt)) / 2;
+    sampleNext = (sampleNext + 1) % OFFSET_SAMPLES;
+    sampleCount += sampleCount < OFFSET_SAMPLES ? 1 : 0;
+    exchanges++;
+
+    const OffsetSample *best = &samples[0];
+    for (int i = 1; i < sampleCount; i++)
+    {
+        best = samples[i].roundTrip < best->roundTrip ? &samples[i] : best;
+    }
+    offset = best->offset;
+    offsetRoundTrip = best->roundTrip;
+}
+
+// Our Own Copy of the Alarm Rings at fireAt: Same Time of Day, on a Weekday it Repeats on and not Skipped,
+// or the Date of a One-Shot
+bool HouseSync::firesAt(const AlarmItem &alarmItem, uint32_t fireAt)
+{
+    uint32_t day = fireAt / SECONDS_PER_DAY;
+    if (fireAt % SECONDS_PER_DAY != alarmItem.hour * 3600u + alarmItem.minute * 60u)
+    {
+        return false;
+    }
+    if (!alarmItem.is(ALARM_REPEATING))
+    {
+        return alarmItem.fireAt == fireAt;
+    }
+    return (alarmItem.days & (1 << (day + 4) % 7)) != 0 && alarmItem.skipDate != day; // 1970-01-01 was a Thursday
+}
+
+// Waits for a House Instant, Returns false if this Clock doesn't Ring the Alarm then
+bool HouseSync::schedule(const char *key, uint32_t fireAt, int64_t houseStartAt)
+{
+    int slot = alarm->getAlarms().find(key);
+    if (slot < 0 || !alarm->getAlarms()[slot].is(ALARM_ACTIVE) || !firesAt(alarm->getAlarms()[slot], fireAt))
+    {
+        return false; // Same key can Name a Different Alarm Here, or One Edited since the Other Clock Synced
+    }
+
+    copyField(pending.key, sizeof(pending.key), key);
+    pending.fireAt = fireAt;
+    pendingStartAt = houseStartAt - offset;
+    hasPending = true;
+    remember(key, fireAt);
+
+    int64_t until = pendingStartAt - localNow();
+    alarm->scheduler.runSoon(task, alarm->hal.clock.millis() + (until > 0 ? until / 1000 : 0));
+    return true;
+}
+
+void HouseSync::startPending()
+{
+    hasPending = false;
+    int slot = alarm->getAlarms().find(pending.key);
+    if (slot >= 0)
+    {
+        LOG_DEBUG(LOG_ALARM, "Shared start of %s, offset %ldus", pending.key, (long)offset);
+        alarm->startRing(alarm->getAlarms()[slot], pending.fireAt);
+    }
+}
+
+void HouseSync::remember(const char *key, uint32_t fireAt)
+{
+    if (isHandled(key, fireAt))
+    {
+        return;
+    }
+    Occurrence &occurrence = handled[handledNext];
+    copyField(occurrence.key, sizeof(occurrence.key), key);
+    occurrence.fireAt = fireAt;
+    handledNext = (handledNext + 1) % HANDLED_OCCURRENCES;
+}
+
+bool HouseSync::isHandled(const char *key, uint32_t fireAt)
+{
+    for (int i = 0; i < HANDLED_OCCURRENCES; i++)
+    {
+        if (handled[i].fireAt == fireAt && strcmp(handled[i].key, key) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// An Alarm Fired Here, Returns true if the Start is Shared (it Starts from update()) or Already Done
+// Alarms set on the clock itself have no key and always ring alone
+bool HouseSync::holdRing(AlarmItem &alarmItem, uint32_t fireAt)
+{
+    if (alarmItem.key[0] == '\0')
+    {
+        return false;
+    }
+    if (isHandled(alarmItem.key, fireAt))
+    {
+        return true; // Another Clock's Message Got Here First
+    }
+    if (!hasPeers())
+    {
+        return false;
+    }
+
+    HouseMessage ring = {};
+    ring.type = HOUSE_RING;
+    ring.fireAt = fireAt;
+    ring.at = (int64_t)fireAt * 1000000 + RING_LEAD;
+    copyField(ring.key, sizeof(ring.key), alarmItem.key);
+    schedule(ring.key, fireAt, ring.at);
+    sendEvent(ring);
+    ringsSent++;
+    return true;
+}
+
+// Any Ring that Started, Shared or Not
+void HouseSync::ringStarted(AlarmItem &alarmItem, uint32_t fireAt)
+{
+    copyField(ringing.key, sizeof(ringing.key), alarmItem.key);
+    ringing.fireAt = fireAt;
+    hasRinging = true;
+    remember(alarmItem.key, fireAt);
+}
+
+// Tells the Others, unless a Stop Message Caused it
+// Replaced and removed alarms are this clock's own business
+void HouseSync::ringStopped(AlarmItem &alarmItem, StopReason reason)
+{
+    if (!hasRinging || strcmp(ringing.key, alarmItem.key) != 0)
+    {
+        return;
+    }
+    hasRinging = false;
+
+    if (stopping || !hasPeers() || alarmItem.key[0] == '\0' || (reason != STOP_DISMISSED && reason != STOP_TIMED_OUT))
+    {
+        return;
+    }
+
+    HouseMessage stop = {};
+    stop.type = HOUSE_STOP;
+    stop.reason = reason;
+    stop.fireAt = ringing.fireAt;
+    copyField(stop.key, sizeof(stop.key), ringing.key);
+    sendEvent(stop);
+    stopsSent++;
+}
+
+// Prints Peers, Reference, Offset and Messages
+void HouseSync::printStats()
+{
+    Serial.printf("House: %d other clocks, reference %08lx%s, offset %ldus (round trip %ldus), %u exchanges\n",
+                  peerCount, (unsigned long)referenceId, referenceId == id ? " (this clock)" : "",
+                  (long)offset, (long)offsetRoundTrip, exchanges);
+    Serial.printf("House rings: %u sent, %u joined, stops %u sent, %u joined, %u reference changes\n",
+                  ringsSent, ringsJoined, stopsSent, stopsJoined, referenceChanges);
+}
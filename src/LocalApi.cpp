@@ -0,0 +1,888 @@
+// Alarm Control over the Local Network, without the Cloud Round Trip
+
+// Project Specific Headers
+#include "LocalApi.h"
+#include "Alarm.h"
+#include "AlarmParser.h"
+#include "Calendar.h"
+#include "Log.h"
+
+// Standard Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+static const char *WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+const uint8_t WS_CLOSE = 0x8;
+const uint8_t WS_PING = 0x9;
+const uint8_t WS_PONG = 0xA;
+const uint8_t WS_TEXT = 0x1;
+
+static uint32_t rotateLeft(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1 of a Short Text, only Used for the WebSocket Handshake
+static void sha1(const uint8_t *data, size_t length, uint8_t digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint64_t bits = (uint64_t)length * 8;
+    size_t blocks = (length + 8) / 64 + 1; // Room for the 0x80 Byte and the Bit Length
+
+    for (size_t block = 0; block < blocks; block++)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 64; i++)
+        {
+            size_t at = block * 64 + i;
+            uint8_t byte = 0;
+            if (at < length)
+            {
+                byte = data[at];
+            }
+            else if (at == length)
+            {
+                byte = 0x80;
+            }
+            else if (block == blocks - 1 && i >= 56)
+            {
+                byte = bits >> (8 * (63 - i));
+            }
+
+            if (i % 4 == 0)
+            {
+                w[i / 4] = 0;
+            }
+            w[i / 4] |= (uint32_t)byte << (8 * (3 - i % 4));
+        }
+        for (int i = 16; i < 80; i++)
+        {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            uint32_t next = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = next;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 20; i++)
+    {
+        digest[i] = h[i / 4] >> (8 * (3 - i % 4));
+    }
+}
+
+// Base64 with Padding, text Needs 4 Bytes per 3 plus the Null
+static void base64(const uint8_t *data, size_t length, char *text)
+{
+    static const char *ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < length; i += 3)
+    {
+        uint32_t group = (uint32_t)data[i] << 16;
+        group |= i + 1 < length ? (uint32_t)data[i + 1] << 8 : 0;
+        group |= i + 2 < length ? data[i + 2] : 0;
+
+        *text++ = ALPHABET[(group >> 18) & 0x3F];
+        *text++ = ALPHABET[(group >> 12) & 0x3F];
+        *text++ = i + 1 < length ? ALPHABET[(group >> 6) & 0x3F] : '=';
+        *text++ = i + 2 < length ? ALPHABET[group & 0x3F] : '=';
+    }
+    *text = '\0';
+}
+
+// Value of a Header in a Null Terminated Request Head, false if Missing
+static bool headerValue(const char *head, const char *name, char *value, size_t size)
+{
+    size_t nameLength = strlen(name);
+    for (const char *line = strstr(head, "\r\n"); line != nullptr; line = strstr(line, "\r\n"))
+    {
+        line += 2;
+        if (strncasecmp(line, name, nameLength) != 0 || line[nameLength] != ':')
+        {
+            continue;
+        }
+
+        const char *start = line + nameLength + 1;
+        while (*start == ' ')
+        {
+            start++;
+        }
+        const char *end = strstr(start, "\r\n");
+        size_t length = end != nullptr ? end - start : strlen(start);
+        length = length < size - 1 ? length : size - 1;
+        memcpy(value, start, length);
+        value[length] = '\0';
+        return true;
+    }
+    return false;
+}
+
+static const char *statusText(int status)
+{
+    switch (status)
+    {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    default: return "Insufficient Storage";
+    }
+}
+
+// Adds Text as a JSON String
+static void appendQuoted(String &json, const char *text)
+{
+    char escaped[2 * ALARM_ID_SIZE + 3];
+    size_t at = 0;
+    escaped[at++] = '"';
+    for (; *text != '\0' && at < sizeof(escaped) - 3; text++)
+    {
+        if (*text == '"' || *text == '\\')
+        {
+            escaped[at++] = '\\';
+        }
+        escaped[at++] = (uint8_t)*text < 0x20 ? ' ' : *text;
+    }
+    escaped[at++] = '"';
+    escaped[at] = '\0';
+    json += escaped;
+}
+
+// Adds ,"name":"YYYY-MM-DD" for an Epoch Day
+static void appendDate(String &json, const char *name, uint32_t day)
+{
+    CivilTime civil = toCivil(day * SECONDS_PER_DAY);
+    char text[32];
+    snprintf(text, sizeof(text), ",\"%s\":\"%04u-%02u-%02u\"", name, civil.year, civil.month, civil.day);
+    json += text;
+}
+
+static bool isKeyChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '-' || c == '_';
+}
+
+LocalApi::LocalApi(Alarm &alarm) : alarm(&alarm) {}
+
+// Starts Listening once Wi-Fi is Up
+void LocalApi::begin()
+{
+    alarm->hal.lan.begin(LAN_PORT);
+}
+
+// Accepts, Reads and Answers Whatever is Waiting, Never Waits
+void LocalApi::update()
+{
+    acceptClients();
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        if (clients[i].connection >= 0)
+        {
+            readClient(clients[i]);
+        }
+    }
+}
+
+void LocalApi::acceptClients()
+{
+    int connection;
+    while ((connection = alarm->hal.lan.accept()) >= 0)
+    {
+        Client *client = nullptr;
+        for (int i = 0; i < LAN_CONNECTIONS && client == nullptr; i++)
+        {
+            client = clients[i].connection < 0 ? &clients[i] : nullptr;
+        }
+        if (client == nullptr)
+        {
+            alarm->hal.lan.close(connection);
+            continue;
+        }
+
+        client->connection = connection;
+        client->webSocket = false;
+        client->length = 0;
+        client->lastActive = alarm->hal.clock.millis();
+        LOG_DEBUG(LOG_NETWORK, "LAN client %d connected", connection);
+    }
+}
+
+// Reads what Arrived, then Answers Every Whole Request (or Frame) in the Buffer
+void LocalApi::readClient(Client &client)
+{
+    int got = client.length < LAN_REQUEST_SIZE
+                  ? alarm->hal.lan.read(client.connection, client.buffer + client.length, LAN_REQUEST_SIZE - client.length)
+                  : 0;
+    if (got < 0)
+    {
+        closeClient(client);
+        return;
+    }
+
+    unsigned long now = alarm->hal.clock.millis();
+    if (got == 0)
+    {
+        if (!client.webSocket && now - client.lastActive > LAN_IDLE_TIMEOUT)
+        {
+            closeClient(client);
+        }
+        return;
+    }
+
+    client.length += got;
+    client.buffer[client.length] = '\0';
+    client.lastActive = now;
+
+    while (client.connection >= 0 && client.length > 0)
+    {
+        size_t used = 0;
+        bool keep = client.webSocket ? handleFrame(client, used) : handleRequest(client, used);
+        if (!keep)
+        {
+            closeClient(client);
+            return;
+        }
+        if (used == 0)
+        {
+            return; // Rest hasn't Arrived Yet
+        }
+
+        client.length -= used;
+        memmove(client.buffer, client.buffer + used, client.length);
+        client.buffer[client.length] = '\0';
+    }
+}
+
+void LocalApi::closeClient(Client &client)
+{
+    alarm->hal.lan.close(client.connection);
+    client.connection = -1;
+    client.webSocket = false;
+    client.length = 0;
+}
+
+// Returns false to Close, used is 0 until a Whole Request is In
+bool LocalApi::handleRequest(Client &client, size_t &used)
+{
+    char *blank = strstr(client.buffer, "\r\n\r\n");
+    if (blank == nullptr)
+    {
+        if (client.length < LAN_REQUEST_SIZE)
+        {
+            return true;
+        }
+        rejected++;
+        respond(client, 413, "", false);
+        return false;
+    }
+
+    size_t headLength = blank + 4 - client.buffer;
+    blank[2] = '\0'; // Head Alone, the Body Starts after the Blank Line
+
+    // Content-Length is Digits Alone, strtoul would Take "-1" or "12abc", and Too Many Digits can't Fit Anyway
+    char value[64];
+    size_t bodyLength = 0;
+    if (headerValue(client.buffer, "Content-Length", value, sizeof(value)))
+    {
+        size_t digits = strspn(value, "0123456789");
+        if (digits == 0 || value[digits + strspn(value + digits, " \t")] != '\0')
+        {
+            rejected++;
+            respond(client, 400, "", false);
+            return false;
+        }
+        bodyLength = digits <= 9 ? strtoul(value, nullptr, 10) : LAN_REQUEST_SIZE + 1;
+    }
+    if (bodyLength > LAN_REQUEST_SIZE - headLength) // headLength is Never More than the Buffer, so this can't Wrap
+    {
+        rejected++;
+        respond(client, 413, "", false);
+        return false;
+    }
+    if (client.length < headLength + bodyLength)
+    {
+        blank[2] = '\r';
+        return true;
+    }
+    used = headLength + bodyLength;
+    requests++;
+
+    char method[8];
+    char path[48];
+    if (sscanf(client.buffer, "%7s %47s", method, path) != 2)
+    {
+        rejected++;
+        respond(client, 400, "", false);
+        return false;
+    }
+    bool keepAlive = !(headerValue(client.buffer, "Connection", value, sizeof(value)) && strcasecmp(value, "close") == 0);
+
+#ifdef LAN_API_TOKEN
+    if (!headerValue(client.buffer, "Authorization", value, sizeof(value)) ||
+        strncmp(value, "Bearer ", 7) != 0 || strcmp(value + 7, LAN_API_TOKEN) != 0)
+    {
+        rejected++;
+        return respond(client, 401, "", keepAlive) && keepAlive;
+    }
+#endif
+
+    // Event Socket, the Handshake Answer is the Key Hashed with the WebSocket GUID
+    if (strcmp(path, "/events") == 0 && headerValue(client.buffer, "Sec-WebSocket-Key", value, sizeof(value)))
+    {
+        String accept = value;
+        accept += WEBSOCKET_GUID;
+        uint8_t digest[20];
+        sha1((const uint8_t *)accept.c_str(), accept.length(), digest);
+        char encoded[29];
+        base64(digest, sizeof(digest), encoded);
+
+        String head = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+        head += encoded;
+        head += "\r\n\r\n";
+        if (!alarm->hal.lan.write(client.connection, head.c_str(), head.length()))
+        {
+            return false;
+        }
+
+        client.webSocket = true;
+        String hello = "{\"state\":" + stateJson() + ",\"alarms\":" + alarmsJson() + "}";
+        pushes++;
+        return sendFrame(client, WS_TEXT, hello.c_str(), hello.length());
+    }
+
+    // Body is Null Terminated in Place for the Parsers, then Put Back for the Next Request
+    char *body = client.buffer + headLength;
+    char saved = body[bodyLength];
+    body[bodyLength] = '\0';
+    String response;
+    int status = route(method, path, body, response);
+    body[bodyLength] = saved;
+
+    if (status >= 400)
+    {
+        rejected++;
+    }
+    return respond(client, status, response, keepAlive) && keepAlive;
+}
+
+// Returns the Status
+int LocalApi::route(const char *method, const char *path, const char *body, String &response)
+{
+    bool get = strcmp(method, "GET") == 0;
+
+    if (strcmp(path, "/state") == 0)
+    {
+        if (!get)
+        {
+            return 405;
+        }
+        response = stateJson();
+        return 200;
+    }
+
+    if (strcmp(path, "/alarms") == 0)
+    {
+        if (!get)
+        {
+            return 405;
+        }
+        response = alarmsJson();
+        return 200;
+    }
+
+    if (strncmp(path, "/alarms/", 8) == 0)
+    {
+        return editAlarm(method, path + 8, body, response);
+    }
+
+    if (strcmp(path, "/volume") == 0)
+    {
+        if (strcmp(method, "PUT") == 0)
+        {
+            const char *field = strstr(body, "\"volume\"");
+            const char *colon = field != nullptr ? strchr(field, ':') : nullptr;
+            if (colon == nullptr)
+            {
+                response = "{\"error\":\"volume missing\"}";
+                return 400;
+            }
+
+            int volume = atoi(colon + 1);
+            volume = volume < 0 ? 0 : (volume > alarm->sound->maxVolume ? alarm->sound->maxVolume : volume);
+            alarm->sound->setVolume(volume);
+            alarm->uplink.volumeChanged(volume);
+        }
+        else if (!get)
+        {
+            return 405;
+        }
+
+        response = "{\"volume\":" + String(alarm->sound->getVolume()) + "}";
+        return 200;
+    }
+
+    if (strcmp(path, "/ringtones") == 0)
+    {
+        if (!get)
+        {
+            return 405;
+        }
+        response = ringtonesJson();
+        return 200;
+    }
+
+    if (strcmp(path, "/ring") == 0)
+    {
+        if (strcmp(method, "DELETE") == 0)
+        {
+            alarm->turnOffAlarm(STOP_DISMISSED);
+        }
+        else if (!get)
+        {
+            return 405;
+        }
+
+        const AlarmItem *ringing = alarm->getRingingAlarm();
+        response = "{\"ringing\":";
+        if (ringing != nullptr)
+        {
+            appendQuoted(response, ringing->key);
+        }
+        else
+        {
+            response += "null";
+        }
+        response += "}";
+        return 200;
+    }
+
+    return 404;
+}
+
+// One Past the Highest Array Index Held, 0 if No Alarm has a Numeric Key
+long LocalApi::arrayEnd()
+{
+    AlarmTable &alarms = alarm->getAlarms();
+    long end = 0;
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        const char *key = alarms[slot].key;
+        if (!alarms.isUsed(slot) || key[0] == '\0' || strspn(key, "0123456789") != strlen(key))
+        {
+            continue;
+        }
+        end = atol(key) + 1 > end ? atol(key) + 1 : end;
+    }
+    return end;
+}
+
+// Edits Go through the Firebase Patch Path and are Armed before the Answer Goes Out
+int LocalApi::editAlarm(const char *method, const char *key, const char *body, String &response)
+{
+    size_t keyLength = strlen(key);
+    bool validKey = keyLength > 0 && keyLength < ALARM_KEY_SIZE;
+    bool digits = true;
+    for (size_t i = 0; i < keyLength && validKey; i++)
+    {
+        validKey = isKeyChar(key[i]);
+        digits = digits && isdigit((unsigned char)key[i]);
+    }
+    if (!validKey)
+    {
+        response = "{\"error\":\"bad key\"}";
+        return 400;
+    }
+
+    AlarmTable &alarms = alarm->getAlarms();
+    int slot = alarms.find(key);
+
+    // Alarms the App Keeps as an Array are Edited by Index, a New One can only go on the End
+    if (digits && slot < 0 && strcmp(method, "PUT") == 0 && ((key[0] == '0' && keyLength > 1) || atol(key) != arrayEnd()))
+    {
+        response = "{\"error\":\"new array alarms go at the end\"}";
+        return 400;
+    }
+
+    AlarmPatch patch;
+    if (strcmp(method, "GET") == 0 || strcmp(method, "DELETE") == 0)
+    {
+        if (slot < 0)
+        {
+            return 404;
+        }
+        if (method[0] == 'G')
+        {
+            response = alarmJson(alarms[slot]);
+            return 200;
+        }
+        patch.type = AlarmPatch::REMOVE;
+    }
+    else if (strcmp(method, "PUT") == 0 || strcmp(method, "PATCH") == 0)
+    {
+        if (!parseAlarm(body, strlen(body), patch))
+        {
+            response = "{\"error\":\"not an alarm object\"}";
+            return 400;
+        }
+        patch.type = method[1] == 'U' ? AlarmPatch::REPLACE : AlarmPatch::UPSERT; // PUT Replaces, PATCH Merges
+        if (slot < 0 && patch.type == AlarmPatch::UPSERT)
+        {
+            return 404; // Nothing to merge into, new alarms are PUT
+        }
+        if (slot < 0 && (patch.fields & (PATCH_HOUR | PATCH_MINUTE)) != (PATCH_HOUR | PATCH_MINUTE))
+        {
+            response = "{\"error\":\"new alarms need hour and minute\"}";
+            return 400;
+        }
+    }
+    else
+    {
+        return 405;
+    }
+    copyField(patch.key, sizeof(patch.key), key);
+
+    ClockSource &clock = alarm->hal.clock;
+    uint32_t started = clock.cycles();
+    alarm->applyLocalEdit(patch);
+    editToArmed.record((clock.cycles() - started) / clock.cyclesPerMicro());
+    edits++;
+
+    if (patch.type == AlarmPatch::REMOVE)
+    {
+        response = "null";
+        writeBack(key, response);
+        return 200;
+    }
+
+    slot = alarms.find(key);
+    if (slot < 0)
+    {
+        response = "{\"error\":\"alarm table is full\"}";
+        return 507;
+    }
+    response = alarmJson(alarms[slot]);
+    writeBack(key, response);
+    return 200;
+}
+
+// Queues the Alarm as it Now Stands for Firebase, which Stays the Source of Truth
+// The clock already rings it, so a full queue is only logged, and the next full sync puts the alarm back
+void LocalApi::writeBack(const char *key, const String &json)
+{
+    AlarmEdit edit;
+    copyField(edit.key, sizeof(edit.key), key);
+    copyField(edit.json, sizeof(edit.json), json);
+    if (json.length() >= sizeof(edit.json) || !alarm->hal.cloud.pushAlarmEdit(edit))
+    {
+        unsent++;
+        LOG_WARN(LOG_NETWORK, "LAN edit of alarm %s couldn't be queued for Firebase", key);
+    }
+}
+
+// Client WebSocket Frames, only Close and Ping Matter
+// Edits go through HTTP, so text from clients is read and dropped
+bool LocalApi::handleFrame(Client &client, size_t &used)
+{
+    uint8_t *bytes = (uint8_t *)client.buffer;
+    if (client.length < 2)
+    {
+        return true;
+    }
+
+    uint8_t opcode = bytes[0] & 0x0F;
+    size_t size = bytes[1] & 0x7F;
+    size_t at = 2;
+    if ((bytes[1] & 0x80) == 0 || size == 127)
+    {
+        return false; // Client frames are always masked, and nothing here needs a 64-bit length
+    }
+    if (size == 126)
+    {
+        if (client.length < 4)
+        {
+            return true;
+        }
+        size = (bytes[2] << 8) | bytes[3];
+        at = 4;
+    }
+    if (at + 4 + size > LAN_REQUEST_SIZE)
+    {
+        return false;
+    }
+    if (client.length < at + 4 + size)
+    {
+        return true;
+    }
+
+    uint8_t *mask = bytes + at;
+    char *payload = client.buffer + at + 4;
+    for (size_t i = 0; i < size; i++)
+    {
+        payload[i] ^= mask[i % 4];
+    }
+    used = at + 4 + size;
+
+    if (opcode == WS_CLOSE)
+    {
+        sendFrame(client, WS_CLOSE, payload, size >= 2 ? 2 : 0); // Echoes the Status Code
+        return false;
+    }
+    if (opcode == WS_PING)
+    {
+        return sendFrame(client, WS_PONG, payload, size);
+    }
+    return true;
+}
+
+bool LocalApi::respond(Client &client, int status, const String &body, bool keepAlive)
+{
+    String error;
+    if (body.length() == 0 && status >= 400)
+    {
+        error = "{\"error\":\"";
+        error += statusText(status);
+        error += "\"}";
+    }
+    const String &text = body.length() > 0 || status < 400 ? body : error;
+
+    // One Write, so the Answer Leaves in as Few Packets as Possible
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n",
+             status, statusText(status), text.length(), keepAlive ? "keep-alive" : "close");
+    String response = head;
+    response += text;
+    return alarm->hal.lan.write(client.connection, response.c_str(), response.length());
+}
+
+// Unmasked and Never Fragmented, Messages here are Well under 64KB
+bool LocalApi::sendFrame(Client &client, uint8_t opcode, const char *data, size_t size)
+{
+    uint8_t head[4];
+    size_t headSize = 2;
+    head[0] = 0x80 | opcode;
+    if (size < 126)
+    {
+        head[1] = size;
+    }
+    else if (size < 65536)
+    {
+        head[1] = 126;
+        head[2] = size >> 8;
+        head[3] = size & 0xFF;
+        headSize = 4;
+    }
+    else
+    {
+        return false;
+    }
+
+    LanServer &lan = alarm->hal.lan;
+    return lan.write(client.connection, (const char *)head, headSize) && (size == 0 || lan.write(client.connection, data, size));
+}
+
+void LocalApi::broadcast(const String &json)
+{
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        Client &client = clients[i];
+        if (client.connection >= 0 && client.webSocket)
+        {
+            if (!sendFrame(client, WS_TEXT, json.c_str(), json.length()))
+            {
+                closeClient(client);
+                continue;
+            }
+            pushes++;
+        }
+    }
+}
+
+bool LocalApi::hasListeners()
+{
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        if (clients[i].connection >= 0 && clients[i].webSocket)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// One Device State Change to Every Event Socket
+void LocalApi::pushValue(const char *path, const char *value)
+{
+    if (!hasListeners())
+    {
+        return;
+    }
+
+    String json = "{";
+    appendQuoted(json, path);
+    json += ":";
+    json += value;
+    json += "}";
+    broadcast(json);
+}
+
+// Whole Alarm List to Every Event Socket
+void LocalApi::alarmsChanged()
+{
+    if (hasListeners())
+    {
+        broadcast("{\"alarms\":" + alarmsJson() + "}");
+    }
+}
+
+// Same Fields Firebase Sends, so an Alarm Read Here can be Written Back as is
+String LocalApi::alarmJson(AlarmItem &alarmItem)
+{
+    String json = "{\"id\":";
+    appendQuoted(json, alarmItem.id);
+
+    bool repeating = alarmItem.is(ALARM_REPEATING);
+    char fields[96];
+    snprintf(fields, sizeof(fields), ",\"hour\":%u,\"minute\":%u,\"active\":%s,\"sound\":%u,\"days\":%u",
+             alarmItem.hour, alarmItem.minute, alarmItem.is(ALARM_ACTIVE) ? "true" : "false", alarmItem.sound,
+             repeating ? alarmItem.days : 0);
+    json += fields;
+
+    if (!repeating)
+    {
+        appendDate(json, "date", alarmItem.fireAt / SECONDS_PER_DAY);
+    }
+    if (alarmItem.skipDate != 0)
+    {
+        appendDate(json, "skip", alarmItem.skipDate);
+    }
+    json += "}";
+    return json;
+}
+
+// Every Synced Alarm, Keyed like Firebase, Alarms Set on the Device Itself have no Key and are Left Out
+String LocalApi::alarmsJson()
+{
+    AlarmTable &alarms = alarm->getAlarms();
+    String json = "{";
+    bool first = true;
+    for (int slot = 0; slot < MAX_ALARMS; slot++)
+    {
+        if (!alarms.isUsed(slot) || alarms[slot].key[0] == '\0')
+        {
+            continue;
+        }
+
+        json += first ? "" : ",";
+        appendQuoted(json, alarms[slot].key);
+        json += ":";
+        json += alarmJson(alarms[slot]);
+        first = false;
+    }
+    json += "}";
+    return json;
+}
+
+String LocalApi::stateJson()
+{
+    const AlarmItem *ringing = alarm->getRingingAlarm();
+    int64_t untilNext = alarm->microsUntilNextAlarm();
+
+    char text[128];
+    snprintf(text, sizeof(text), "{\"time\":%lu,\"syncAge\":%ld,\"volume\":%d,\"alarms\":%d,\"nextAlarmIn\":%ld,\"ringing\":",
+             (unsigned long)alarm->rtc->getEpochNow(), alarm->rtc->getSyncAge(), alarm->sound->getVolume(),
+             alarm->getAlarms().size(), untilNext < 0 ? -1L : (long)(untilNext / 1000000));
+    String json = text;
+    if (ringing != nullptr)
+    {
+        appendQuoted(json, ringing->key);
+    }
+    else
+    {
+        json += "null";
+    }
+    json += "}";
+    return json;
+}
+
+// Sequences, then the Tracks on the Card, Each by the Name an Alarm's "sound" Takes
+String LocalApi::ringtonesJson()
+{
+    Sound *sound = alarm->sound;
+    Ringtones &ringtones = sound->ringtones;
+    char entry[80];
+    char name[SOUND_NAME_SIZE];
+
+    snprintf(entry, sizeof(entry), "{\"card\":\"%08lx\",\"ringtones\":[", (unsigned long)ringtones.fingerprint());
+    String json = entry;
+    for (int i = 0; i < sound->sequenceCount(); i++)
+    {
+        sound->nameOf(i, name, sizeof(name));
+        snprintf(entry, sizeof(entry), "%s{\"name\":\"%s\",\"sound\":%d}", i > 0 ? "," : "", name, i);
+        json += entry;
+    }
+    for (int folder = 1; folder <= RINGTONE_FOLDERS; folder++)
+    {
+        int tracks = ringtones.tracksIn(folder) < RINGTONE_TRACKS ? ringtones.tracksIn(folder) : RINGTONE_TRACKS;
+        for (int track = 1; track <= tracks; track++)
+        {
+            uint8_t number = TRACK_SOUND | (folder - 1) << 4 | (track - 1);
+            sound->nameOf(number, name, sizeof(name));
+            snprintf(entry, sizeof(entry), ",{\"name\":\"%s\",\"sound\":%u,\"seconds\":%u}",
+                     name, number, ringtones.secondsOf(folder, track));
+            json += entry;
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+// Prints Requests, Edits, Rejects and Pushes
+void LocalApi::printStats()
+{
+    int open = 0;
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        open += clients[i].connection >= 0 ? 1 : 0;
+    }
+    Serial.printf("LAN: %u requests, %u edits (armed in p99 %uus), %u not written back, %u rejected, %u pushes, %d open\n",
+                  requests, edits, editToArmed.percentile(99), unsent, rejected, pushes, open);
+}
@@ -0,0 +1,205 @@
+// Deferred Logging
+
+// Project Specific Headers
+#include "Log.h"
+
+// Standard Libraries
+#include <stdio.h>
+
+Logger logger;
+
+static char levelLetter(uint8_t level)
+{
+    switch (level)
+    {
+    case LOG_LEVEL_ERROR: return 'E';
+    case LOG_LEVEL_WARN: return 'W';
+    case LOG_LEVEL_INFO: return 'I';
+    default: return 'D';
+    }
+}
+
+static const char *moduleName(uint8_t module)
+{
+    switch (module)
+    {
+    case LOG_ALARM: return "alarm";
+    case LOG_CLOCK: return "clock";
+    case LOG_SOUND: return "sound";
+    case LOG_NETWORK: return "network";
+    case LOG_STORE: return "store";
+    default: return "?";
+    }
+}
+
+void Logger::begin(ClockSource &clock)
+{
+    this->clock = &clock;
+}
+
+// Copies a String Argument into the Record's Text, the Argument is its Offset
+void Logger::pack(LogRecord &record, const char *text)
+{
+    if (record.argCount >= LOG_MAX_ARGS)
+    {
+        return;
+    }
+
+    size_t offset = record.textUsed < LOG_TEXT_SIZE ? record.textUsed : LOG_TEXT_SIZE - 1;
+    size_t room = LOG_TEXT_SIZE - offset;
+    size_t length = 0;
+    if (text != nullptr)
+    {
+        while (text[length] != '\0' && length + 1 < room)
+        {
+            length++;
+        }
+        memcpy(record.text + offset, text, length);
+    }
+    record.text[offset + length] = '\0';
+
+    // Strings that don't fit share the last byte and print empty
+    record.textUsed = offset + length + 1 < LOG_TEXT_SIZE ? offset + length + 1 : LOG_TEXT_SIZE - 1;
+    record.args[record.argCount++] = offset;
+}
+
+// Formats a Record as "[seconds.millis] L module: message\n"
+// Walks the format one conversion at a time, since the arguments only exist as 32-bit values
+size_t Logger::format(const LogRecord &record, char *out, size_t size)
+{
+    int prefix = snprintf(out, size, "[%lu.%03lu] %c %s: ",
+                          (unsigned long)(record.at / 1000), (unsigned long)(record.at % 1000),
+                          levelLetter(record.level), moduleName(record.module));
+    size_t length = prefix > 0 && (size_t)prefix < size ? prefix : 0;
+    size_t last = size - 2; // Room Kept for the Newline
+
+    const char *f = record.format;
+    int arg = 0;
+    while (*f != '\0' && length < last)
+    {
+        if (*f != '%')
+        {
+            out[length++] = *f++;
+            continue;
+        }
+        if (f[1] == '%')
+        {
+            out[length++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // Copy Flags, Width and Precision, Drop Length Modifiers (Every Argument is 32 Bits Now)
+        char spec[16];
+        size_t s = 0;
+        spec[s++] = *f++;
+        while (*f != '\0' && strchr("-+ #0123456789.", *f) != nullptr && s < sizeof(spec) - 2)
+        {
+            spec[s++] = *f++;
+        }
+        while (*f != '\0' && strchr("hlLqjzt", *f) != nullptr)
+        {
+            f++;
+        }
+        char conversion = *f;
+        if (conversion == '\0')
+        {
+            break;
+        }
+        f++;
+        spec[s++] = conversion;
+        spec[s] = '\0';
+
+        uint32_t value = arg < record.argCount ? record.args[arg++] : 0;
+        int n = 0;
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            n = snprintf(out + length, last - length + 1, spec, (int)value);
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            n = snprintf(out + length, last - length + 1, spec, (unsigned)value);
+            break;
+        case 'c':
+            n = snprintf(out + length, last - length + 1, spec, (int)value);
+            break;
+        case 'f':
+        case 'e':
+        case 'g':
+        {
+            float number;
+            memcpy(&number, &value, sizeof(number));
+            n = snprintf(out + length, last - length + 1, spec, (double)number);
+            break;
+        }
+        case 's':
+            n = snprintf(out + length, last - length + 1, spec, record.text + (value < LOG_TEXT_SIZE ? value : LOG_TEXT_SIZE - 1));
+            break;
+        default:
+            break;
+        }
+
+        if (n > 0)
+        {
+            length += (size_t)n < last - length ? (size_t)n : last - length;
+        }
+    }
+
+    // Messages that already end a line keep a single newline
+    while (length > 0 && out[length - 1] == '\n')
+    {
+        length--;
+    }
+    out[length++] = '\n';
+    out[length] = '\0';
+    return length;
+}
+
+// Formats Waiting Records and Writes what Fits in the UART Buffer
+// A line the buffer can't take yet is kept and finished on the next drain, so this never waits on the UART
+void Logger::drain()
+{
+    for (int i = 0; i < LOG_DRAIN_BATCH; i++)
+    {
+        if (lineSent == lineLength)
+        {
+            LogRecord record;
+            if (!records.pop(record))
+            {
+                return;
+            }
+            lineLength = format(record, line, sizeof(line));
+            lineSent = 0;
+            written++;
+        }
+
+        size_t room = Serial.availableForWrite();
+        size_t chunk = lineLength - lineSent < room ? lineLength - lineSent : room;
+        if (chunk > 0)
+        {
+            Serial.write((const uint8_t *)line + lineSent, chunk);
+            lineSent += chunk;
+        }
+        if (lineSent < lineLength)
+        {
+            return; // UART buffer is full
+        }
+    }
+}
+
+// Nothing Waiting or Half Written
+bool Logger::isEmpty()
+{
+    return lineSent == lineLength && records.count() == 0;
+}
+
+// Prints Records Written and Dropped
+void Logger::printStats()
+{
+    Serial.printf("Log: %u written, %u dropped, %u waiting\n",
+                  (unsigned)written, (unsigned)getDropped(), (unsigned)records.count());
+}
@@ -6,18 +6,43 @@
 // External Library Headers
 #include <WiFi.h>
 #include <WiFiMulti.h>
+#include <WiFiUdp.h>
+#include <esp_timer.h>
 #include <addons/TokenHelper.h>
 #include <addons/RTDBHelper.h>
 
 // Project Specific Headers
 #include "secrets.h"
-#include "Alarm.h"
 #include "Network.h"
+#include "AlarmParser.h"
+#include "Log.h"
 
 // WIFI Variables
 WiFiMulti wifiMulti;
 
-const int WIFI_TIMEOUT = 100000; // Maximum time for Wifi to connect. Increase if necessary.
+const int WIFI_TIMEOUT = 10000;  // Maximum time for one Wifi connection attempt. Increase if necessary.
+const int WIFI_RETRY = 5000;     // Wait between failed Wifi connection attempts
+const int AUTH_TIMEOUT = 30000;  // Maximum time to wait for Firebase sign-in before starting over
+const unsigned long UPDATE_BACKOFF_MIN = 5000;    // First wait after a device update fails
+const unsigned long UPDATE_BACKOFF_MAX = 300000;  // Longest wait between device update retries
+
+// Stream Supervisor Variables
+const unsigned long STREAM_SILENT = 90000;          // Firebase sends a keep-alive every 30s, three missed means the stream is dead
+const unsigned long RECONNECT_BACKOFF_MIN = 2000;   // First wait before reopening a dropped stream
+const unsigned long RECONNECT_BACKOFF_MAX = 300000; // Longest wait between reconnects
+const unsigned long REFETCH_CHECK_PERIOD = 900000;  // Version is checked this often even if the stream looks fine
+
+// NTP Variables
+WiFiUDP ntpUDP;
+
+const char *NTP_SERVER = "pool.ntp.org";
+const int NTP_PORT = 123;
+const int NTP_PACKET_SIZE = 48;
+const unsigned long NTP_PERIOD = 3600000;     // Resync every hour, often enough to learn the DS1302's drift
+const unsigned long NTP_RETRY = 60000;        // Wait after a request goes unanswered
+const unsigned long NTP_REPLY_TIMEOUT = 2000; // Give up on a reply after this long
+const uint32_t NTP_TO_UNIX = 2208988800UL;    // Seconds from 1900 to 1970
+const long TIME_OFFSET = -14400;              // Timezone Offset in Seconds
 
 // Firebase Variables
 FirebaseData fbdo;
@@ -25,23 +50,47 @@ FirebaseData stream;
 unsigned long sendDataPrevMillis = 0;
 bool firebaseChanged = false; // Flag to check if firebase data has been changed
 
-// Network Constructor
-Network::Network(Alarm &alarm) : alarm(&alarm) {}
+// Stream Events Waiting to be Applied
+// Filled by the Stream Callback, Drained by runFirebaseLoop
+struct StreamEvent
+{
+    String eventType;
+    String dataPath;
+    String dataType;
+    String data;
+};
+
+const int STREAM_QUEUE_SIZE = 8;
+StreamEvent streamQueue[STREAM_QUEUE_SIZE];
+int streamHead = 0;
+int streamCount = 0;
+SemaphoreHandle_t streamLock = nullptr;
+
+// Written from the Stream's Callbacks, Read by the Stream Supervisor
+volatile unsigned long lastStreamEventAt = 0; // Data or Keep-Alive
+volatile bool streamTimedOut = false;
+
+// Sets up Wifi and Starts the Network Task
+void Network::start()
+{
+    initWiFi();
+    startTask(); // Connect Wifi, NTP and Firebase on Core 0
+}
 
 // Wifi Events
 void WiFiEventConnected(WiFiEvent_t event, WiFiEventInfo_t info)
 {
-    Serial.println("WIFI CONNECTED! " + WiFi.SSID());
+    LOG_INFO(LOG_NETWORK, "WIFI CONNECTED! %s", WiFi.SSID().c_str());
 }
 
 void WiFiEventGotIP(WiFiEvent_t event, WiFiEventInfo_t info)
 {
-    Serial.println("LOCAL IP ADDRESS: " + WiFi.localIP().toString());
+    LOG_INFO(LOG_NETWORK, "LOCAL IP ADDRESS: %s", WiFi.localIP().toString().c_str());
 }
 
 void WiFiEventDisconnected(WiFiEvent_t event, WiFiEventInfo_t info)
 {
-    Serial.println("WIFI DISCONNECTED!");
+    LOG_WARN(LOG_NETWORK, "WIFI DISCONNECTED!");
     // WiFi SHOULD automatically reconnect!
 }
 
@@ -61,12 +110,7 @@ bool Network::initWiFi()
     wifiMulti.addAP(JAT_NETWORK[0], JAT_NETWORK[1]);
     wifiMulti.addAP(NOLAN_NETWORK[0], NOLAN_NETWORK[1]);
 
-    // Attempt Connection until Successful
-    while (connectWiFi() != true)
-    {
-        delay(100);
-    }
-
+    // Connecting is done by the network task so boot doesn't wait on it
     return true;
 }
 
@@ -74,11 +118,11 @@ bool Network::initWiFi()
 bool Network::connectWiFi()
 {
     // Attempt to Connect
-    Serial.println("Connecting Wifi...");
+    LOG_INFO(LOG_NETWORK, "Connecting Wifi...");
     if (wifiMulti.run(WIFI_TIMEOUT) != WL_CONNECTED)
     {
         // Connection Failed
-        Serial.println("WiFi failed to connect!");
+        LOG_WARN(LOG_NETWORK, "WiFi failed to connect!");
         return false; // Failure
     }
     else
@@ -90,34 +134,459 @@ bool Network::connectWiFi()
 
 void streamCallback(FirebaseStream data)
 {
-    firebaseChanged = true;
+    LOG_DEBUG(LOG_NETWORK, "stream %s at %s, data type %s, payload size %d",
+              data.eventType().c_str(),
+              data.dataPath().c_str(),
+              data.dataType().c_str(),
+              data.payloadLength());
 
-    Serial.printf("stream path, %s\nevent path, %s\ndata type, %s\nevent type, %s\n\n",
-                  data.streamPath().c_str(),
-                  data.dataPath().c_str(),
-                  data.dataType().c_str(),
-                  data.eventType().c_str());
-    printResult(data); // see addons/RTDBHelper.h
-    Serial.println();
-
-    // This is the size of stream payload received (current and max value)
-    // Max payload size is the payload size under the stream path since the stream connected
-    // and read once and will not update until stream reconnection takes place.
-    // This max value will be zero as no payload received in case of ESP8266 which
-    // BearSSL reserved Rx buffer size is less than the actual stream payload.
-    Serial.printf("Received stream payload size: %d (Max. %d)\n\n", data.payloadLength(), data.maxPayloadLength());
+    lastStreamEventAt = millis();
+    streamTimedOut = false;
 
     // Due to limited of stack memory, do not perform any task that used large memory here especially starting connect to server.
-    // Just set this flag and check it status later.
+    // Just queue the event and apply it later.
+    if (xSemaphoreTake(streamLock, portMAX_DELAY) == pdTRUE)
+    {
+        if (streamCount < STREAM_QUEUE_SIZE)
+        {
+            StreamEvent &event = streamQueue[(streamHead + streamCount) % STREAM_QUEUE_SIZE];
+            event.eventType = data.eventType();
+            event.dataPath = data.dataPath();
+            event.dataType = data.dataType();
+            event.data = data.to<String>();
+            streamCount++;
+        }
+        else
+        {
+            firebaseChanged = true; // Too many events at once, refetch everything instead
+        }
+        xSemaphoreGive(streamLock);
+    }
+}
+
+// Takes the Oldest Queued Stream Event
+bool takeStreamEvent(StreamEvent &event)
+{
+    bool found = false;
+    if (xSemaphoreTake(streamLock, portMAX_DELAY) == pdTRUE)
+    {
+        if (streamCount > 0)
+        {
+            event = streamQueue[streamHead];
+            streamHead = (streamHead + 1) % STREAM_QUEUE_SIZE;
+            streamCount--;
+            found = true;
+        }
+        xSemaphoreGive(streamLock);
+    }
+    return found;
+}
+
+// Turns a Stream Event into an Alarm Change
+void Network::applyStreamEvent(const String &eventType, const String &dataPath, const String &dataType, const String &data)
+{
+    if (eventType != "put" && eventType != "patch")
+    {
+        return; // keep-alive, cancel and auth_revoked don't change alarms
+    }
+
+    // The whole user node is sent each time the stream (re)connects, the refetch checks the version first
+    if (dataPath == "/")
+    {
+        firebaseChanged = true;
+        return;
+    }
+
+    // Stream has the Alarms up to this Version, if it Applied Every Change Before it
+    if (dataPath == "/alarmsVersion")
+    {
+        appliedVersion = appliedVersion >= 0 ? data.toInt() : -1;
+        return;
+    }
+
+    if (!dataPath.startsWith("/alarms"))
+    {
+        return; // Not an alarm change
+    }
+
+    // Path is "/alarms", "/alarms/<key>" or "/alarms/<key>/<field>"
+    String rest = dataPath.substring(7);
+
+    // Whole alarm list was replaced, sync straight from the payload
+    if (rest.length() == 0)
+    {
+        if (eventType != "put" || !publishAlarmSet(data))
+        {
+            forceFullRefetch(); // Multi-alarm patches fall back to a refetch
+        }
+        return;
+    }
+
+    if (rest[0] != '/')
+    {
+        return; // Some other node that starts with "alarms"
+    }
+
+    AlarmPatch patch;
+    int slash = rest.indexOf('/', 1);
+
+    if (slash < 0)
+    {
+        // Whole alarm added, replaced or deleted, a patch event only changes the children it carries
+        copyField(patch.key, sizeof(patch.key), rest.substring(1));
+        patch.type = eventType == "put" ? AlarmPatch::REPLACE : AlarmPatch::UPSERT;
+
+        if (dataType == "null")
+        {
+            patch.type = AlarmPatch::REMOVE;
+        }
+        else if (dataType != "json" || !parseAlarm(data.c_str(), data.length(), patch))
+        {
+            return;
+        }
+    }
+    else
+    {
+        // Single field changed, the alarm core drops it and asks for a refetch if it doesn't hold the alarm
+        copyField(patch.key, sizeof(patch.key), rest.substring(1, slash));
+        readAlarmField(rest.substring(slash + 1).c_str(), data.c_str(), patch);
+
+        if (patch.fields == 0)
+        {
+            return; // Field we don't use
+        }
+    }
+
+    publishPatch(patch);
+}
+
+// Queues One Alarm Change for the Alarm Core
+void Network::publishPatch(AlarmPatch &patch)
+{
+    patch.seq = nextSeq++;
+    if (!patches.push(patch))
+    {
+        forceFullRefetch(); // Alarm core is behind, refetch everything instead
+    }
+}
+
+// Stream Changes were Lost, so the Version Can't be Trusted
+void Network::forceFullRefetch()
+{
+    appliedVersion = -1;
+    appliedETag = "";
+    firebaseChanged = true;
+}
+
+// Parses and Hands Over a Full Alarm List, Returns false if the Payload isn't Valid
+bool Network::publishAlarmSet(const String &payload)
+{
+    AlarmSet &set = alarmSets.writeSlot();
+    if (!parseAlarmList(payload.c_str(), payload.length(), set))
+    {
+        LOG_ERROR(LOG_NETWORK, "Alarm list didn't parse");
+        return false; // Slot isn't published, so the half-filled set is never seen
+    }
+
+    set.seq = nextSeq++;
+    alarmSets.publish();
+    return true;
+}
+
+// Alarm Core Side, Returns false when Nothing New
+bool Network::takeAlarmSet(AlarmSet &set)
+{
+    return alarmSets.take(set);
+}
+
+bool Network::takePatch(AlarmPatch &patch)
+{
+    return patches.pop(patch);
+}
+
+// A Change Couldn't be Applied, so the Whole List is Fetched Again
+void Network::requestRefetch()
+{
+    refetchRequested.store(true, std::memory_order_release);
+}
+
+// Runs Networking on its Own Task so Firebase Stalls never Hold Up the Alarm Core
+void networkTask(void *param)
+{
+    Network *network = static_cast<Network *>(param);
+    for (;;)
+    {
+        network->runNetworkLoop();
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+// Brings Up Wifi, Time and Firebase One Stage at a Time, then Runs Firebase
+void Network::runNetworkLoop()
+{
+    static unsigned long retryAt = 0;
+
+    switch (stage)
+    {
+    case NET_WIFI:
+        if ((long)(millis() - retryAt) < 0)
+        {
+            break; // Waiting before trying again
+        }
+        if (connectWiFi())
+        {
+            stage = NET_TIME;
+        }
+        else
+        {
+            retryAt = millis() + WIFI_RETRY;
+        }
+        break;
+
+    case NET_TIME:
+        ntpUDP.begin(NTP_PORT);
+        nextNtpAt = millis(); // First request goes out right away, the reply is picked up on a later pass
+        initFirebase();
+        stage = NET_AUTH;
+        break;
+
+    case NET_AUTH:
+        if (auth.token.uid != "")
+        {
+            startStream();
+            stage = NET_ONLINE;
+        }
+        else if (millis() - authStarted > AUTH_TIMEOUT)
+        {
+            LOG_WARN(LOG_NETWORK, "Firebase sign-in timed out, trying again");
+            initFirebase();
+        }
+        break;
+
+    case NET_ONLINE:
+        runFirebaseLoop();
+        break;
+    }
+
+    if (stage != NET_WIFI && stage != NET_TIME)
+    {
+        updateNtp();
+    }
 }
 
+// Asks the NTP Server for the Time every NTP_PERIOD, Never Waiting on the Reply
+// The RTC itself is only written from the alarm core so the two cores never share the DS1302 wires
+void Network::updateNtp()
+{
+    if (!ntpWaiting)
+    {
+        if ((long)(millis() - nextNtpAt) >= 0 && WiFi.isConnected())
+        {
+            requestNtp();
+        }
+        return;
+    }
+
+    if (ntpUDP.parsePacket() >= NTP_PACKET_SIZE)
+    {
+        readNtpReply();
+    }
+    else if (millis() - ntpSentAt > NTP_REPLY_TIMEOUT)
+    {
+        ntpWaiting = false;
+        nextNtpAt = millis() + NTP_RETRY;
+        LOG_WARN(LOG_NETWORK, "Couldn't connect to NTP, keeping RTC time");
+    }
+}
+
+void Network::requestNtp()
+{
+    uint8_t packet[NTP_PACKET_SIZE] = {};
+    packet[0] = 0b11100011; // Unsynchronized, Version 4, Client
+    packet[2] = 6;          // Polling Interval
+    packet[3] = 0xEC;       // Peer Clock Precision
+
+    while (ntpUDP.parsePacket() > 0)
+    {
+        ntpUDP.flush(); // Late replies to an earlier request
+    }
+
+    ntpUDP.beginPacket(NTP_SERVER, NTP_PORT);
+    ntpUDP.write(packet, NTP_PACKET_SIZE);
+    ntpUDP.endPacket();
+
+    ntpSentMicros = esp_timer_get_time();
+    ntpSentAt = millis();
+    ntpWaiting = true;
+}
+
+// NTP Timestamp (Seconds and 32-Bit Fraction since 1900) as Local Epoch Microseconds
+static int64_t ntpToEpochMicros(const uint8_t *stamp)
+{
+    uint32_t seconds = (uint32_t)stamp[0] << 24 | (uint32_t)stamp[1] << 16 | (uint32_t)stamp[2] << 8 | stamp[3];
+    uint32_t fraction = (uint32_t)stamp[4] << 24 | (uint32_t)stamp[5] << 16 | (uint32_t)stamp[6] << 8 | stamp[7];
+    return ((int64_t)(seconds - NTP_TO_UNIX) + TIME_OFFSET) * 1000000 + (((uint64_t)fraction * 1000000) >> 32);
+}
+
+// Server Time when the Reply Arrived is its Send Time plus Half the Network Delay
+void Network::readNtpReply()
+{
+    int64_t arrivedAt = esp_timer_get_time();
+    uint8_t packet[NTP_PACKET_SIZE];
+    ntpUDP.read(packet, NTP_PACKET_SIZE);
+    ntpWaiting = false;
+
+    int64_t received = ntpToEpochMicros(packet + 32); // When the Server Got the Request
+    int64_t sent = ntpToEpochMicros(packet + 40);     // When the Server Replied
+    int64_t delay = (arrivedAt - ntpSentMicros) - (sent - received);
+    if ((packet[1] == 0 || packet[1] > 15) || delay < 0)
+    {
+        nextNtpAt = millis() + NTP_RETRY; // Kiss-of-death or a garbled reply
+        return;
+    }
+
+    NtpSample &sample = ntpSamples.writeSlot();
+    sample.epochMicros = sent + delay / 2;
+    sample.takenAt = arrivedAt;
+    sample.roundTrip = delay;
+    ntpSamples.publish();
+
+    nextNtpAt = millis() + NTP_PERIOD;
+    LOG_INFO(LOG_NETWORK, "NTP Finished, round trip %ums", (unsigned)(delay / 1000));
+}
+
+bool Network::takeNtpSample(NtpSample &sample)
+{
+    return ntpSamples.take(sample);
+}
+
+// Hands Loop Stats to the Network Task, Replacing any it hasn't Sent Yet
+void Network::pushStats(const String &json)
+{
+    statsOut.writeSlot() = json;
+    statsOut.publish();
+}
+
+// Hands Over One Multi-Path Device Update, false while the Last One is Still Going Out
+// The string is only written here while nothing is pending, and only read by the network task while something is
+bool Network::pushUpdate(const String &json)
+{
+    if (updatePending.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    updateOut = json;
+    updatePending.store(true, std::memory_order_release);
+    return true;
+}
+
+// Sends the Waiting Device Update, Backing Off when it Fails
+// One PATCH under the device node carries the whole batch, so the stream echo is ignored as a non-alarm path
+void Network::sendUpdate()
+{
+    if (!updatePending.load(std::memory_order_acquire) || (long)(millis() - updateRetryAt) < 0 || !Firebase.ready())
+    {
+        return;
+    }
+
+    FirebaseJson json;
+    json.setJsonData(updateOut);
+    if (Firebase.RTDB.updateNode(&fbdo, String("/users/") + uid + "/device", &json))
+    {
+        updateBackoff = 0;
+        updatePending.store(false, std::memory_order_release);
+        return;
+    }
+
+    updateBackoff = updateBackoff == 0 ? UPDATE_BACKOFF_MIN : updateBackoff * 2;
+    updateBackoff = updateBackoff < UPDATE_BACKOFF_MAX ? updateBackoff : UPDATE_BACKOFF_MAX;
+    updateRetryAt = millis() + updateBackoff;
+    LOG_WARN(LOG_NETWORK, "Device update failed, retrying in %lus, %s", updateBackoff / 1000, fbdo.errorReason().c_str());
+}
+
+// Queues an Alarm Written over the LAN for Firebase, false if the Queue is Full
+bool Network::pushAlarmEdit(const AlarmEdit &edit)
+{
+    return editsOut.push(edit);
+}
+
+// Writes the Oldest LAN Edit to Firebase, Backing Off when it Fails
+// One multi-path update replaces the alarm and bumps alarmsVersion together, like an edit from the app.
+// Its stream echo arrives as a patch of the user node, so the refetch that follows reads the list back.
+void Network::sendAlarmEdit()
+{
+    if (!editHeld)
+    {
+        editHeld = editsOut.pop(editOut);
+    }
+    if (!editHeld || (long)(millis() - editRetryAt) < 0 || !Firebase.ready())
+    {
+        return;
+    }
+
+    String update = String("{\"alarms/") + editOut.key + "\":" + editOut.json +
+                    ",\"alarmsVersion\":{\".sv\":{\"increment\":1}}}";
+    FirebaseJson json;
+    json.setJsonData(update);
+    if (Firebase.RTDB.updateNode(&fbdo, String("/users/") + uid, &json))
+    {
+        LOG_DEBUG(LOG_NETWORK, "LAN edit of alarm %s written back", editOut.key);
+        editBackoff = 0;
+        editHeld = false;
+        return;
+    }
+
+    // Refused for this Long while Online, so it's Given Up and the Next Refetch Puts the Clock Back
+    if (editBackoff == UPDATE_BACKOFF_MAX)
+    {
+        LOG_ERROR(LOG_NETWORK, "Alarm %s write-back given up, %s", editOut.key, fbdo.errorReason().c_str());
+        editBackoff = 0;
+        editHeld = false;
+        return;
+    }
+
+    editBackoff = editBackoff == 0 ? UPDATE_BACKOFF_MIN : editBackoff * 2;
+    editBackoff = editBackoff < UPDATE_BACKOFF_MAX ? editBackoff : UPDATE_BACKOFF_MAX;
+    editRetryAt = millis() + editBackoff;
+    LOG_WARN(LOG_NETWORK, "Alarm %s write-back failed, retrying in %lus, %s", editOut.key, editBackoff / 1000,
+             fbdo.errorReason().c_str());
+}
+
+// Returns if Firebase is Signed In and Streaming
+bool Network::isOnline()
+{
+    return stage == NET_ONLINE && streamUp;
+}
+
+// Bringing Up, Refetching or Applying Stream Events
+// Light sleep stops both cores, so the alarm core stays awake until the network task is idle
+bool Network::isBusy()
+{
+    bool updateDue = updatePending && (long)(millis() - updateRetryAt) >= 0; // Backing off can sleep
+    bool editDue = editsWaiting() && (long)(millis() - editRetryAt) >= 0;
+    bool reconnectDue = !streamUp && (long)(millis() - reconnectAt) >= 0;
+    return stage != NET_ONLINE || firebaseChanged || streamCount > 0 || ntpWaiting || updateDue || editDue || reconnectDue; // Sleeping would skew the NTP round trip
+}
+
+// Runs Network Bring-Up and the Firebase Loop on its Own Task on Core 0
+void Network::startTask()
+{
+    // Arduino loop() and the alarm logic stay on core 1
+    xTaskCreatePinnedToCore(networkTask, "network", 8192, this, 1, &task, 0);
+}
+
+// Only Flags the Timeout, superviseStream Decides when to Reconnect
 void streamTimeoutCallback(bool timeout)
 {
     if (timeout)
-        Serial.println("stream timed out, resuming...\n");
+    {
+        streamTimedOut = true;
+        LOG_INFO(LOG_NETWORK, "stream timed out");
+    }
 
     if (!stream.httpConnected())
-        Serial.printf("error code: %d, reason: %s\n\n", stream.httpCode(), stream.errorReason().c_str());
+        LOG_WARN(LOG_NETWORK, "error code: %d, reason: %s", stream.httpCode(), stream.errorReason().c_str());
 }
 
 // Setup Firebase Connection
@@ -140,67 +609,201 @@ void Network::initFirebase()
 
     // Begins Firebase Connection using Authetication Information
     Firebase.begin(&config, &auth);
+    authStarted = millis();
 
     // Stream Setup
-    stream.keepAlive(5, 5, 1); // TCP KeepAlive For more reliable stream operation and tracking the server connection status
-
-    // Getting the user UID might take a few seconds
-    Serial.println("Getting User UID");
-    while ((auth.token.uid) == "")
+    if (streamLock == nullptr)
     {
-        Serial.print('.');
-        delay(1000);
+        streamLock = xSemaphoreCreateMutex();
     }
+    stream.keepAlive(5, 5, 1); // TCP KeepAlive For more reliable stream operation and tracking the server connection status
 
+    // Getting the user UID might take a few seconds, runNetworkLoop waits for it
+    LOG_INFO(LOG_NETWORK, "Getting User UID");
+}
+
+// Opens the Alarm Stream once Signed In
+void Network::startStream()
+{
     uid = String(auth.token.uid.c_str());
 
     String path = String("/users/") + uid;
 
-    Serial.print("Found Path: ");
-    Serial.println(path);
+    LOG_INFO(LOG_NETWORK, "Found Path: %s", path.c_str());
 
     if (!Firebase.RTDB.beginStream(&stream, path))
     {
-        Serial.printf("stream begin error, %s\n\n", stream.errorReason().c_str());
+        LOG_ERROR(LOG_NETWORK, "stream begin error, %s", stream.errorReason().c_str());
     }
     else
     {
-        Serial.println("Firebase Started");
+        LOG_INFO(LOG_NETWORK, "Firebase Started");
     }
 
-    Serial.println("Firebase Started");
     Firebase.RTDB.setStreamCallback(&stream, streamCallback, streamTimeoutCallback);
+    lastStreamEventAt = millis();
+    streamTimedOut = false;
+    streamUp = true;
 }
 
-void Network::runFirebaseLoop()
+// Reopens a Dropped or Silent Stream with Jittered Backoff
+// A stream that's down can't be trusted to have every change, so reopening it also refetches (its first put does)
+void Network::superviseStream()
 {
-    if (Firebase.ready() && ((firebaseChanged && millis() - sendDataPrevMillis > 5000) || sendDataPrevMillis == 0))
+    unsigned long silentFor = millis() - lastStreamEventAt;
+    bool healthy = stream.httpConnected() && !streamTimedOut && silentFor < STREAM_SILENT;
+
+    if (healthy)
     {
-        sendDataPrevMillis = millis();
-        firebaseChanged = false;
+        if (!streamUp)
+        {
+            LOG_INFO(LOG_NETWORK, "Stream back after %lus, %u reconnects so far", (millis() - streamDownSince) / 1000, reconnects);
+            streamUp = true;
+        }
+        reconnectBackoff = 0;
+        return;
+    }
 
-        String path = String("/users/") + uid + "/alarms";
+    if (streamUp)
+    {
+        streamUp = false;
+        streamDownSince = millis();
+        reconnectAt = millis();
+        drops++;
+        LOG_WARN(LOG_NETWORK, "Stream down, last event %lus ago, %u drops", silentFor / 1000, drops);
+    }
 
-        Serial.println("Looking for Data...");
-        if (Firebase.RTDB.getArray(&fbdo, path))
+    if ((long)(millis() - reconnectAt) < 0 || !Firebase.ready())
+    {
+        return;
+    }
+
+    // Full Jitter, so Devices Dropped by the Same Outage don't all Come Back at Once
+    reconnectBackoff = reconnectBackoff == 0 ? RECONNECT_BACKOFF_MIN : reconnectBackoff * 2;
+    reconnectBackoff = reconnectBackoff < RECONNECT_BACKOFF_MAX ? reconnectBackoff : RECONNECT_BACKOFF_MAX;
+    reconnectAt = millis() + reconnectBackoff / 2 + random(reconnectBackoff / 2 + 1);
+    reconnects++;
+
+    Firebase.RTDB.endStream(&stream);
+    if (!Firebase.RTDB.beginStream(&stream, String("/users/") + uid))
+    {
+        LOG_WARN(LOG_NETWORK, "Stream reconnect failed, %s", stream.errorReason().c_str());
+        return;
+    }
+    lastStreamEventAt = millis(); // Gets until STREAM_SILENT to send its first event
+    streamTimedOut = false;
+}
+
+// Full Alarm List, Skipped when alarmsVersion hasn't Changed
+// RTDB only honors ETags on writes, so an unchanged list is found through the app's version counter instead,
+// and the ETag only saves parsing a list that came back the same
+void Network::refetchAlarms()
+{
+    String base = String("/users/") + uid;
+    long version = -1;
+
+    if (!versionMissing)
+    {
+        if (!Firebase.RTDB.get(&fbdo, base + "/alarmsVersion"))
         {
-            if (fbdo.dataType() == "array")
-            {
-                FirebaseJsonArray &arr = fbdo.to<FirebaseJsonArray>();
-                // Deserialize to serial with prettify option
-                // Serial.println("Data!");
-                alarm->syncAlarms(arr);
-            }
-            else
+            firebaseChanged = true; // Try again on the next pass
+            return;
+        }
+
+        if (fbdo.dataType() == "int")
+        {
+            version = fbdo.to<int>();
+            if (version == appliedVersion)
             {
-                Serial.print("Data Type Mismatch: ");
-                Serial.println(fbdo.dataType());
+                refetchesSkipped++;
+                LOG_DEBUG(LOG_NETWORK, "Alarms unchanged at version %ld, %u refetches skipped", version, refetchesSkipped);
+                return;
             }
         }
+        else
+        {
+            versionMissing = true;
+            LOG_INFO(LOG_NETWORK, "No alarmsVersion, every refetch downloads the full list");
+        }
     }
-    // After calling stream.keepAlive, now we can track the server connecting status
-    if (!stream.httpConnected())
+
+    LOG_INFO(LOG_NETWORK, "Looking for Data...");
+    if (!Firebase.RTDB.get(&fbdo, base + "/alarms"))
     {
-        // Server was disconnected!
+        firebaseChanged = true;
+        return;
     }
+
+    String etag = fbdo.ETag();
+    if (etag.length() > 0 && etag == appliedETag)
+    {
+        appliedVersion = version;
+        refetchesSkipped++;
+        return; // Same list as last time, nothing to parse
+    }
+
+    // Parsed straight from the raw payload, sparse lists come back as objects
+    if (fbdo.dataType() == "array" || fbdo.dataType() == "json" || fbdo.dataType() == "null")
+    {
+        if (publishAlarmSet(fbdo.payload()))
+        {
+            appliedVersion = version;
+            appliedETag = etag;
+        }
+    }
+    else
+    {
+        LOG_WARN(LOG_NETWORK, "Data Type Mismatch: %s", fbdo.dataType().c_str());
+    }
+}
+
+void Network::runFirebaseLoop()
+{
+    // Apply stream changes one alarm at a time
+    StreamEvent event;
+    while (streamLock != nullptr && takeStreamEvent(event))
+    {
+        applyStreamEvent(event.eventType, event.dataPath, event.dataType, event.data);
+    }
+
+    if (refetchRequested.exchange(false, std::memory_order_acq_rel))
+    {
+        forceFullRefetch();
+    }
+
+    // Stream Changes can be Missed without it Noticing, so the Version is Checked Now and Then too
+    if (millis() - lastRefetchCheck > REFETCH_CHECK_PERIOD)
+    {
+        lastRefetchCheck = millis();
+        firebaseChanged = true;
+    }
+
+    // LAN Edits go Out First, a List Fetched before they Land would Undo them on the Clock
+    sendAlarmEdit();
+
+    // Refetch when the stream (re)connects or fell behind, cheap when nothing changed
+    if (Firebase.ready() && !editsWaiting() && ((firebaseChanged && millis() - sendDataPrevMillis > 5000) || sendDataPrevMillis == 0))
+    {
+        sendDataPrevMillis = millis();
+        firebaseChanged = false;
+        refetchAlarms();
+    }
+    // Upload Loop Stats from the Alarm Core
+    // The stream ignores this path, only "/alarms" changes reach the alarm core
+    String stats;
+    if (Firebase.ready() && statsOut.take(stats))
+    {
+        FirebaseJson json;
+        json.setJsonData(stats);
+        if (!Firebase.RTDB.setJSON(&fbdo, String("/users/") + uid + "/loopStats", &json))
+        {
+            LOG_WARN(LOG_NETWORK, "Stats upload failed, %s", fbdo.errorReason().c_str());
+        }
+    }
+
+    // Device State Batched by the Alarm Core
+    sendUpdate();
+
+    // After calling stream.keepAlive, now we can track the server connecting status
+    superviseStream();
 }
@@ -0,0 +1,99 @@
+// Sleeps between Real Deadlines and Tracks how Much the CPU is Awake
+
+// Project Specific Headers
+#include "Alarm.h"
+#include "Power.h"
+
+// Power Constructor
+Power::Power(Alarm &alarm) : alarm(&alarm) {}
+
+// Returns if Nothing Needs Polling
+// Ringing, held buttons, the volume readout, unacked player commands, DS1302 tick capture and network work all need the loop awake
+bool Power::canSleep()
+{
+    return alarm->isBooted() &&
+           !alarm->sound->checkIsRinging() &&
+           !alarm->sound->recentlyChangedVolume &&
+           alarm->sound->isAudioIdle() &&
+           !alarm->buttons.anyDown() &&
+           !alarm->rtc->isCapturing() &&
+           !alarm->houseSync->isWaiting() &&
+           !alarm->hal.cloud.isBusy();
+}
+
+// Waits for the Next Deadline, Light Sleeping through it when Nothing Needs Polling
+// Only timed tasks and the next alarm end a sleep, polled tasks catch up when it wakes
+void Power::idle()
+{
+    ClockSource &clock = alarm->hal.clock;
+    TaskScheduler &scheduler = alarm->scheduler;
+
+    int64_t started = clock.micros();
+    int64_t untilAlarm = alarm->microsUntilNextAlarm();
+
+    if (sleepEnabled && canSleep())
+    {
+        unsigned long wait = scheduler.untilNextDeadline(true);
+        if (untilAlarm >= 0 && (unsigned long)((untilAlarm + 999) / 1000) < wait)
+        {
+            wait = (untilAlarm + 999) / 1000;
+        }
+
+        if (wait >= MIN_LIGHT_SLEEP)
+        {
+            clock.lightSleep(wait);
+            scheduler.wokeUp();
+            sleeps++;
+        }
+        else
+        {
+            scheduler.idle();
+        }
+    }
+    else
+    {
+        scheduler.idle();
+    }
+
+    // Check Alarms the Moment One is Due, instead of at the Alarm Task's Next Run
+    int64_t ended = clock.micros();
+    if (untilAlarm >= 0 && ended - started >= untilAlarm)
+    {
+        scheduler.runSoon(alarm->alarmTask, clock.millis());
+    }
+
+    idleMicros += ended - started;
+    wakeups++;
+}
+
+void Power::setSleep(bool on)
+{
+    sleepEnabled = on;
+}
+
+bool Power::isSleepEnabled()
+{
+    return sleepEnabled;
+}
+
+// Prints Awake Percentage and Wake-Ups per Minute, then Starts Over
+void Power::printStats()
+{
+    int64_t now = alarm->hal.clock.micros();
+    int64_t elapsed = now - windowStart;
+    if (elapsed <= 0)
+    {
+        elapsed = 1;
+    }
+
+    Serial.printf("Power: sleep %s, awake %.1f%%, %lu wakeups/min (%lu light sleeps)\n",
+                  sleepEnabled ? "on" : "off",
+                  100.0 * (elapsed - idleMicros) / elapsed,
+                  (unsigned long)(wakeups * 60000000LL / elapsed),
+                  (unsigned long)sleeps);
+
+    windowStart = now;
+    idleMicros = 0;
+    wakeups = 0;
+    sleeps = 0;
+}
@@ -3,155 +3,429 @@
 // Project Specific Headers
 #include "Alarm.h"
 #include "RealTime.h"
+#include "Log.h"
 
-// RTC Variables
-// CONNECTIONS:
-// DS1302 CLK/SCLK --> 5, DS1302 DAT/IO --> 4, DS1302 RST/CE --> 2, DS1302 VCC --> 3.3v - 5v, DS1302 GND --> GND
-ThreeWire myWire(4, 5, 2); // IO, SCLK, CE
-RtcDS1302<ThreeWire> Rtc(myWire);
+// Software Clock Variables
+const unsigned long DISCIPLINE_PERIOD = 15UL * 60 * 1000; // How often the software clock is checked against the DS1302
+const int32_t MAX_DRIFT_PPB = 500000; // Drift samples beyond 500ppm are bad captures, not a real crystal
+const int64_t SLEW_PPB = 500000;            // Corrections are worked in at up to 0.5ms per second, so a second takes about 33 minutes
+const int64_t MAX_SLEW_MICROS = 1000000;    // Bigger corrections are stepped
+const int64_t RATE_BASELINE = 30LL * 60 * 1000000; // Shortest span between NTP samples the clock's rate is measured over
 
-// NTP Variables
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP);
+// DS1302 Drift Variables
+const unsigned long NTP_STALE = 3UL * 60 * 60 * 1000;  // Without an NTP sample this long, the DS1302 is the reference again
+const int64_t RTC_BASELINE = 2LL * 60 * 60 * 1000000;  // DS1302 edges are only good to a poll period, so its drift needs a long span
+const int64_t RTC_REWRITE_MICROS = 2000000;            // DS1302 is set again once it's this far off
+const int64_t RTC_WRITE_WINDOW = 30000;                // How far into a second the DS1302 may still be set
+const char *CALIBRATION_KEY = "rtccal";
 
-// Function Reference
-void printDateTime(const RtcDateTime &dt);
+// DS1302 Drift Kept in Flash, so a Restart without Network still Corrects it
+struct RtcCalibration {
+    int32_t ppb;
+    uint32_t setAt; // Epoch the DS1302 was Last Set from NTP
+};
+
+// Date and Time in Logs, the Arguments Take a CivilTime
+#define DATE_TIME_FORMAT "%02u/%02u/%04u %02u:%02u:%02u"
+#define DATE_TIME_ARGS(dt) dt.month, dt.day, dt.year, dt.hour, dt.minute, dt.second
 
 // RTC Constructor
 RealTime::RealTime(Alarm& alarm) : alarm(&alarm) {}
 
-// Initialize the RTC/NTP and Sync Time
+// Initialize the RTC and Load its Saved Time
+// Doesn't wait on the network, NTP time corrects it once Wifi is up
 void RealTime::initRTC()
 {
-    /// NTP Setup
-    Serial.println("Setting NTP");
-    timeClient.begin();               // Begins Client & Connects
-    timeClient.setTimeOffset(-14400); // Set Timezone Offset
-    timeClient.update();              // Syncs Time
-    Serial.println("NTP Finished");
+    ClockSource &clock = alarm->hal.clock;
 
     /// RTC Setup
-    Rtc.Begin(); // Begins Real Time Clock
+    clock.beginRtc(); // Begins Real Time Clock
+
+    // Use the Time the RTC already has!
 
-    if (Rtc.GetIsWriteProtected()) // Turn off Write Protected
+    // Save Compile Time
+    uint32_t compiled = parseCompileTime(__DATE__, __TIME__);
+
+    // Check if RTC has valid time
+    uint32_t now;
+    bool setToCompiled = false;
+    if (!clock.readRtc(now))
     {
-        Serial.println("RTC was write protected, enabling writing now");
-        Rtc.SetIsWriteProtected(false);
+        // RTC Doesn't have Valid Time, Update to Compile Time
+
+        // Common Causes:
+        //    1) first time you ran and the device wasn't running yet
+        //    2) the battery on the device is low or even missing
+
+        CivilTime dt = toCivil(compiled);
+        LOG_WARN(LOG_CLOCK, "RTC lost confidence in the DateTime! Using Compile Time " DATE_TIME_FORMAT, DATE_TIME_ARGS(dt));
+        clock.writeRtc(compiled);
+        now = compiled;
+        setToCompiled = true;
     }
 
-    if (!Rtc.GetIsRunning()) // Make sure RTC is running
+    // Until NTP is reached, compare saved time to compile time
+    // Update RTC only if time is behind the compile time.
+    if (now < compiled)
+    {
+        LOG_WARN(LOG_CLOCK, "RTC is older than compile time! Setting Time to Compile Time.");
+        clock.writeRtc(compiled);
+        setToCompiled = true;
+    }
+    else if (now > compiled) // Don't need to update time
+    {
+        LOG_INFO(LOG_CLOCK, "RTC is newer than compile time. (this is expected)");
+    }
+    else if (now == compiled) // Don't need to update time
     {
-        Serial.println("RTC was not actively running, starting now");
-        Rtc.SetIsRunning(true);
+        LOG_INFO(LOG_CLOCK, "RTC is the same as compile time! (not expected but all is fine)");
     }
 
-    if (timeClient.isTimeSet())
-    { // Sets time to NTP if server connected
-        // Converts the NTP time to a RTC Date Time Object
-        timeClient.update();              // Syncs Time
-        RtcDateTime timeToSet;
-        timeToSet.InitWithUnix64Time(timeClient.getEpochTime());
+    // DS1302 Drift Learned before the Restart, its Error has Grown since it was Last Set
+    RtcCalibration calibration;
+    if (alarm->hal.storage.read(CALIBRATION_KEY, &calibration, sizeof(calibration)) == sizeof(calibration))
+    {
+        rtcPpb = calibration.ppb;
+        haveRtcPpb = true;
+        rtcSetAt = calibration.setAt;
+        if (!setToCompiled && now > rtcSetAt)
+        {
+            rtcErrorMicros = (int64_t)(now - rtcSetAt) * rtcPpb / 1000;
+        }
+        LOG_INFO(LOG_CLOCK, "DS1302 drift %ldppb, %ldms off since it was set", (long)rtcPpb, (long)(rtcErrorMicros / 1000));
+    }
+    rtcErrorTakenAt = clock.micros();
 
-        // Set Time
-        Rtc.SetDateTime(timeToSet);
-        Serial.print("Setting Time to NTP! - ");
-        printDateTime(timeToSet);
-        Serial.println();
+    // Rough anchor until disciplineClock catches the next second tick
+    anchorClock((int64_t)readRtcEpoch() * 1000000 - rtcErrorMicros, clock.micros());
+}
+
+void RealTime::runRTCLoop()
+{
+    // Apply Time Handed Over by the Network
+    NtpSample sample;
+    if (alarm->hal.cloud.takeNtpSample(sample))
+    {
+        applyNtp(sample);
     }
-    else // Use Existing RTC time / Update it if incorrect
+
+    // Print Time Now, Only Debug Builds Keep it
+    if (LOG_ENABLED(LOG_LEVEL_DEBUG, LOG_CLOCK))
     {
-        // Use the Time the RTC already has!
-        Serial.println("Couldn't connect to NTP");
+        CivilTime dt = toCivil(getEpochNow());
+        LOG_DEBUG(LOG_CLOCK, "RTC Time: " DATE_TIME_FORMAT, DATE_TIME_ARGS(dt));
+    }
+}
+
+// Corrects the Clock and its Rate from an NTP Sample
+// The first sample steps the clock and sets the DS1302, later ones are slewed in
+void RealTime::applyNtp(const NtpSample &sample)
+{
+    ClockSource &clock = alarm->hal.clock;
 
-        // Save Compile Time
-        RtcDateTime compiled = RtcDateTime(__DATE__, __TIME__);
+    int64_t offset = sample.epochMicros - epochMicrosAt(sample.takenAt);
+    ntpOffsetMicros = offset;
+    ntpRoundTrip = sample.roundTrip;
+    lastNtpSync = clock.millis();
 
-        // Check if RTC has valid time
-        if (!Rtc.IsDateTimeValid())
+    // esp_timer's Rate against NTP, over the Whole Span since the Baseline Sample
+    if (!haveNtp)
+    {
+        lastNtp = sample;
+    }
+    else if (sample.takenAt - lastNtp.takenAt >= RATE_BASELINE)
+    {
+        int64_t localElapsed = sample.takenAt - lastNtp.takenAt;
+        int64_t ntpElapsed = sample.epochMicros - lastNtp.epochMicros;
+        int64_t measuredPpb = (ntpElapsed - localElapsed) * 1000000000LL / localElapsed;
+
+        if (measuredPpb > -MAX_DRIFT_PPB && measuredPpb < MAX_DRIFT_PPB)
         {
-            // RTC Doesn't have Valid Time, Update to Compile Time
+            reanchor(clock.micros()); // Rate only changes the time from here on
+            ratePpb = haveRate ? (ratePpb + (int32_t)measuredPpb) / 2 : (int32_t)measuredPpb;
+            haveRate = true;
+        }
+        lastNtp = sample;
+    }
 
-            // Common Causes:
-            //    1) first time you ran and the device wasn't running yet
-            //    2) the battery on the device is low or even missing
+    bool first = !haveNtp;
+    haveNtp = true;
+    correct(offset, first);
+    alarm->uplink.clockSynced(getEpochNow(), (long)(offset / 1000), rtcPpb);
+    LOG_INFO(LOG_CLOCK, "NTP offset %ldms, round trip %lums, rate %ldppb",
+             (long)(offset / 1000), (unsigned long)(sample.roundTrip / 1000), (long)ratePpb);
 
-            Serial.println("RTC lost confidence in the DateTime!");
-            Serial.println("Using Compile Time");
-            printDateTime(compiled);
-            Serial.println();
-            Rtc.SetDateTime(compiled);
+    if (first)
+    {
+        CivilTime dt = toCivil(getEpochNow());
+        LOG_INFO(LOG_CLOCK, "Setting Time to NTP! - " DATE_TIME_FORMAT, DATE_TIME_ARGS(dt));
+        rtcRewrite = true; // DS1302 may be hours off, set it right away
+    }
+    else
+    {
+        lastDisciplined = clock.millis() - DISCIPLINE_PERIOD; // Measure the DS1302 against the fresh time
+    }
+}
+
+// Checks the Software Clock Against the DS1302
+// Polls the DS1302 until its seconds tick over, so the comparison is accurate to one poll period instead of a whole second
+void RealTime::disciplineClock()
+{
+    ClockSource &clock = alarm->hal.clock;
+
+    if (!capturing)
+    {
+        if (rtcRewrite)
+        {
+            rewriteRtc(); // Keeps polling until the start of a second
+            return;
         }
+        if (haveEdge && clock.millis() - lastDisciplined < DISCIPLINE_PERIOD)
+        {
+            return; // Nothing to do, costs no DS1302 reads
+        }
+
+        capturing = true;
+        captureEpoch = readRtcEpoch();
+        captureReadAt = clock.micros();
+        return;
+    }
 
-        // Since we don't have wifi to set time, compare saved time to compile time
-        // Update RTC only if time is behind the compile time.
-        RtcDateTime now = Rtc.GetDateTime();
-        if (now < compiled)
+    int64_t readAt = clock.micros();
+    uint32_t rtcEpoch = readRtcEpoch();
+
+    if (rtcEpoch == captureEpoch)
+    {
+        captureReadAt = readAt; // Still the same second
+        return;
+    }
+
+    // Second ticked over somewhere between the last two reads
+    capturing = false;
+    lastDisciplined = clock.millis();
+    onRtcEdge(rtcEpoch, (captureReadAt + readAt) / 2);
+}
+
+// Learns the DS1302's Drift, or Follows it when NTP is Stale
+void RealTime::onRtcEdge(uint32_t rtcEpoch, int64_t edgeMicros)
+{
+    int64_t rtcMicros = (int64_t)rtcEpoch * 1000000;
+
+    if (isNtpFresh())
+    {
+        // Clock is on NTP time, so how far off the DS1302 is shows its drift
+        int64_t error = rtcMicros - epochMicrosAt(edgeMicros);
+        if (!haveRtcBase)
         {
-            Serial.println("RTC is older than compile time!  (Updating DateTime)");
-            Serial.println("Setting Time to Compile Time.");
-            Rtc.SetDateTime(compiled);
+            rtcBaseError = error;
+            rtcBaseAt = edgeMicros;
+            haveRtcBase = true;
         }
-        else if (now > compiled) // Don't need to update time
+        else if (edgeMicros - rtcBaseAt >= RTC_BASELINE)
         {
-            Serial.println("RTC is newer than compile time. (this is expected)");
+            int64_t measuredPpb = (error - rtcBaseError) * 1000000000LL / (edgeMicros - rtcBaseAt);
+            if (measuredPpb > -MAX_DRIFT_PPB && measuredPpb < MAX_DRIFT_PPB)
+            {
+                rtcPpb = haveRtcPpb ? (rtcPpb + (int32_t)measuredPpb) / 2 : (int32_t)measuredPpb;
+                haveRtcPpb = true;
+                saveCalibration();
+            }
+            rtcBaseError = error;
+            rtcBaseAt = edgeMicros;
         }
-        else if (now == compiled) // Don't need to update time
+
+        rtcErrorMicros = error;
+        rtcErrorTakenAt = edgeMicros;
+        rtcRewrite = error > RTC_REWRITE_MICROS || error < -RTC_REWRITE_MICROS;
+    }
+    else
+    {
+        // Network is down, the DS1302 less its learned error is the reference
+        if (haveEdge && !haveNtp)
         {
-            Serial.println("RTC is the same as compile time! (not expected but all is fine)");
+            // Rate difference over the whole interval since the last edge, only until NTP has measured it properly
+            int64_t localElapsed = edgeMicros - lastEdgeMicros;
+            int64_t rtcElapsed = (int64_t)(rtcEpoch - lastEdgeEpoch) * 1000000;
+            int64_t measuredPpb = (rtcElapsed - localElapsed) * 1000000000LL / localElapsed - rtcPpb;
+
+            if (measuredPpb > -MAX_DRIFT_PPB && measuredPpb < MAX_DRIFT_PPB)
+            {
+                // Smooth out capture jitter
+                reanchor(alarm->hal.clock.micros());
+                ratePpb = haveRate ? (ratePpb * 3 + (int32_t)measuredPpb) / 4 : (int32_t)measuredPpb;
+                haveRate = true;
+            }
         }
+
+        int64_t reference = rtcMicros - predictRtcError(edgeMicros);
+        correct(reference - epochMicrosAt(edgeMicros), !haveEdge && !haveNtp); // First edge replaces the rough boot anchor
     }
+
+    lastEdgeMicros = edgeMicros;
+    lastEdgeEpoch = rtcEpoch;
+    haveEdge = true;
 }
 
-void RealTime::runRTCLoop()
+// Sets the DS1302 if the Clock is at the Start of a Second
+// Writing restarts the DS1302's second, so it's only done in the first few milliseconds of one
+bool RealTime::rewriteRtc()
+{
+    ClockSource &clock = alarm->hal.clock;
+    int64_t now = clock.micros();
+    int64_t epochMicros = epochMicrosAt(now);
+    int64_t intoSecond = epochMicros % 1000000;
+    if (intoSecond >= RTC_WRITE_WINDOW)
+    {
+        return false;
+    }
+
+    rtcSetAt = epochMicros / 1000000;
+    clock.writeRtc(rtcSetAt);
+    rtcRewrite = false;
+    LOG_INFO(LOG_CLOCK, "Set DS1302 from NTP, it was %ldms off", (long)(predictRtcError(now) / 1000));
+
+    // Drift baseline and edge history start over from the new setting
+    rtcErrorMicros = -intoSecond;
+    rtcErrorTakenAt = now;
+    haveRtcBase = false;
+    haveEdge = false;
+    saveCalibration();
+    return true;
+}
+
+// DS1302 minus True Time, from its Learned Drift
+int64_t RealTime::predictRtcError(int64_t timerMicros)
+{
+    return rtcErrorMicros + (timerMicros - rtcErrorTakenAt) * rtcPpb / 1000000000LL;
+}
+
+void RealTime::saveCalibration()
+{
+    RtcCalibration calibration = {rtcPpb, rtcSetAt};
+    alarm->hal.storage.write(CALIBRATION_KEY, &calibration, sizeof(calibration));
+}
+
+// Synced Recently Enough to be the Reference
+bool RealTime::isNtpFresh()
+{
+    return haveNtp && alarm->hal.clock.millis() - lastNtpSync < NTP_STALE;
+}
+
+// Restarts the Software Clock from a Known Time
+void RealTime::anchorClock(int64_t epochMicros, int64_t atMicros)
+{
+    anchorEpochMicros = epochMicros;
+    anchorMicros = atMicros;
+    slewMicros = 0;
+}
+
+// Software Clock Time in Epoch Microseconds at an esp_timer Time
+int64_t RealTime::epochMicrosAt(int64_t timerMicros)
 {
-    static unsigned long timer = millis();
+    int64_t elapsed = timerMicros - anchorMicros;
+    elapsed += elapsed * ratePpb / 1000000000LL; // Run at the reference's rate
+    return anchorEpochMicros + elapsed + slewAppliedAt(timerMicros);
+}
 
-    if (millis() - timer > 1000 || timer == 0)
+// Part of slewMicros Worked in by then, so the Time Never Jumps or Runs Backwards
+int64_t RealTime::slewAppliedAt(int64_t timerMicros)
+{
+    int64_t since = timerMicros - anchorMicros;
+    if (since <= 0)
     {
-        // Print Time NOw
-        timer = millis();
-        // Serial.println("Looping Next");
-        // myDFPlayer.next();  //Play next mp3 every 3 second.
+        return 0;
+    }
 
-        Serial.print("RTC Time: ");
-        printDateTime(RealTime::getTimeNow());
-        Serial.println();
+    int64_t most = since * SLEW_PPB / 1000000000LL;
+    if (slewMicros > most)
+    {
+        return most;
+    }
+    return slewMicros < -most ? -most : slewMicros;
+}
 
-        // lcd.clear();
-        // lcd.setCursor(0, 0);
-        // lcd.printf("%02d:%02d:%02d", now.Hour(), now.Minute(), now.Second());
+// Moves the Anchor Up without Changing the Time
+void RealTime::reanchor(int64_t atMicros)
+{
+    int64_t epochMicros = epochMicrosAt(atMicros);
+    slewMicros -= slewAppliedAt(atMicros);
+    anchorEpochMicros = epochMicros;
+    anchorMicros = atMicros;
+}
+
+// Slews the Clock by offset, or Steps if it's too Big
+// Whatever is still being slewed in is added to a step
+void RealTime::correct(int64_t offset, bool step)
+{
+    reanchor(alarm->hal.clock.micros());
+    slewMicros += offset;
 
+    if (step || slewMicros > MAX_SLEW_MICROS || slewMicros < -MAX_SLEW_MICROS)
+    {
+        anchorEpochMicros += slewMicros;
+        slewMicros = 0;
+        steps++;
     }
 }
 
-// Get Current Time and Makes Sure It's Valid
-RtcDateTime RealTime::getTimeNow()
+// Reads the DS1302 and Makes Sure It's Valid
+uint32_t RealTime::readRtcEpoch()
 {
-    RtcDateTime now = Rtc.GetDateTime();
+    uint32_t epoch;
 
-    if (!now.IsValid())
+    if (!alarm->hal.clock.readRtc(epoch))
     {
         // Common Causes:
         //    1) the battery on the device is low or even missing and the power line was disconnected
-        Serial.println("RTC lost confidence in the DateTime!");
+        LOG_WARN(LOG_CLOCK, "RTC lost confidence in the DateTime!");
     }
 
-    return now;
+    return epoch;
+}
+
+// Returns the Current Epoch Seconds from the Software Clock (No DS1302 Read)
+uint32_t RealTime::getEpochNow()
+{
+    return epochMicrosAt(alarm->hal.clock.micros()) / 1000000;
 }
 
-// Prints Date Time Objects as String
-void printDateTime(const RtcDateTime &dt)
+// Software Clock Now in Epoch Microseconds
+int64_t RealTime::getEpochMicros()
 {
-    char datestring[26];
+    return epochMicrosAt(alarm->hal.clock.micros());
+}
 
-    snprintf_P(datestring,
-               countof(datestring),
-               PSTR("%02u/%02u/%04u %02u:%02u:%02u"),
-               dt.Month(),
-               dt.Day(),
-               dt.Year(),
-               dt.Hour(),
-               dt.Minute(),
-               dt.Second());
-    Serial.print(datestring);
-}
\ No newline at end of file
+// Seconds since the Last NTP Sample, -1 if None
+long RealTime::getSyncAge()
+{
+    return haveNtp ? (long)((alarm->hal.clock.millis() - lastNtpSync) / 1000) : -1;
+}
+
+// Microseconds until the Software Clock Reaches epoch, Negative once Past
+int64_t RealTime::microsUntil(uint32_t epoch)
+{
+    return (int64_t)epoch * 1000000 - epochMicrosAt(alarm->hal.clock.micros());
+}
+
+// Get Current Time from the Software Clock
+CivilTime RealTime::getTimeNow()
+{
+    return toCivil(getEpochNow());
+}
+
+// Prints NTP Offset, Rate and the DS1302's Drift
+void RealTime::printClock()
+{
+    Serial.printf("Clock: NTP offset %ldus (round trip %luus) %lds ago, rate %ldppb, slewing %ldus, %u steps\n",
+                  (long)ntpOffsetMicros,
+                  (unsigned long)ntpRoundTrip,
+                  getSyncAge(),
+                  (long)ratePpb,
+                  (long)(slewMicros - slewAppliedAt(alarm->hal.clock.micros())),
+                  steps);
+    Serial.printf("DS1302: drift %.2fppm%s, %ldms off, %s\n",
+                  rtcPpb / 1000.0,
+                  haveRtcPpb ? "" : " (not measured)",
+                  (long)(predictRtcError(alarm->hal.clock.micros()) / 1000),
+                  isNtpFresh() ? "following NTP" : "standing in for NTP");
+}
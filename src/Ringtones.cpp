@@ -0,0 +1,259 @@
+// Index of the Tracks on the Player's SD Card, Kept in Flash
+
+// Project Specific Headers
+#include "Ringtones.h"
+#include "Log.h"
+
+// Standard Libraries
+#include <string.h>
+
+const char *RINGTONE_KEY = "ringtones";
+const uint16_t RINGTONE_VERSION = 1; // Bump when RingtoneIndex Changes
+
+Ringtones::Ringtones(Storage &storage, ClockSource &clock, AudioQueue &commands)
+    : storage(storage), clock(clock), commands(commands)
+{
+    memset(tracks, 0, sizeof(tracks));
+}
+
+// FNV-1a over the Counts, Two Cards with the Same Folders and Counts Look the Same
+uint32_t Ringtones::fingerprintOf(uint16_t files, const uint8_t *tracks)
+{
+    uint32_t hash = 2166136261u;
+    uint8_t bytes[2 + RINGTONE_FOLDERS] = {(uint8_t)files, (uint8_t)(files >> 8)};
+    memcpy(bytes + 2, tracks, RINGTONE_FOLDERS);
+    for (size_t i = 0; i < sizeof(bytes); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Loads the Saved Index, Never Waits on the Player
+void Ringtones::begin()
+{
+    RingtoneIndex saved;
+    if (storage.read(RINGTONE_KEY, &saved, sizeof(saved)) == sizeof(saved) && saved.version == RINGTONE_VERSION &&
+        saved.fingerprint == fingerprintOf(saved.files, saved.tracks))
+    {
+        index = saved;
+        known = true;
+        loaded = true;
+        checkWanted = true;
+        LOG_INFO(LOG_SOUND, "Ringtones loaded for card %08lx, %u files", (unsigned long)index.fingerprint, index.files);
+        return;
+    }
+    scanWanted = true;
+}
+
+// Sends the Next Query and Saves Learned Lengths, only while free (Online and not Ringing)
+void Ringtones::update(bool free)
+{
+    unsigned long now = clock.millis();
+
+    if (step != SCAN_IDLE && now - askedAt > RINGTONE_ANSWER_TIMEOUT)
+    {
+        LOG_WARN(LOG_SOUND, "Player didn't answer the card scan, trying again in %lus", RINGTONE_RETRY / 1000);
+        scanWanted |= step != SCAN_CHECK;
+        checkWanted |= step == SCAN_CHECK;
+        step = SCAN_IDLE;
+        nextTryAt = now + RINGTONE_RETRY;
+    }
+
+    if (!free)
+    {
+        return;
+    }
+
+    if (dirty)
+    {
+        save();
+    }
+
+    if (step == SCAN_IDLE && (scanWanted || checkWanted) && (long)(now - nextTryAt) >= 0)
+    {
+        step = scanWanted ? SCAN_FILES : SCAN_CHECK;
+        scanWanted = false;
+        checkWanted = false;
+        ask();
+    }
+}
+
+// Sends the Query for the Current Step
+void Ringtones::ask()
+{
+    if (step == SCAN_FOLDERS)
+    {
+        commands.queryFolder(folder);
+    }
+    else
+    {
+        commands.queryFiles();
+    }
+    askedAt = clock.millis();
+    queries++;
+}
+
+// Card Changes and Query Answers from the Player
+void Ringtones::onEvent(AudioEvent event, int value)
+{
+    switch (event)
+    {
+    case AUDIO_CARD_INSERTED:
+        LOG_INFO(LOG_SOUND, "SD card inserted, counting its tracks");
+        scanWanted = true;
+        nextTryAt = clock.millis();
+        break;
+
+    case AUDIO_FILE_COUNT:
+        if (step == SCAN_CHECK)
+        {
+            step = SCAN_IDLE;
+            if (known && value == index.files)
+            {
+                return; // Same Card, as Far as One Query can Tell
+            }
+            LOG_INFO(LOG_SOUND, "SD card has %d files, %u were indexed, counting its tracks", value, index.files);
+            step = SCAN_FILES;
+        }
+        if (step == SCAN_FILES)
+        {
+            files = value;
+            memset(tracks, 0, sizeof(tracks));
+            folder = 1;
+            step = SCAN_FOLDERS;
+            ask();
+        }
+        break;
+
+    case AUDIO_FOLDER_COUNT:
+    case AUDIO_ERROR: // Folder isn't on the Card
+        if (step != SCAN_FOLDERS)
+        {
+            return;
+        }
+        tracks[folder - 1] = event == AUDIO_FOLDER_COUNT ? (value > 255 ? 255 : value) : 0;
+        {
+            // Stop once Every File is Accounted For
+            uint16_t counted = 0;
+            for (int i = 0; i < folder; i++)
+            {
+                counted += tracks[i];
+            }
+            if (folder < RINGTONE_FOLDERS && counted < files)
+            {
+                folder++;
+                ask();
+                return;
+            }
+        }
+        finishScan();
+        break;
+
+    default:
+        break;
+    }
+}
+
+void Ringtones::finishScan()
+{
+    step = SCAN_IDLE;
+    scans++;
+
+    uint32_t scanned = fingerprintOf(files, tracks);
+    if (known && scanned == index.fingerprint)
+    {
+        LOG_INFO(LOG_SOUND, "SD card %08lx is the one indexed", (unsigned long)scanned);
+        return; // Keeps the Learned Lengths
+    }
+
+    memset(&index, 0, sizeof(index));
+    index.version = RINGTONE_VERSION;
+    index.files = files;
+    index.fingerprint = scanned;
+    memcpy(index.tracks, tracks, sizeof(tracks));
+    known = true;
+    save();
+    LOG_INFO(LOG_SOUND, "SD card %08lx indexed, %u files", (unsigned long)scanned, files);
+}
+
+void Ringtones::save()
+{
+    dirty = false;
+    if (!storage.write(RINGTONE_KEY, &index, sizeof(index)))
+    {
+        LOG_WARN(LOG_SOUND, "Couldn't save the ringtone index");
+    }
+}
+
+// A Track Played to its End, its Length is Saved the Next Time Nothing Rings
+void Ringtones::trackFinished(uint8_t folder, uint8_t track, unsigned long ms)
+{
+    if (!known || folder < 1 || folder > RINGTONE_FOLDERS || track < 1 || track > RINGTONE_TRACKS)
+    {
+        return;
+    }
+
+    uint16_t &seconds = index.seconds[folder - 1][track - 1];
+    uint16_t measured = (ms + 500) / 1000;
+    if (measured > 0 && (measured > seconds + 1 || measured + 1 < seconds))
+    {
+        seconds = measured;
+        dirty = true;
+    }
+}
+
+// On the Card, Assumed to be until the Card has been Counted
+bool Ringtones::has(uint8_t folder, uint8_t track)
+{
+    if (!known || folder < 1 || folder > RINGTONE_FOLDERS)
+    {
+        return !known;
+    }
+    return track >= 1 && track <= index.tracks[folder - 1];
+}
+
+// Any Track on the Card, false if there's None
+bool Ringtones::firstTrack(uint8_t &folder, uint8_t &track)
+{
+    for (int i = 0; known && i < RINGTONE_FOLDERS; i++)
+    {
+        if (index.tracks[i] > 0)
+        {
+            folder = i + 1;
+            track = 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 0 if Not Known
+uint16_t Ringtones::secondsOf(uint8_t folder, uint8_t track)
+{
+    if (!known || folder < 1 || folder > RINGTONE_FOLDERS || track < 1 || track > RINGTONE_TRACKS)
+    {
+        return 0;
+    }
+    return index.seconds[folder - 1][track - 1];
+}
+
+uint8_t Ringtones::tracksIn(uint8_t folder)
+{
+    return known && folder >= 1 && folder <= RINGTONE_FOLDERS ? index.tracks[folder - 1] : 0;
+}
+
+// Prints the Card, Where the Index Came from and Queries Sent
+void Ringtones::printStats()
+{
+    char folders[RINGTONE_FOLDERS * 4 + 1] = "";
+    for (int i = 0; known && i < RINGTONE_FOLDERS; i++)
+    {
+        char entry[8];
+        snprintf(entry, sizeof(entry), " %u", index.tracks[i]);
+        strncat(folders, entry, sizeof(folders) - strlen(folders) - 1);
+    }
+    Serial.printf("Ringtones: card %08lx, %u files, tracks per folder%s, %s, %u queries, %u scans\n",
+                  (unsigned long)fingerprint(), known ? index.files : 0, known ? folders : " unknown",
+                  loaded ? "loaded from flash" : "not saved at boot", queries, scans);
+}
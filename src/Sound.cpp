@@ -3,150 +3,246 @@
 // Project Specific Headers
 #include "Alarm.h"
 #include "Sound.h"
+#include "Log.h"
 
-// DF Setup
-#include "DFRobotDFPlayerMini.h"
-#define FPSerial Serial1
-DFRobotDFPlayerMini myDFPlayer;
-void printDetail(uint8_t type, int value);
+// Standard Libraries
+#include <stdio.h>
+#include <string.h>
+
+// Ring Sequences, Indexed by an Alarm's "sound" Field
+static const RingSequence RING_SEQUENCES[] = {
+    {"standard", 1, 1, 8, 20, 40, 2, 1}, // 0 Ramps Up over 20s, Goes Loud if Still Ringing after 40s
+    {"gentle", 1, 2, 2, 45, 0, 0, 0},    // 1 Quiet Start, Slow Ramp, Never Escalates
+    {"loud", 2, 1, 0, 0, 0, 0, 0},       // 2 Set Volume Right Away
+};
+static const uint8_t RING_SEQUENCE_COUNT = sizeof(RING_SEQUENCES) / sizeof(RING_SEQUENCES[0]);
 
 // Sound Constructor
-Sound::Sound(Alarm& alarm) : alarm(&alarm) {}
+Sound::Sound(Alarm& alarm) : alarm(&alarm), commands(alarm.hal.audio, alarm.hal.clock), ringtones(alarm.hal.storage, alarm.hal.clock, commands) {}
 
-Sound *instance = nullptr; // Will be set to the sound instance when it is created. 
-void inc1(){
-    instance->incrementVolume(1);
+// Setup Sound
+void Sound::initSound(){
+    // Volume Buttons (1 when Pushed, 0 when not Pushed)
+    alarm->buttons.watch(volumeIncreasePin, [this](const ButtonEvent &event) { onVolumeButton(event, 1); });
+    alarm->buttons.watch(volumeDecreasePin, [this](const ButtonEvent &event) { onVolumeButton(event, -1); });
+
+    // Player comes up in the background, the volume waits in the queue until it does
+    sendVolume(volume);
+    ringtones.begin(); // From flash, the card is only counted again if it changed
+    alarm->hal.audio.begin();
 }
 
-void dec1(){
-    instance->incrementVolume(-1);
+// Returns if the DFPlayer is Online
+bool Sound::isReady(){
+    return alarm->hal.audio.isOnline();
 }
 
-// Setup Sound
-void Sound::initSound(){
-    FPSerial.begin(9600, SERIAL_8N1, /*tx =*/26, /*rx =*/27);
-    Serial.println();
-    Serial.println(F("DFRobot DFPlayer Mini Demo"));
-    Serial.println(F("Initializing DFPlayer ... (May take 3~5 seconds)"));
+// Steps the Volume on a Press, and a Bigger Jump when Held
+void Sound::onVolumeButton(const ButtonEvent &event, int direction){
+    if(event.type == BUTTON_SHORT){
+        return; // Already stepped on the press
+    }
+
+    if(ramping){
+        // Take Over from the Ramp at the Level it Reached
+        ramping = false;
+        volume = playerVolume;
+    }
+    incrementVolume(event.type == BUTTON_LONG ? direction * 4 : direction);
+    alarm->uplink.volumeChanged(volume); // Held buttons step many times, only the last level goes up
+    recentlyChangedVolume = true;
+    volumeChangedAt = alarm->hal.clock.millis();
+    alarm->scheduler.runSoon(alarm->volumeTask, volumeChangedAt); // Show new volume right away
+}
+
+// Handles Updating Sound (Turning it off or on)
+void Sound::updateSound(){
+    // Turn off Recently Changed Volume 1.5s after the buttons are let go
+    bool held = alarm->buttons.isDown(volumeIncreasePin) || alarm->buttons.isDown(volumeDecreasePin);
+    if(held){
+        volumeChangedAt = alarm->hal.clock.millis();
+    }
+    else if(recentlyChangedVolume && alarm->hal.clock.millis() - volumeChangedAt > 1500){
+        recentlyChangedVolume = false;
+    }
 
+    updateRing(alarm->hal.clock.millis());
+    ringtones.update(isReady() && !ringing);
+    commands.update(); // Late Acks and the Next Queued Command, Player prints its own details
+}
 
+// Steps the Ramp, Escalates and Replays Finished Tracks
+// Everything is checked against deadlines here, nothing waits on the player
+void Sound::updateRing(unsigned long now){
+    int value;
+    AudioEvent event;
+    while((event = commands.poll(value)) != AUDIO_NONE){
+        // The player sends finished twice, and a stop can still be answered by one from the last track
+        if(event == AUDIO_PLAY_FINISHED && trackPlaying && now - trackStartedAt >= MIN_TRACK_MS){
+            trackPlaying = false;
+            ringtones.trackFinished(playingFolder, playingTrack, now - trackStartedAt);
+        }
+        ringtones.onEvent(event, value);
+    }
 
-    while (!myDFPlayer.begin(FPSerial, /*isACK = */true, /*doReset = */true)) {  //Use serial to communicate with mp3.
-        Serial.println(F("Unable to begin:"));
-        Serial.println(F("1.Please recheck the connection!"));
-        Serial.println(F("2.Please insert the SD card!"));
-        delay(1000);
+    if(!ringing){
+        return;
     }
-    Serial.println(F("DFPlayer Mini online."));
 
-    myDFPlayer.setTimeOut(500); //Set serial communictaion time out 500ms
+    unsigned long elapsed = now - ringStartedAt;
 
-    //----Set volume----
-    myDFPlayer.volume(volume);  //Set volume value (0~30).
+    if(sequence->escalateAfter > 0 && !escalated && elapsed >= (unsigned long)sequence->escalateAfter * 1000){
+        LOG_INFO(LOG_SOUND, "Still Ringing, Escalating");
+        escalated = true;
+        ramping = false;
+        if(ringtones.has(sequence->escalateFolder, sequence->escalateTrack)){
+            playTrack(sequence->escalateFolder, sequence->escalateTrack);
+        }
+        sendVolume(maxVolume);
+    }
+
+    if(ramping && now >= nextRampAt){
+        unsigned long rampMillis = (unsigned long)sequence->rampSeconds * 1000;
+        int start = sequence->startVolume < volume ? sequence->startVolume : volume;
+        int level = volume;
+        if(elapsed < rampMillis){
+            level = start + (int)((long)(volume - start) * (long)elapsed / (long)rampMillis);
+        }
+        else{
+            ramping = false;
+        }
 
-    //----Read information----
-    Serial.println("Read Information");
-    Serial.println(myDFPlayer.readState()); //read mp3 state
-    Serial.println(myDFPlayer.readVolume()); //read current volume
-    Serial.println(myDFPlayer.readEQ()); //read EQ setting
-    Serial.println(myDFPlayer.readFileCounts()); //read all file counts in SD card
-    Serial.println(myDFPlayer.readCurrentFileNumber()); //read current play file number
-    Serial.println(myDFPlayer.readFileCountsInFolder(3)); //read file counts in folder SD:/03
+        if(level != playerVolume){
+            sendVolume(level); // Merges with a level still waiting on the player
+        }
+        nextRampAt = now + RAMP_STEP_MS;
+    }
 
+    // Tracks play once, start it again until the alarm is stopped
+    if(!trackPlaying){
+        playTrack(playingFolder, playingTrack);
+    }
+}
 
-    // Serial.println("Playing Ringtone");
-    // myDFPlayer.loop(1);  //Loop the first mp3
+void Sound::playTrack(uint8_t folder, uint8_t track){
+    commands.playFolder(folder, track);
+    playingFolder = folder;
+    playingTrack = track;
+    trackPlaying = true;
+    trackStartedAt = alarm->hal.clock.millis();
+}
 
-    pinMode(volumeIncreasePin, INPUT_PULLDOWN); // Volume Increase Button (1 when Pushed, 0 when not Pushed)
-    pinMode(volumeDecreasePin, INPUT_PULLDOWN); // Volume Decrease Button (1 when Pushed, 0 when not Pushed)
-    
-    instance = this; // Update global instance
+void Sound::sendVolume(int level){
+    commands.volume(level);
+    playerVolume = level;
+}
 
-    // attachInterrupt(digitalPinToInterrupt(volumeIncreasePin), inc1, RISING);
-    // attachInterrupt(digitalPinToInterrupt(volumeDecreasePin), dec1, RISING);
+// Unknown Sounds Ring the Standard Sequence
+const RingSequence *Sound::sequenceOf(uint8_t sound){
+    if(sound >= TRACK_SOUND){
+        trackSequence = RING_SEQUENCES[0];
+        trackSequence.folder = ((sound >> 4) & 0x07) + 1;
+        trackSequence.track = (sound & 0x0F) + 1;
+        trackSequence.escalateAfter = 0; // The Track Picked Keeps Playing
+        return &trackSequence;
+    }
+    return &RING_SEQUENCES[sound < RING_SEQUENCE_COUNT ? sound : 0];
 }
 
-// Handles Updating Sound (Turning it off or on)
-void Sound::updateSound(){
-    // MAY NEED TO UPDATE SOUND WHILE PLAYING. 
-    // WILL NOT HANDLE TURNING ITSELF ON AND OFF UNLESS NECCESSARY
-    static unsigned long timer = millis();
-    static short volumeIncreaseState = digitalRead(volumeIncreasePin);
-    static short volumeDecreaseState = digitalRead(volumeDecreasePin);
-    static unsigned long debounce =  millis(); // Temporarily prohibits increasing volume during short period. 
-    int curIncState = digitalRead(volumeIncreasePin);
-    int curDecState = digitalRead(volumeDecreasePin);
-
-    if(millis() - debounce > 500) { // If at least .5 second since press button reaction
-        if(curIncState == HIGH){
-            debounce = millis(); // Update Debounce
-            recentlyChangedVolume = true;
-            incrementVolume(1);
-        }
-        if(curDecState == HIGH){
-            recentlyChangedVolume = true;
-            debounce = millis();
-            incrementVolume(-1);
-        }
-        // Turn off Recently Changed Volume after 1.5s
-        if(recentlyChangedVolume && millis() - debounce > 1500 && curDecState == LOW && curIncState == LOW){
-            recentlyChangedVolume = false;
+// Sound Number of a Sequence or Track Name, -1 if there's No Such Sound
+// Tracks are checked against the card index, so a name can't pick a track the card doesn't have
+int Sound::findSound(const char *name){
+    for(int i = 0; i < RING_SEQUENCE_COUNT; i++){
+        if(strcmp(name, RING_SEQUENCES[i].name) == 0){
+            return i;
         }
     }
 
+    unsigned folder, track;
+    char end;
+    if(sscanf(name, "%u/%u%c", &folder, &track, &end) == 2 && folder >= 1 && folder <= RINGTONE_FOLDERS &&
+       track >= 1 && track <= RINGTONE_TRACKS && ringtones.has(folder, track)){
+        return TRACK_SOUND | (folder - 1) << 4 | (track - 1);
+    }
+    return -1;
+}
 
-    // if(millis() - timer > 500) {
-    //     timer = millis();
-        
-    //     if(curState == HIGH){
-    //         Serial.printf("Volume Up State: HIGH ");
-    //     } else {
-    //         Serial.printf("Volume Up State: LOW ");
-    //     }
-    //     if(curState2 == HIGH){
-    //         Serial.printf("Volume Down State: HIGH\n");
-    //     } else {
-    //         Serial.printf("Volume Down State: LOW\n");
-    //     }
+// Sequences are Sounds 0 up to this
+int Sound::sequenceCount(){
+    return RING_SEQUENCE_COUNT;
+}
 
+// Sequence or Track Name of a Sound Number
+void Sound::nameOf(uint8_t sound, char *name, size_t size){
+    if(sound >= TRACK_SOUND){
+        snprintf(name, size, "%02u/%03u", ((sound >> 4) & 0x07) + 1, (sound & 0x0F) + 1);
+        return;
+    }
+    snprintf(name, size, "%s", RING_SEQUENCES[sound < RING_SEQUENCE_COUNT ? sound : 0].name);
+}
 
-    //     // incrementVolume(1);
-    // }
+// Starts Alarm Ringing with a Ring Sequence
+// Unknown sequences ring the standard one, and a track the card doesn't have is swapped for one it does
+void Sound::startRinging(uint8_t sound){
+    if(!isReady()){
+        LOG_ERROR(LOG_SOUND, "DFPlayer offline, can't play ringtone");
+        return;
+    }
 
+    sequence = sequenceOf(sound);
+    LOG_INFO(LOG_SOUND, "Playing Ring Sequence %s", sequence->name);
 
-    if (myDFPlayer.available()) {
-        printDetail(myDFPlayer.readType(), myDFPlayer.read()); //Print the detail message from DFPlayer to handle different errors and states.
+    uint8_t folder = sequence->folder;
+    uint8_t track = sequence->track;
+    if(!ringtones.has(folder, track) && ringtones.firstTrack(folder, track)){
+        LOG_WARN(LOG_SOUND, "Card has no %02u/%03u, ringing %02u/%03u", sequence->folder, sequence->track, folder, track);
     }
-} 
-// Starts Alarm Ringing
-void Sound::startRinging(){
-    // NEEDS TO BE UPDATED WITH RING SOUND LOGIC
 
-    Serial.println("Playing Ringtone");
-    myDFPlayer.loop(1);  //Loop the first mp3
+    unsigned long now = alarm->hal.clock.millis();
+    ringStartedAt = now;
+    nextRampAt = now + RAMP_STEP_MS;
+    escalated = false;
+    ramping = sequence->rampSeconds > 0 && sequence->startVolume < volume;
+
+    sendVolume(ramping ? sequence->startVolume : volume); // Queued ahead of the track
+    playTrack(folder, track);
+    ringing = true;
 }
 // Stops Alarm Ringing
 void Sound::stopRinging(){
-    Serial.println("Stopping Ringtone");
-    myDFPlayer.stop();
+    LOG_INFO(LOG_SOUND, "Stopping Ringtone");
+    commands.stop(); // Goes out right away, ahead of anything queued
+    ringing = false;
+    ramping = false;
+    trackPlaying = false;
+
+    // Ramps and escalation leave the player away from the set volume
+    if(playerVolume != volume){
+        sendVolume(volume);
+    }
 } 
 // Returns if the Alarm is ringing or not
 bool Sound::checkIsRinging(){
-    return false; // TODO
+    return ringing;
 } 
+// Returns if no Player Command is Waiting on the Player
+bool Sound::isAudioIdle(){
+    return commands.isIdle();
+}
 
 // Set Volume to Amount
 void Sound::setVolume(int amount){
     volume = amount;
-    myDFPlayer.volume(amount);
+    sendVolume(amount); // Merges with any volume still queued, applied once the player comes online
 } 
 // Change Volume by Amount
 int Sound::incrementVolume(int amount){
-    Serial.printf("Changing Volume at %d by %d\n", volume,  amount);
+    LOG_DEBUG(LOG_SOUND, "Changing Volume at %d by %d", volume, amount);
     int newVolume = volume + amount;
-    if(newVolume <= 30 && 0 <= newVolume) {
-        volume = newVolume;
-        setVolume(volume);
+    if(newVolume > maxVolume) newVolume = maxVolume; // Big steps stop at the ends
+    if(newVolume < 0) newVolume = 0;
+    if(newVolume != volume) {
+        setVolume(newVolume);
     }
     return volume;
 }
@@ -155,65 +251,3 @@ int Sound::incrementVolume(int amount){
 int Sound::getVolume(){
     return volume;
 }
-
-void printDetail(uint8_t type, int value){
-  switch (type) {
-    case TimeOut:
-      Serial.println(F("Time Out!"));
-      break;
-    case WrongStack:
-      Serial.println(F("Stack Wrong!"));
-      break;
-    case DFPlayerCardInserted:
-      Serial.println(F("Card Inserted!"));
-      break;
-    case DFPlayerCardRemoved:
-      Serial.println(F("Card Removed!"));
-      break;
-    case DFPlayerCardOnline:
-      Serial.println(F("Card Online!"));
-      break;
-    case DFPlayerUSBInserted:
-      Serial.println("USB Inserted!");
-      break;
-    case DFPlayerUSBRemoved:
-      Serial.println("USB Removed!");
-      break;
-    case DFPlayerPlayFinished:
-      Serial.print(F("Number:"));
-      Serial.print(value);
-      Serial.println(F(" Play Finished!"));
-      break;
-    case DFPlayerError:
-      Serial.print(F("DFPlayerError:"));
-      switch (value) {
-        case Busy:
-          Serial.println(F("Card not found"));
-          break;
-        case Sleeping:
-          Serial.println(F("Sleeping"));
-          break;
-        case SerialWrongStack:
-          Serial.println(F("Get Wrong Stack"));
-          break;
-        case CheckSumNotMatch:
-          Serial.println(F("Check Sum Not Match"));
-          break;
-        case FileIndexOut:
-          Serial.println(F("File Index Out of Bound"));
-          break;
-        case FileMismatch:
-          Serial.println(F("Cannot Find File"));
-          break;
-        case Advertise:
-          Serial.println(F("In Advertise"));
-          break;
-        default:
-          break;
-      }
-      break;
-    default:
-      break;
-  }
-
-}
\ No newline at end of file
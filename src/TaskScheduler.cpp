@@ -0,0 +1,184 @@
+// Runs Each Alarm Component only when it is Due
+
+// Project Specific Headers
+#include "TaskScheduler.h"
+
+// External Library Headers
+#include <Arduino.h>
+
+TaskScheduler::TaskScheduler(ClockSource &clock) : clock(clock)
+{
+}
+
+// Registers a Task, Returns its Id
+int TaskScheduler::addTask(const char *name, uint32_t period, uint8_t priority, std::function<void()> run, TaskKind kind)
+{
+    ScheduledTask task;
+    task.name = name;
+    task.period = period;
+    task.priority = priority;
+    task.kind = kind;
+    task.run = run;
+    task.nextDue = clock.millis();
+
+    int taskId = tasks.size();
+    tasks.push_back(task);
+
+    // Run Behind Every Task of the Same or Higher Priority
+    size_t index = 0;
+    while (index < order.size() && tasks[order[index]].priority <= priority)
+    {
+        index++;
+    }
+    order.insert(order.begin() + index, taskId);
+
+    return taskId;
+}
+
+// Pulls a Task's Next Run Forward to millis() Time at
+void TaskScheduler::runSoon(int taskId, unsigned long at)
+{
+    ScheduledTask &task = tasks[taskId];
+    if ((long)(at - task.nextDue) < 0)
+    {
+        task.nextDue = at;
+    }
+}
+
+// Runs Every Task that is Due, Most Important First
+void TaskScheduler::runDue()
+{
+    uint32_t perMicro = clock.cyclesPerMicro();
+    uint32_t loopStart = clock.cycles();
+    bool ranAny = false;
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        ScheduledTask &task = tasks[order[i]];
+        unsigned long now = clock.millis();
+
+        if ((long)(now - task.nextDue) < 0)
+        {
+            continue; // Not Due Yet
+        }
+
+        // Started more than a whole period late
+        if (now - task.nextDue > task.period)
+        {
+            task.missedDeadlines++;
+        }
+
+        uint32_t start = clock.cycles();
+        task.run();
+        task.runTime.record((clock.cycles() - start) / perMicro);
+        ranAny = true;
+
+        // Keep a Steady Period, but Don't Try to Catch Up on Missed Runs
+        task.nextDue += task.period;
+        if ((long)(clock.millis() - task.nextDue) >= 0)
+        {
+            task.nextDue = clock.millis() + task.period;
+        }
+    }
+
+    if (ranAny)
+    {
+        loopTime.record((clock.cycles() - loopStart) / perMicro);
+    }
+}
+
+// Milliseconds until the Earliest (Timed) Task is Due
+unsigned long TaskScheduler::untilNextDeadline(bool timedOnly)
+{
+    unsigned long now = clock.millis();
+    unsigned long wait = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        if (timedOnly && tasks[i].kind != TASK_TIMED)
+        {
+            continue;
+        }
+
+        long left = (long)(tasks[i].nextDue - now);
+        if (left <= 0)
+        {
+            return 0;
+        }
+        if ((unsigned long)left < wait)
+        {
+            wait = left;
+        }
+    }
+    return wait;
+}
+
+// Waits until the Earliest Task is Due
+void TaskScheduler::idle()
+{
+    unsigned long wait = untilNextDeadline();
+    if (wait > 0)
+    {
+        clock.delay(wait); // Lets other FreeRTOS tasks (WiFi, Firebase stream) run meanwhile
+    }
+}
+
+// Polled Tasks Run Right Away after a Sleep, without Counting as Late
+void TaskScheduler::wokeUp()
+{
+    unsigned long now = clock.millis();
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        if (tasks[i].kind == TASK_POLLED && (long)(now - tasks[i].nextDue) > 0)
+        {
+            tasks[i].nextDue = now;
+        }
+    }
+}
+
+// Prints Run Time Percentiles of Every Task and the Whole Loop
+void TaskScheduler::printStats()
+{
+    Serial.println("Task           Runs  p50(us)  p99(us)  Max(us)  Missed");
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        ScheduledTask &task = tasks[order[i]];
+        Histogram &h = task.runTime;
+        Serial.printf("%-10s %8u %8u %8u %8u %7u\n", task.name, h.getCount(), h.percentile(50), h.percentile(99), h.getMax(), task.missedDeadlines);
+    }
+    Serial.printf("%-10s %8u %8u %8u %8u\n", "loop", loopTime.getCount(), loopTime.percentile(50), loopTime.percentile(99), loopTime.getMax());
+}
+
+void TaskScheduler::resetStats()
+{
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        tasks[i].runTime.reset();
+        tasks[i].missedDeadlines = 0;
+    }
+    loopTime.reset();
+}
+
+// Same Statistics as a JSON Object for Uploading
+// {"alarm":{"runs":120,"p50":3,"p99":11,"max":40,"missed":0}, ..., "loop":{...}}
+String TaskScheduler::statsJson()
+{
+    char entry[96];
+    String json = "{";
+
+    for (size_t i = 0; i <= tasks.size(); i++)
+    {
+        bool isLoop = i == tasks.size();
+        const Histogram &h = isLoop ? loopTime : tasks[i].runTime;
+
+        snprintf(entry, sizeof(entry), "%s\"%s\":{\"runs\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u,\"missed\":%u}",
+                 i == 0 ? "" : ",",
+                 isLoop ? "loop" : tasks[i].name,
+                 (unsigned)h.getCount(), (unsigned)h.percentile(50), (unsigned)h.percentile(99), (unsigned)h.getMax(),
+                 isLoop ? 0u : (unsigned)tasks[i].missedDeadlines);
+        json += entry;
+    }
+
+    json += "}";
+    return json;
+}
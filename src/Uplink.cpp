@@ -0,0 +1,145 @@
+// Collects Device State for Firebase and Sends it in Batches
+
+// Project Specific Headers
+#include "Uplink.h"
+#include "Log.h"
+
+// Standard Libraries
+#include <stdio.h>
+#include <string.h>
+
+static const char *stopReasonName(StopReason reason)
+{
+    switch (reason)
+    {
+    case STOP_DISMISSED: return "\"dismissed\"";
+    case STOP_TIMED_OUT: return "\"timedOut\"";
+    case STOP_REPLACED: return "\"replaced\"";
+    default: return "\"removed\"";
+    }
+}
+
+Uplink::Uplink(CloudSource &cloud, ClockSource &clock) : cloud(cloud), clock(clock) {}
+
+// Replaces a Waiting Value for the Same Path
+void Uplink::set(const char *path, const char *value)
+{
+    events++;
+    if (onChange)
+    {
+        onChange(path, value);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(entries[i].path, path) == 0)
+        {
+            snprintf(entries[i].value, sizeof(entries[i].value), "%s", value);
+            coalesced++;
+            return;
+        }
+    }
+
+    if (count >= UPLINK_SLOTS)
+    {
+        dropped++;
+        return;
+    }
+
+    snprintf(entries[count].path, sizeof(entries[count].path), "%s", path);
+    snprintf(entries[count].value, sizeof(entries[count].value), "%s", value);
+    count++;
+}
+
+void Uplink::setNumber(const char *path, long value)
+{
+    char text[UPLINK_VALUE_SIZE];
+    snprintf(text, sizeof(text), "%ld", value);
+    set(path, text);
+}
+
+// Alarms Added on the Clock, like the Boot Alarm, have No Key and No Place in the Database
+void Uplink::setAlarm(const char *key, const char *field, const char *value)
+{
+    if (key[0] == '\0')
+    {
+        return;
+    }
+
+    char path[UPLINK_PATH_SIZE];
+    snprintf(path, sizeof(path), "alarms/%s/%s", key, field);
+    set(path, value);
+}
+
+void Uplink::alarmFired(const char *key, uint32_t at)
+{
+    char text[UPLINK_VALUE_SIZE];
+    snprintf(text, sizeof(text), "%lu", (unsigned long)at);
+    setAlarm(key, "firedAt", text);
+    setAlarm(key, "state", "\"ringing\"");
+}
+
+void Uplink::alarmStopped(const char *key, StopReason reason, uint32_t at, uint32_t rangFor)
+{
+    char text[UPLINK_VALUE_SIZE];
+    snprintf(text, sizeof(text), "%lu", (unsigned long)at);
+    setAlarm(key, "stoppedAt", text);
+    snprintf(text, sizeof(text), "%lu", (unsigned long)rangFor);
+    setAlarm(key, "rangFor", text);
+    setAlarm(key, "state", stopReasonName(reason));
+}
+
+void Uplink::volumeChanged(int volume)
+{
+    setNumber("volume", volume);
+}
+
+void Uplink::clockSynced(uint32_t at, long offsetMillis, long rtcDriftPpb)
+{
+    setNumber("clock/syncedAt", (long)at);
+    setNumber("clock/offsetMs", offsetMillis);
+    setNumber("clock/rtcDriftPpb", rtcDriftPpb);
+}
+
+// Sends the Table if the Period is Up or it's Filling, Never Waits on the Network
+// Paths are relative to the device node, so the update's stream echo never looks like an alarm change
+void Uplink::flush()
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (clock.millis() - lastFlush < UPLINK_PERIOD && count < UPLINK_FLUSH_AT)
+    {
+        return;
+    }
+
+    String json = "{";
+    for (int i = 0; i < count; i++)
+    {
+        json += i > 0 ? ",\"" : "\"";
+        json += entries[i].path;
+        json += "\":";
+        json += entries[i].value;
+    }
+    json += "}";
+
+    // Last batch is still being sent or retried, keep merging into the table until it's done
+    if (!cloud.pushUpdate(json))
+    {
+        busy++;
+        return;
+    }
+
+    LOG_DEBUG(LOG_NETWORK, "Uplink batch of %d values", count);
+    count = 0;
+    batches++;
+    lastFlush = clock.millis();
+}
+
+// Prints Events, Merges, Drops and Batches Sent
+void Uplink::printStats()
+{
+    Serial.printf("Uplink: %u events, %u merged, %u dropped, %u batches, %u put off, %d waiting\n",
+                  events, coalesced, dropped, batches, busy, count);
+}
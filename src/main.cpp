@@ -4,11 +4,24 @@
 
 
 #include "Alarm.h"
+#include "HalEsp32.h"
+#include "Network.h"
 
 
 // Library Objects / Variables
 
-Alarm alarmObject;
+Esp32Clock clockSource;
+Esp32Lcd lcdDevice;
+Esp32Audio audioPlayer;
+Esp32Buttons buttonInput;
+Esp32Storage storage;
+Network network;
+Esp32Lan lan;
+Esp32Peers peers;
+
+Hal hal = {clockSource, lcdDevice, audioPlayer, buttonInput, storage, network, lan, peers};
+
+Alarm alarmObject(hal);
 
 ////////////////////////
 // Firebase Functions //
@@ -0,0 +1,95 @@
+// Minimal Arduino Core for the Native Build
+// Only the parts the alarm logic uses: String, Serial and F()
+
+#ifndef Arduino_H_
+#define Arduino_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define F(string_literal) (string_literal)
+#define PSTR(string_literal) (string_literal)
+
+// Arduino String on top of std::string
+class String {
+    private:
+        std::string value;
+
+    public:
+        String() {}
+        String(const char *text) : value(text ? text : "") {}
+        String(const std::string &text) : value(text) {}
+        String(char c) : value(1, c) {}
+        String(int number) : value(std::to_string(number)) {}
+        String(unsigned int number) : value(std::to_string(number)) {}
+        String(long number) : value(std::to_string(number)) {}
+        String(unsigned long number) : value(std::to_string(number)) {}
+
+        const char *c_str() const { return value.c_str(); }
+        unsigned int length() const { return value.length(); }
+        long toInt() const { return strtol(value.c_str(), nullptr, 10); }
+
+        bool startsWith(const String &prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+        int indexOf(char c, unsigned int from = 0) const {
+            size_t found = value.find(c, from);
+            return found == std::string::npos ? -1 : (int)found;
+        }
+        String substring(unsigned int from) const { return from < value.size() ? String(value.substr(from)) : String(); }
+        String substring(unsigned int from, unsigned int to) const {
+            return from < to && from < value.size() ? String(value.substr(from, to - from)) : String();
+        }
+
+        char operator[](unsigned int index) const { return index < value.size() ? value[index] : 0; }
+        bool operator==(const String &other) const { return value == other.value; }
+        bool operator!=(const String &other) const { return value != other.value; }
+        bool operator==(const char *other) const { return value == other; }
+        bool operator!=(const char *other) const { return value != other; }
+        String &operator+=(const String &other) { value += other.value; return *this; }
+        friend String operator+(const String &a, const String &b) { return String(a.value + b.value); }
+};
+
+// Serial Port Printing to stdout
+class HardwareSerial {
+    public:
+        bool enabled = true; // Simulations Turn this off to Time the Alarm Logic Alone
+
+        void begin(unsigned long) {}
+        int available() { return 0; } // No Keyboard Input in Simulations
+        int read() { return -1; }
+        int availableForWrite() { return 4096; } // stdout Never Backs Up
+        size_t write(const uint8_t *data, size_t length) { return enabled ? fwrite(data, 1, length, stdout) : length; }
+
+        int printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+            if (!enabled) {
+                return 0;
+            }
+            va_list args;
+            va_start(args, format);
+            int written = vprintf(format, args);
+            va_end(args);
+            return written;
+        }
+
+        void print(const char *text) { if (enabled) fputs(text, stdout); }
+        void print(const String &text) { print(text.c_str()); }
+        void print(char c) { if (enabled) putchar(c); }
+        void print(int number) { printf("%d", number); }
+        void print(unsigned int number) { printf("%u", number); }
+        void print(long number) { printf("%ld", number); }
+        void print(unsigned long number) { printf("%lu", number); }
+
+        void println() { print("\n"); }
+        template <typename T>
+        void println(const T &value) { print(value); println(); }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,499 @@
+// In-Memory Hardware for the Native Build
+
+// Project Specific Headers
+#include "FakeHal.h"
+#include "AlarmParser.h"
+
+// Standard Libraries
+#include <chrono>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+HardwareSerial Serial;
+
+/// Clock
+
+unsigned long FakeClock::millis()
+{
+    return nowMicros / 1000;
+}
+
+int64_t FakeClock::micros()
+{
+    return nowMicros;
+}
+
+void FakeClock::delay(unsigned long ms)
+{
+    nowMicros += (int64_t)ms * 1000;
+}
+
+// Ends Early at wakeAt
+void FakeClock::lightSleep(unsigned long ms)
+{
+    int64_t until = nowMicros + (int64_t)ms * 1000;
+    nowMicros = wakeAt > nowMicros && wakeAt < until ? wakeAt : until;
+}
+
+uint32_t FakeClock::cycles()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Moves Time Forward without Anyone Waiting
+void FakeClock::advance(int64_t micros)
+{
+    nowMicros += micros;
+}
+
+// Returns false if the RTC was Never Set
+bool FakeClock::readRtc(uint32_t &epoch)
+{
+    rtcReads++;
+
+    int64_t elapsed = nowMicros - rtcSetMicros;
+    elapsed += elapsed * rtcDriftPpm / 1000000;
+    epoch = rtcEpoch + elapsed / 1000000;
+    return rtcValid;
+}
+
+void FakeClock::writeRtc(uint32_t epoch)
+{
+    rtcEpoch = epoch;
+    rtcSetMicros = nowMicros;
+    rtcValid = true;
+}
+
+/// LCD
+
+void FakeLcd::clear()
+{
+    for (int r = 0; r < 2; r++)
+    {
+        for (int c = 0; c < 16; c++)
+        {
+            screen[r][c] = ' ';
+        }
+    }
+    col = 0;
+    row = 0;
+}
+
+void FakeLcd::setCursor(uint8_t col, uint8_t row)
+{
+    this->col = col;
+    this->row = row;
+}
+
+void FakeLcd::write(char c)
+{
+    writes++;
+    if (row < 2 && col < 16)
+    {
+        screen[row][col] = c;
+    }
+    col++;
+}
+
+/// Audio
+
+// Acts on it Right Away and Acks
+void FakeAudio::send(AudioCommand command, uint16_t argument)
+{
+    switch (command)
+    {
+    case AUDIO_VOLUME:
+        currentVolume = argument;
+        volumeCommands++;
+        break;
+    case AUDIO_PLAY_FOLDER:
+        if ((argument >> 8) > folderTracks.size() || (argument & 0xFF) > folderTracks[(argument >> 8) - 1])
+        {
+            missingTracks++;
+            raise(AUDIO_ERROR, 6); // Cannot Find File, Nothing Plays
+            return;
+        }
+        // Fall Through
+    case AUDIO_LOOP:
+        playing = argument;
+        looping = command == AUDIO_LOOP;
+        startedAt = clock.millis();
+        if (stopped)
+        {
+            plays++;
+            ringStartedAt = clock.micros();
+        }
+        tracks++;
+        stopped = false;
+        break;
+    case AUDIO_STOP:
+        if (!stopped)
+        {
+            stoppedAt = clock.micros();
+        }
+        playing = 0;
+        stopped = true;
+        break;
+    case AUDIO_QUERY_FILES:
+    case AUDIO_QUERY_FOLDER:
+    {
+        queries++;
+        int files = 0;
+        for (int tracks : folderTracks)
+        {
+            files += tracks;
+        }
+        if (command == AUDIO_QUERY_FILES)
+        {
+            raise(AUDIO_FILE_COUNT, files);
+        }
+        else if (argument >= 1 && argument <= folderTracks.size() && folderTracks[argument - 1] > 0)
+        {
+            raise(AUDIO_FOLDER_COUNT, folderTracks[argument - 1]);
+        }
+        else
+        {
+            raise(AUDIO_ERROR, 6); // File Not Found
+        }
+        return; // Answered Instead of Acked
+    }
+    }
+    if (playing != 0 && currentVolume > loudest)
+    {
+        loudest = currentVolume;
+    }
+    raise(AUDIO_ACK);
+}
+
+// Swaps the Card and Says So, like the Real One
+void FakeAudio::insertCard(const std::vector<int> &tracks)
+{
+    folderTracks = tracks;
+    raise(AUDIO_CARD_INSERTED);
+}
+
+// Goes Silent and Forgets Waiting Events, like Losing Power
+void FakeAudio::powerOff()
+{
+    if (!stopped)
+    {
+        stoppedAt = clock.micros();
+    }
+    events.clear();
+    playing = 0;
+    stopped = true;
+}
+
+// Returns the Oldest Raised Event, AUDIO_NONE if Nothing
+AudioEvent FakeAudio::poll(int &value)
+{
+    if (playing != 0 && !looping && clock.millis() - startedAt >= trackMillis)
+    {
+        playing = 0;
+        raise(AUDIO_PLAY_FINISHED);
+        raise(AUDIO_PLAY_FINISHED);
+    }
+
+    if (events.empty())
+    {
+        return AUDIO_NONE;
+    }
+
+    std::pair<AudioEvent, int> event = events.front();
+    events.erase(events.begin());
+    value = event.second;
+    return event.first;
+}
+
+/// Buttons
+
+bool FakeButtons::takeEdge(ButtonEdge &edge)
+{
+    if (edges.empty())
+    {
+        return false;
+    }
+
+    edge = edges.front();
+    edges.erase(edges.begin());
+    return true;
+}
+
+void FakeButtons::press(int pin)
+{
+    pressed.insert(pin);
+    edges.push_back({pin, true, clock.micros()});
+}
+
+void FakeButtons::release(int pin)
+{
+    pressed.erase(pin);
+    edges.push_back({pin, false, clock.micros()});
+}
+
+/// Storage
+
+// Returns Bytes Read, 0 if Missing
+size_t FakeStorage::read(const char *key, void *data, size_t maxSize)
+{
+    auto found = records.find(key);
+    if (found == records.end() || found->second.size() > maxSize)
+    {
+        return 0;
+    }
+
+    memcpy(data, found->second.data(), found->second.size());
+    return found->second.size();
+}
+
+bool FakeStorage::write(const char *key, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    records[key].assign(bytes, bytes + size);
+    writes++;
+    return true;
+}
+
+/// Cloud
+
+// Replaces Every Alarm, Like a Full Fetch from Firebase, Returns false if the Payload isn't Valid
+bool FakeCloud::publishAlarmJson(const String &payload)
+{
+    AlarmSet &set = alarmSets.writeSlot();
+    if (!parseAlarmList(payload.c_str(), payload.length(), set))
+    {
+        return false;
+    }
+
+    set.seq = nextSeq++;
+    alarmSets.publish();
+    return true;
+}
+
+// Changes One Alarm, Like a Stream Event, Returns false if the Queue is Full
+bool FakeCloud::publishPatch(AlarmPatch patch)
+{
+    patch.seq = nextSeq++;
+    return patches.push(patch);
+}
+
+// Always Sent Right Away
+bool FakeCloud::pushUpdate(const String &json)
+{
+    lastUpdate = json;
+    updates++;
+    updateBytes += json.length();
+    return true;
+}
+
+// Always Written Right Away
+bool FakeCloud::pushAlarmEdit(const AlarmEdit &edit)
+{
+    if (strcmp(edit.json, "null") == 0)
+    {
+        written.erase(edit.key);
+    }
+    else
+    {
+        written[edit.key] = edit.json;
+    }
+    return true;
+}
+
+// Alarm List Holding what the LAN Wrote Back, as a Full Fetch would Return it
+String FakeCloud::writtenJson()
+{
+    String json = "{";
+    for (auto &alarm : written)
+    {
+        json += json.length() > 1 ? ",\"" : "\"";
+        json += alarm.first.c_str();
+        json += "\":";
+        json += alarm.second.c_str();
+    }
+    json += "}";
+    return json;
+}
+
+// Like a Reply from the NTP Server
+void FakeCloud::publishNtp(const NtpSample &sample)
+{
+    ntpSamples.writeSlot() = sample;
+    ntpSamples.publish();
+}
+
+/// LAN
+
+LoopbackLan::LoopbackLan()
+{
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        sockets[i] = -1;
+    }
+}
+
+LoopbackLan::~LoopbackLan()
+{
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        close(i);
+    }
+    if (listener >= 0)
+    {
+        ::close(listener);
+    }
+}
+
+void LoopbackLan::begin(uint16_t)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 8) != 0 ||
+        getsockname(listener, (sockaddr *)&address, &length) != 0)
+    {
+        printf("Loopback listener failed: %s\n", strerror(errno));
+        return;
+    }
+
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    boundPort = ntohs(address.sin_port);
+}
+
+int LoopbackLan::accept()
+{
+    if (listener < 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < LAN_CONNECTIONS; i++)
+    {
+        if (sockets[i] < 0)
+        {
+            int socket = ::accept(listener, nullptr, nullptr);
+            if (socket < 0)
+            {
+                return -1;
+            }
+
+            int on = 1;
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            fcntl(socket, F_SETFL, O_NONBLOCK);
+            sockets[i] = socket;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Bytes Read, 0 if None Yet, -1 once Closed
+int LoopbackLan::read(int connection, char *buffer, size_t size)
+{
+    ssize_t got = recv(sockets[connection], buffer, size, 0);
+    if (got < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    return got == 0 ? -1 : (int)got;
+}
+
+bool LoopbackLan::write(int connection, const char *data, size_t size)
+{
+    return send(sockets[connection], data, size, MSG_NOSIGNAL) == (ssize_t)size;
+}
+
+void LoopbackLan::close(int connection)
+{
+    if (sockets[connection] >= 0)
+    {
+        ::close(sockets[connection]);
+        sockets[connection] = -1;
+    }
+}
+
+/// Peers
+
+LoopbackPeers::LoopbackPeers(int index, int groupSize, uint16_t basePort) : index(index), groupSize(groupSize), basePort(basePort) {}
+
+LoopbackPeers::~LoopbackPeers()
+{
+    if (socket >= 0)
+    {
+        ::close(socket);
+    }
+}
+
+void LoopbackPeers::begin()
+{
+    if (groupSize < 2)
+    {
+        return;
+    }
+
+    socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(basePort + index);
+    if (socket < 0 || bind(socket, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        printf("Loopback peer %d failed: %s\n", index, strerror(errno));
+        return;
+    }
+    fcntl(socket, F_SETFL, O_NONBLOCK);
+}
+
+// To Every Other Clock
+bool LoopbackPeers::send(const void *data, size_t size)
+{
+    if (socket < 0)
+    {
+        return false;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int member = 0; member < groupSize; member++)
+    {
+        if (member != index)
+        {
+            address.sin_port = htons(basePort + member);
+            sendto(socket, data, size, 0, (sockaddr *)&address, sizeof(address));
+        }
+    }
+    sent++;
+    return true;
+}
+
+// Next Datagram, 0 if None
+size_t LoopbackPeers::receive(void *data, size_t maxSize)
+{
+    if (socket < 0)
+    {
+        return 0;
+    }
+
+    ssize_t got = recv(socket, data, maxSize, 0);
+    if (got <= 0)
+    {
+        return 0;
+    }
+    received++;
+    return got;
+}
@@ -0,0 +1,211 @@
+// In-Memory Hardware for the Native Build
+// Time only moves when something waits, so a whole simulated day runs in well under a second
+
+#ifndef FakeHal_H_
+#define FakeHal_H_
+
+// Standard Libraries
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Project Specific Headers
+#include "Hal.h"
+#include "Handoff.h"
+
+// Virtual Time and a DS1302 that Runs off it
+class FakeClock : public ClockSource {
+    private:
+        int64_t nowMicros = 0;
+
+        // RTC Time is rtcEpoch at rtcSetMicros, Running rtcDriftPpm Fast
+        uint32_t rtcEpoch = 0;
+        int64_t rtcSetMicros = 0;
+        bool rtcValid = false;
+
+    public:
+        int32_t rtcDriftPpm = 0;
+        uint32_t rtcReads = 0;
+        int64_t wakeAt = INT64_MAX; // Micros of the Next Scripted Button Press or Cloud Change, which Wake a Light Sleep
+
+        unsigned long millis() override;
+        int64_t micros() override;
+        void delay(unsigned long ms) override;
+        void lightSleep(unsigned long ms) override; // Ends Early at wakeAt
+        uint32_t cycles() override; // Real Nanoseconds, so Stats Show the Desktop Cost of the Logic
+        uint32_t cyclesPerMicro() override { return 1000; }
+
+        void beginRtc() override {}
+        bool readRtc(uint32_t &epoch) override;
+        void writeRtc(uint32_t epoch) override;
+
+        void advance(int64_t micros); // Moves Time Forward without Anyone Waiting
+};
+
+// 16x2 Screen Kept in Memory
+class FakeLcd : public LcdDevice {
+    private:
+        uint8_t col = 0;
+        uint8_t row = 0;
+
+    public:
+        char screen[2][17] = {}; // Null Terminated Rows
+        uint32_t writes = 0;
+
+        void begin() override {}
+        void clear() override;
+        void setCursor(uint8_t col, uint8_t row) override;
+        void write(char c) override;
+};
+
+// Player that Records what it was Asked to Play
+// Tracks end after trackMillis and answer with two finished events, like the real one
+// Queries are answered from folderTracks, the card in the player
+class FakeAudio : public AudioPlayer {
+    private:
+        ClockSource &clock;
+        std::vector<std::pair<AudioEvent, int>> events;
+        unsigned long startedAt = 0;
+        bool looping = false;
+
+    public:
+        FakeAudio(ClockSource &clock) : clock(clock) {}
+
+        bool online = true;
+        unsigned long trackMillis = 3000;
+        uint8_t currentVolume = 0;
+        uint8_t loudest = 0; // Highest Volume Set while Playing
+        int playing = 0; // Track Playing, 0 when Silent
+        bool stopped = true; // Nothing has Played Since the Last Stop
+        uint32_t plays = 0; // Tracks Started after a Stop, One per Ring
+        uint32_t tracks = 0; // Every Track Started
+        uint32_t volumeCommands = 0;
+        uint32_t queries = 0;
+        uint32_t missingTracks = 0; // Asked to Play a Track the Card Doesn't Have
+        std::vector<int> folderTracks = {2, 1}; // Tracks in /01, /02, ..., what the Ring Sequences Play
+        int64_t ringStartedAt = 0; // Micros the Last Ring Started (First Track after a Stop)
+        int64_t stoppedAt = 0;     // Micros of the Last Stop
+
+        void begin() override {}
+        bool isOnline() override { return online; }
+
+        void send(AudioCommand command, uint16_t argument) override; // Acts on it Right Away and Acks
+
+        AudioEvent poll(int &value) override;
+        void raise(AudioEvent event, int value = 0) { events.push_back({event, value}); } // Queues an Event for poll()
+        void insertCard(const std::vector<int> &tracks); // Swaps the Card and Says So, like the Real One
+        void powerOff(); // Goes Silent and Forgets Waiting Events, like Losing Power
+};
+
+// Buttons Pressed and Released by the Simulation
+class FakeButtons : public ButtonInput {
+    private:
+        ClockSource &clock; // Timestamps Edges
+        std::set<int> pressed;
+        std::vector<ButtonEdge> edges;
+
+    public:
+        FakeButtons(ClockSource &clock) : clock(clock) {}
+
+        void setup(int) override {}
+        bool isPressed(int pin) override { return pressed.count(pin) != 0; }
+        bool takeEdge(ButtonEdge &edge) override;
+
+        void press(int pin);
+        void release(int pin);
+};
+
+// Flash Kept in Memory, Survives Restarting the Alarm in a Simulation
+class FakeStorage : public Storage {
+    private:
+        std::map<std::string, std::vector<uint8_t>> records;
+
+    public:
+        uint32_t writes = 0;
+
+        size_t read(const char *key, void *data, size_t maxSize) override;
+        bool write(const char *key, const void *data, size_t size) override;
+};
+
+// Cloud the Simulation Publishes Alarms and NTP Time to
+class FakeCloud : public CloudSource {
+    private:
+        bool online = false;
+        SpscQueue<AlarmPatch, 16> patches;
+        TripleBuffer<AlarmSet> alarmSets;
+        uint32_t nextSeq = 1;
+
+        TripleBuffer<NtpSample> ntpSamples;
+
+    public:
+        String lastStats; // Last Loop Stats the Alarm Pushed
+        String lastUpdate; // Last Device Update the Alarm Pushed
+        uint32_t updates = 0;
+        size_t updateBytes = 0;
+        uint32_t refetches = 0; // Asked for the Whole List Again, the Simulation Decides what to Send
+        std::map<std::string, std::string> written; // Alarms the LAN Wrote Back, by Key, Deleted Ones are Removed
+
+        void start() override { online = true; }
+        bool isOnline() override { return online; }
+        bool isBusy() override { return false; }
+
+        bool takeAlarmSet(AlarmSet &set) override { return alarmSets.take(set); }
+        bool takePatch(AlarmPatch &patch) override { return patches.pop(patch); }
+        bool takeNtpSample(NtpSample &sample) override { return ntpSamples.take(sample); }
+        void requestRefetch() override { refetches++; }
+        void pushStats(const String &json) override { lastStats = json; }
+        bool pushUpdate(const String &json) override; // Always Sent Right Away
+        bool pushAlarmEdit(const AlarmEdit &edit) override; // Always Written Right Away
+
+        // Simulation Side
+        bool publishAlarmJson(const String &payload); // Alarm List as Firebase Sends it, Returns false if it isn't Valid
+        String writtenJson(); // Alarm List Holding what the LAN Wrote Back, as a Full Fetch would Return it
+        bool publishPatch(AlarmPatch patch);
+        void publishNtp(const NtpSample &sample); // Like a Reply from the NTP Server
+};
+
+// Real TCP Socket on 127.0.0.1, so the Local API can be Load Tested from Another Thread
+// Stays Closed unless the simulation turns it on, the OS picks the port since the device's needs root
+class LoopbackLan : public LanServer {
+    private:
+        int listener = -1;
+        int sockets[LAN_CONNECTIONS];
+
+    public:
+        bool enabled = false;
+        uint16_t boundPort = 0; // Port Clients Connect to, once begin() Ran
+
+        LoopbackLan();
+        ~LoopbackLan();
+
+        void begin(uint16_t port) override;
+        int accept() override;
+        int read(int connection, char *buffer, size_t size) override;
+        bool write(int connection, const char *data, size_t size) override;
+        void close(int connection) override;
+};
+
+// Multicast Group Played by UDP Sockets on 127.0.0.1, One Port per Clock from basePort Up
+// Sending goes to every other member's port, so several simulated clocks can run in one process
+class LoopbackPeers : public PeerLink {
+    private:
+        int socket = -1;
+        int index;
+        int groupSize;
+        uint16_t basePort;
+
+    public:
+        LoopbackPeers(int index = 0, int groupSize = 0, uint16_t basePort = 0); // No Group, a Clock Alone
+        ~LoopbackPeers();
+
+        uint32_t sent = 0;
+        uint32_t received = 0;
+
+        void begin() override;
+        uint32_t localId() override { return index + 1; }
+        bool send(const void *data, size_t size) override;
+        size_t receive(void *data, size_t maxSize) override;
+};
+
+#endif
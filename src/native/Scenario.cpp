@@ -0,0 +1,480 @@
+// Scripted Runs of the Alarm Logic Against Fake Hardware
+
+// Project Specific Headers
+#include "Scenario.h"
+#include "Alarm.h"
+#include "AlarmParser.h"
+#include "FakeHal.h"
+
+// Standard Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+const int STOP_PIN = 12;          // Same Pins as Alarm and Sound
+const int VOLUME_UP_PIN = 14;
+const int VOLUME_DOWN_PIN = 13;
+const long PRESS_MILLIS = 200;    // How Long a Scripted Press Holds the Button
+const int64_t ON_TIME = 1000000;  // Microseconds an Alarm may be Off from its Expected Time and Still Count
+const int64_t LATE_WINDOW = 60000000; // Latest a Ring still Matches an Expectation, the Alarm's maxRingTime
+const unsigned long NTP_EVERY = 60UL * 60 * 1000;
+const uint32_t NTP_ROUND_TRIP = 20000;
+
+// One Time an Alarm Rang, in True Time
+struct Firing {
+    std::string id;
+    int64_t startedAt;
+    int64_t stoppedAt; // -1 while it's Still Ringing
+    bool matched;
+};
+
+// Next Word, Moves at Past it
+static bool nextWord(const char *&at, std::string &word)
+{
+    while (*at == ' ' || *at == '\t')
+    {
+        at++;
+    }
+    const char *begin = at;
+    while (*at != '\0' && *at != ' ' && *at != '\t')
+    {
+        at++;
+    }
+    word.assign(begin, at - begin);
+    return !word.empty();
+}
+
+// Rest of the Line, without Leading Space
+static std::string restOf(const char *at)
+{
+    while (*at == ' ' || *at == '\t')
+    {
+        at++;
+    }
+    return at;
+}
+
+// "HH:MM[:SS]" as Seconds into the Day
+static bool readTimeOfDay(const std::string &text, uint32_t &second)
+{
+    int hour, minute, sec = 0;
+    if (sscanf(text.c_str(), "%d:%d:%d", &hour, &minute, &sec) < 2 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || sec < 0 || sec > 59)
+    {
+        return false;
+    }
+    second = hour * 3600 + minute * 60 + sec;
+    return true;
+}
+
+static int buttonPin(const std::string &name)
+{
+    if (name == "stop") return STOP_PIN;
+    if (name == "up") return VOLUME_UP_PIN;
+    if (name == "down") return VOLUME_DOWN_PIN;
+    return atoi(name.c_str());
+}
+
+// Reads One "at" Line's Action, its Time is Filled in by the Caller
+static bool readAction(const char *at, ScenarioEvent &event)
+{
+    std::string word;
+    if (!nextWord(at, event.action))
+    {
+        return false;
+    }
+
+    if (event.action == "alarms")
+    {
+        event.text = restOf(at);
+        return !event.text.empty();
+    }
+    if (event.action == "put" || event.action == "patch" || event.action == "remove")
+    {
+        if (!nextWord(at, event.key))
+        {
+            return false;
+        }
+        event.text = restOf(at);
+        return event.action == "remove" || !event.text.empty();
+    }
+    if (event.action == "press")
+    {
+        if (!nextWord(at, event.key))
+        {
+            return false;
+        }
+        event.value = nextWord(at, word) ? atol(word.c_str()) : PRESS_MILLIS;
+        return true;
+    }
+    if (event.action == "stall" || event.action == "power" || event.action == "jump" || event.action == "rtc")
+    {
+        if (!nextWord(at, word))
+        {
+            return false;
+        }
+        event.value = atol(word.c_str());
+        return true;
+    }
+    if (event.action == "ntp")
+    {
+        return nextWord(at, event.key) && (event.key == "on" || event.key == "off");
+    }
+    if (event.action == "card")
+    {
+        return nextWord(at, event.key);
+    }
+    return false;
+}
+
+// Reads a Scenario File, Prints the Line and Returns false on a Mistake
+bool loadScenario(const char *path, uint32_t defaultStart, Scenario &scenario)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        printf("Can't open %s\n", path);
+        return false;
+    }
+
+    scenario = Scenario();
+    scenario.start = defaultStart;
+
+    // Times are Kept Relative to the Start Date until it's Known
+    char line[4096];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != nullptr)
+    {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *comment = line[0] == '#' ? line : strstr(line, " #");
+        if (comment != nullptr)
+        {
+            *comment = '\0';
+        }
+
+        const char *at = line;
+        std::string command, word, day, time;
+        if (!nextWord(at, command))
+        {
+            continue; // Blank
+        }
+
+        uint32_t second = 0;
+        if (command == "start")
+        {
+            int year, month, date;
+            ok = nextWord(at, word) && sscanf(word.c_str(), "%d-%d-%d", &year, &month, &date) == 3;
+            ok = ok && (!nextWord(at, time) || readTimeOfDay(time, second));
+            scenario.start = toEpoch(year, month, date, 0, 0, 0) + second;
+        }
+        else if (command == "run")
+        {
+            ok = nextWord(at, word) && atoi(word.c_str()) > 0;
+            scenario.days = atoi(word.c_str());
+        }
+        else if (command == "at")
+        {
+            ScenarioEvent event;
+            ok = nextWord(at, day) && nextWord(at, time) && readTimeOfDay(time, second) && readAction(at, event);
+            event.at = atoi(day.c_str()) * SECONDS_PER_DAY + second;
+            scenario.events.push_back(event);
+        }
+        else if (command == "expect")
+        {
+            int first = 0, last = 0;
+            std::string id;
+            ok = nextWord(at, day) && nextWord(at, time) && readTimeOfDay(time, second) && nextWord(at, id);
+            int parts = sscanf(day.c_str(), "%d-%d", &first, &last);
+            last = parts == 2 ? last : first;
+            int mask = nextWord(at, word) ? atoi(word.c_str()) : EVERY_DAY;
+
+            uint32_t startDay = scenario.start / SECONDS_PER_DAY; // Weekdays Need the Start Date, so it Must Come First
+            for (int d = first; ok && d <= last; d++)
+            {
+                if (mask & (1 << ((startDay + d + 4) % 7)))
+                {
+                    ScenarioExpectation expectation;
+                    expectation.at = d * SECONDS_PER_DAY + second;
+                    expectation.id = id;
+                    scenario.expectations.push_back(expectation);
+                }
+            }
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            printf("%s:%d: can't read \"%s\"\n", path, lineNumber, line);
+        }
+    }
+    fclose(file);
+
+    // Days Count from Midnight of the Start Date
+    uint32_t midnight = scenario.start - scenario.start % SECONDS_PER_DAY;
+    for (ScenarioEvent &event : scenario.events)
+    {
+        event.at += midnight;
+    }
+    for (ScenarioExpectation &expectation : scenario.expectations)
+    {
+        expectation.at += midnight;
+    }
+
+    std::stable_sort(scenario.events.begin(), scenario.events.end(),
+                     [](const ScenarioEvent &a, const ScenarioEvent &b) { return a.at < b.at; });
+    std::stable_sort(scenario.expectations.begin(), scenario.expectations.end(),
+                     [](const ScenarioExpectation &a, const ScenarioExpectation &b) { return a.at < b.at; });
+    return ok;
+}
+
+// "d<day> HH:MM:SS.mmm" Counted from the Start Date
+static void formatTime(char *out, size_t size, uint32_t midnight, int64_t micros)
+{
+    uint32_t epoch = micros / 1000000;
+    CivilTime civil = toCivil(epoch);
+    snprintf(out, size, "d%-2u %02d:%02d:%02d.%03d", (unsigned)((epoch - midnight) / SECONDS_PER_DAY),
+             civil.hour, civil.minute, civil.second, (int)(micros / 1000 % 1000));
+}
+
+// Runs it and Prints Every Alarm that Rang against the Expectations
+int runScenario(const Scenario &scenario, bool sleep)
+{
+    FakeClock clock;
+    FakeLcd lcd;
+    FakeAudio audio(clock);
+    FakeButtons buttons(clock);
+    FakeStorage storage;
+    FakeCloud cloud;
+    LoopbackLan lan;
+    LoopbackPeers peers;
+    Hal hal = {clock, lcd, audio, buttons, storage, cloud, lan, peers};
+
+    clock.writeRtc(scenario.start);
+    Alarm *alarm = new Alarm(hal);
+    alarm->initAll();
+    alarm->power->setSleep(sleep);
+
+    // True Time is the Fake Timer since Power On, Plus Scripted Jumps
+    int64_t startMicros = (int64_t)scenario.start * 1000000;
+    int64_t trueOffset = 0;
+    int64_t endAt = startMicros + (int64_t)scenario.days * SECONDS_PER_DAY * 1000000;
+    auto trueNow = [&]() { return startMicros + clock.micros() + trueOffset; };
+
+    size_t nextEvent = 0;
+    bool ntpOn = true;
+    unsigned long nextNtpAt = 0;
+    std::vector<std::pair<int, int64_t>> releases; // Pin and When it's Let Go
+    std::vector<Firing> firings;
+    bool ringing = false;
+    uint32_t lastPlays = audio.plays;
+    uint64_t loops = 0;
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    while (trueNow() < endAt)
+    {
+        // Scripted Actions that are Due
+        while (nextEvent < scenario.events.size() && (int64_t)scenario.events[nextEvent].at * 1000000 <= trueNow())
+        {
+            const ScenarioEvent &event = scenario.events[nextEvent++];
+            if (event.action == "alarms")
+            {
+                if (!cloud.publishAlarmJson(String(event.text.c_str())))
+                {
+                    printf("Scenario alarm list didn't parse\n");
+                }
+            }
+            else if (event.action == "put" || event.action == "patch" || event.action == "remove")
+            {
+                AlarmPatch patch;
+                copyField(patch.key, sizeof(patch.key), event.key.c_str());
+                patch.type = event.action == "remove" ? AlarmPatch::REMOVE : event.action == "put" ? AlarmPatch::REPLACE : AlarmPatch::UPSERT;
+                if (patch.type != AlarmPatch::REMOVE && !parseAlarm(event.text.c_str(), event.text.length(), patch))
+                {
+                    printf("Scenario patch for %s didn't parse\n", event.key.c_str());
+                    continue;
+                }
+                cloud.publishPatch(patch);
+            }
+            else if (event.action == "press")
+            {
+                int pin = buttonPin(event.key);
+                buttons.press(pin);
+                releases.push_back({pin, clock.micros() + (int64_t)event.value * 1000});
+            }
+            else if (event.action == "stall")
+            {
+                clock.advance((int64_t)event.value * 1000);
+            }
+            else if (event.action == "power")
+            {
+                delete alarm;
+                audio.powerOff();
+                for (auto &release : releases)
+                {
+                    buttons.release(release.first);
+                }
+                releases.clear();
+                clock.advance((int64_t)event.value * 1000);
+
+                alarm = new Alarm(hal); // Starts from what the DS1302 and flash kept
+                alarm->initAll();
+                alarm->power->setSleep(sleep);
+            }
+            else if (event.action == "jump")
+            {
+                trueOffset += (int64_t)event.value * 1000000;
+                nextNtpAt = clock.millis(); // Answers with the new time right away
+            }
+            else if (event.action == "rtc")
+            {
+                uint32_t rtcNow;
+                clock.readRtc(rtcNow);
+                clock.writeRtc(rtcNow + event.value);
+            }
+            else if (event.action == "ntp")
+            {
+                ntpOn = event.key == "on";
+                nextNtpAt = clock.millis();
+            }
+            else if (event.action == "card")
+            {
+                std::vector<int> tracks;
+                const char *count = event.key.c_str();
+                while (*count != '\0')
+                {
+                    tracks.push_back(atoi(count));
+                    count += strcspn(count, ",");
+                    count += *count == ',' ? 1 : 0;
+                }
+                audio.insertCard(tracks);
+            }
+        }
+
+        for (size_t i = 0; i < releases.size();)
+        {
+            if (clock.micros() >= releases[i].second)
+            {
+                buttons.release(releases[i].first);
+                releases.erase(releases.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        if (ntpOn && clock.millis() >= nextNtpAt)
+        {
+            NtpSample sample;
+            sample.takenAt = clock.micros();
+            sample.epochMicros = trueNow();
+            sample.roundTrip = NTP_ROUND_TRIP;
+            cloud.publishNtp(sample);
+            nextNtpAt = clock.millis() + NTP_EVERY;
+        }
+
+        // Next action or button release wakes a light sleep, like a GPIO or Wi-Fi wake
+        clock.wakeAt = INT64_MAX;
+        if (nextEvent < scenario.events.size())
+        {
+            clock.wakeAt = (int64_t)scenario.events[nextEvent].at * 1000000 - startMicros - trueOffset;
+        }
+        for (auto &release : releases)
+        {
+            clock.wakeAt = release.second < clock.wakeAt ? release.second : clock.wakeAt;
+        }
+
+        alarm->updateAll();
+        loops++;
+
+        // Rings as the Player Saw Them
+        if (audio.plays != lastPlays)
+        {
+            lastPlays = audio.plays;
+            const AlarmItem *alarmItem = alarm->getRingingAlarm();
+            std::string id = alarmItem == nullptr ? "?" : alarmItem->id[0] == '\0' ? "(local)" : alarmItem->id;
+            firings.push_back({id, startMicros + audio.ringStartedAt + trueOffset, -1, false});
+            ringing = true;
+        }
+        if (ringing && audio.stopped)
+        {
+            firings.back().stoppedAt = startMicros + audio.stoppedAt + trueOffset;
+            ringing = false;
+        }
+    }
+
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+    bool verbose = Serial.enabled;
+    Serial.enabled = true;
+    alarm->sound->ringtones.printStats();
+    Serial.enabled = verbose;
+    printf("Tracks missing from the card: %u\n", audio.missingTracks);
+    printf("Refetches asked for: %u\n", cloud.refetches);
+    delete alarm;
+
+    // Every Expectation against the First Ring of that Alarm Near it
+    uint32_t midnight = scenario.start - scenario.start % SECONDS_PER_DAY;
+    int onTime = 0, late = 0, missed = 0, unexpected = 0;
+    char expected[32], fired[32];
+
+    printf("Expected          Alarm             Fired               Late(ms)  Rang(s)  Result\n");
+    for (const ScenarioExpectation &expectation : scenario.expectations)
+    {
+        int64_t due = (int64_t)expectation.at * 1000000;
+        Firing *match = nullptr;
+        for (Firing &firing : firings)
+        {
+            if (!firing.matched && firing.id == expectation.id &&
+                firing.startedAt >= due - ON_TIME && firing.startedAt < due + LATE_WINDOW)
+            {
+                match = &firing;
+                break;
+            }
+        }
+
+        formatTime(expected, sizeof(expected), midnight, due);
+        if (match == nullptr)
+        {
+            printf("%s  %-16s  %-18s  %8s  %7s  MISSED\n", expected, expectation.id.c_str(), "-", "-", "-");
+            missed++;
+            continue;
+        }
+
+        match->matched = true;
+        int64_t lateBy = match->startedAt - due;
+        bool ok = lateBy <= ON_TIME;
+        onTime += ok ? 1 : 0;
+        late += ok ? 0 : 1;
+
+        formatTime(fired, sizeof(fired), midnight, match->startedAt);
+        long rang = match->stoppedAt < 0 ? -1 : (long)((match->stoppedAt - match->startedAt) / 1000000);
+        printf("%s  %-16s  %s  %8ld  %7ld  %s\n", expected, expectation.id.c_str(), fired, (long)(lateBy / 1000), rang, ok ? "ok" : "LATE");
+    }
+
+    for (const Firing &firing : firings)
+    {
+        if (!firing.matched)
+        {
+            formatTime(fired, sizeof(fired), midnight, firing.startedAt);
+            long rang = firing.stoppedAt < 0 ? -1 : (long)((firing.stoppedAt - firing.startedAt) / 1000000);
+            printf("%-16s  %-16s  %s  %8s  %7ld  UNEXPECTED\n", "-", firing.id.c_str(), fired, "-", rang);
+            unexpected++;
+        }
+    }
+
+    double simulatedSeconds = (double)scenario.days * SECONDS_PER_DAY;
+    printf("%zu expected: %d on time, %d late, %d missed, %d unexpected\n",
+           scenario.expectations.size(), onTime, late, missed, unexpected);
+    printf("Simulated %u day(s) in %.1f ms: %llu loop iterations, %.0f iterations/s, %.0fx real time\n",
+           scenario.days, wallMs, (unsigned long long)loops, loops / (wallMs / 1000), simulatedSeconds * 1000 / wallMs);
+
+    return late + missed + unexpected == 0 ? 0 : 1;
+}
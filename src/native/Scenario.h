@@ -0,0 +1,59 @@
+// Scripted Runs of the Alarm Logic Against Fake Hardware
+// A scenario file sets the start, scripts what happens and when, and lists when alarms should ring.
+// One command per line, # starts a comment, days count from the start date:
+//
+//   start 2026-10-18 [HH:MM[:SS]]       DS1302 time at power on (default: midnight after the build)
+//   run <days>                           How long to simulate
+//   at <day> <HH:MM[:SS]> <action>       Does the action once true time gets there:
+//       alarms <json>                    Firebase sends the whole alarm list
+//       put <key> <json>                 Firebase sends one whole alarm, fields it leaves out go back to defaults
+//       patch <key> <json>               Firebase changes only the fields sent, of an alarm the clock should have
+//       remove <key>                     Firebase deletes one alarm
+//       press <stop|up|down|pin> [ms]    Holds a button down (default 200ms)
+//       stall <ms>                       The loop doesn't run for a while
+//       power <ms>                       Power is cut for a while, the DS1302 and flash keep going
+//       jump <seconds>                   True time jumps, NTP answers with it right away
+//       rtc <seconds>                    The DS1302 alone jumps
+//       ntp <on|off>                     NTP stops or starts answering (hourly, on by default)
+//       card <tracks>[,<tracks>...]      A different SD card goes in, with that many tracks in /01, /02, ...
+//   expect <day>[-<day>] <HH:MM[:SS]> <id> [weekday mask]
+//                                        Alarm id should start ringing then on each of those days
+
+#ifndef Scenario_H_
+#define Scenario_H_
+
+// Standard Libraries
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// One Scripted Action, Applied once True Time Reaches at
+struct ScenarioEvent {
+    uint32_t at = 0; // True Epoch Seconds
+    std::string action;
+    std::string key;  // Alarm Key or Button
+    std::string text; // JSON
+    long value = 0;   // Milliseconds or Seconds, Depending on the Action
+};
+
+// One Time an Alarm Should Start Ringing
+struct ScenarioExpectation {
+    uint32_t at = 0;
+    std::string id;
+};
+
+struct Scenario {
+    uint32_t start = 0; // DS1302 and True Time at Power On
+    uint32_t days = 1;
+    std::vector<ScenarioEvent> events; // Sorted by at
+    std::vector<ScenarioExpectation> expectations; // Sorted by at
+};
+
+// Reads a Scenario File, Prints the Line and Returns false on a Mistake
+bool loadScenario(const char *path, uint32_t defaultStart, Scenario &scenario);
+
+// Runs it and Prints Every Alarm that Rang against the Expectations
+// Returns 0 if every expectation was met and nothing else rang
+int runScenario(const Scenario &scenario, bool sleep);
+
+#endif
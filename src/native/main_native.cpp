@@ -0,0 +1,912 @@
+// Runs the Alarm Logic on the Desktop Against Fake Hardware
+// Usage: program [alarms] [days] [-v] [-s] [-d]
+// Simulates the given number of days with that many daily alarms and reports
+// how many fired and how much real time the main loop cost.
+// -v prints the alarm's serial output, -s light sleeps between deadlines and fails if that makes an alarm late.
+// NTP answers hourly, and the run fails if the software clock is ever more than a second off once synced.
+// -d makes the DS1302 run 40ppm fast and takes NTP away after the first day, so the clock holds over on the learned drift.
+// Usage: program parse
+// Times the alarm list parser on 10, 100 and 1000 alarm payloads and counts its heap use.
+// Usage: program scenario <file> [-v] [-a]
+// Plays a scripted scenario (see Scenario.h) and compares when alarms rang with when they should have.
+// Light sleeps between deadlines so a month takes seconds, -a stays awake and polls like the default run.
+// Usage: program lan [requests] [clients]
+// Load tests the LAN API over a loopback socket: clients send alarm edits and state reads on keep-alive
+// connections while an event socket counts pushes. The loop runs paced to real time, so round trips include
+// its polling. Then alarms kept as a Firebase array are read, edited and deleted by index, and everything
+// written back is synced down again. Fails if a request fails, an edit isn't armed or is lost in that sync,
+// or the p99 round trip is over 100ms.
+// Usage: program house [clocks] [hours] [-n | -m]
+// Runs several clocks in one process, talking over UDP on 127.0.0.1, with shared alarms every 20 minutes.
+// Their clocks are off in different ways (NTP errors, one on its DS1302 alone 2s behind). Some rings are
+// dismissed on one clock and the rest time out. Reports how far apart the clocks started and stopped each ring,
+// and fails if any clock missed a ring or the skew was over 50ms. -n runs them without the house sync to compare.
+// -m gives clock 1 a list where every third alarm keeps its key but rings 10 minutes later, and fails if
+// clock 1 rings any alarm at a time its own list doesn't have.
+
+// Standard Libraries
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <chrono>
+#include <new>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// Project Specific Headers
+#include "Alarm.h"
+#include "AlarmParser.h"
+#include "FakeHal.h"
+#include "Log.h"
+#include "Scenario.h"
+
+const int STOP_PIN = 12;               // Same Pin as Alarm's Stop Button
+const unsigned long PRESS_AFTER = 5000; // Milliseconds of Ringing before the Stop Button is Pressed
+const uint32_t MAX_LATE_MS = 20;        // Latest an Alarm may Start, the Loop's Polling Period when Awake
+const unsigned long NTP_EVERY = 60UL * 60 * 1000; // Same Period as the Network Task
+const uint32_t NTP_ROUND_TRIP = 20000;
+const int32_t DRIFTING_RTC_PPM = 40;
+const int64_t MAX_CLOCK_ERROR = 1000000; // Microseconds the Software Clock may be Off once Synced
+
+// Heap Use Seen through new/delete, for the Parser Benchmark
+size_t heapAllocations = 0;
+size_t heapLive = 0;
+size_t heapPeak = 0;
+
+void *operator new(size_t size)
+{
+    void *block = malloc(size ? size : 1);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    heapAllocations++;
+    heapLive += malloc_usable_size(block);
+    heapPeak = heapLive > heapPeak ? heapLive : heapPeak;
+    return block;
+}
+
+void operator delete(void *block) noexcept
+{
+    if (block != nullptr)
+    {
+        heapLive -= malloc_usable_size(block);
+        free(block);
+    }
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    operator delete(block);
+}
+
+// Alarm List the Way Firebase Sends it, with Daily Alarms Spread Evenly over the Day
+String alarmListJson(int alarmCount)
+{
+    String json = "[";
+    char entry[96];
+    for (int i = 0; i < alarmCount; i++)
+    {
+        int minuteOfDay = (i * 1440 / alarmCount + 7) % 1440;
+        snprintf(entry, sizeof(entry), "%s{\"active\":true,\"hour\":%d,\"id\":\"sim%d\",\"minute\":%d}",
+                 i > 0 ? "," : "", minuteOfDay / 60, i, minuteOfDay % 60);
+        json += entry;
+    }
+    json += "]";
+    return json;
+}
+
+// Times parseAlarmList and Counts the Heap it Uses Once its Set is Warmed Up
+int benchParser()
+{
+    const int SIZES[] = {10, 100, 1000};
+    const int RUNS = 2000;
+
+    printf("Alarms   Bytes  Parse(us)  Allocations  Peak heap(B)\n");
+    for (int size : SIZES)
+    {
+        String json = alarmListJson(size);
+        AlarmSet set;
+        parseAlarmList(json.c_str(), json.length(), set); // First parse sizes the set
+
+        heapAllocations = 0;
+        heapPeak = heapLive;
+        size_t heapBefore = heapLive;
+
+        auto started = std::chrono::steady_clock::now();
+        for (int run = 0; run < RUNS; run++)
+        {
+            if (!parseAlarmList(json.c_str(), json.length(), set))
+            {
+                printf("Payload with %d alarms didn't parse\n", size);
+                return 1;
+            }
+        }
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() / RUNS;
+
+        printf("%6d  %6u  %9.2f  %11zu  %12zu\n", size, json.length(), micros, heapAllocations / RUNS, heapPeak - heapBefore);
+    }
+    return 0;
+}
+
+// Blocking Loopback Connection, -1 if it Failed
+int connectLoopback(uint16_t port)
+{
+    int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (socket < 0 || connect(socket, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    timeval timeout = {0, 100000}; // Reads Give Up after 100ms so Clients Notice the End of the Run
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return socket;
+}
+
+// Reads One HTTP Response, Leaves Whatever Came after it in pending, Returns the Status (-1 if the Connection Ended)
+int readResponse(int socket, std::string &pending)
+{
+    for (int waits = 0; waits < 50;)
+    {
+        size_t blank = pending.find("\r\n\r\n");
+        if (blank != std::string::npos)
+        {
+            size_t lengthAt = pending.find("Content-Length: ");
+            size_t length = lengthAt < blank ? strtoul(pending.c_str() + lengthAt + 16, nullptr, 10) : 0;
+            if (pending.size() >= blank + 4 + length)
+            {
+                int status = atoi(pending.c_str() + 9);
+                pending.erase(0, blank + 4 + length);
+                return status;
+            }
+        }
+
+        char buffer[4096];
+        ssize_t got = recv(socket, buffer, sizeof(buffer), 0);
+        if (got == 0)
+        {
+            return -1;
+        }
+        if (got < 0)
+        {
+            waits++;
+            continue;
+        }
+        pending.append(buffer, got);
+    }
+    return -1;
+}
+
+// One Keep-Alive Client, Every Fourth Request Reads the State or the Ringtones and the Rest Edit One of Eight Alarms
+void lanClient(uint16_t port, int client, int requests, std::vector<double> &latencies, std::atomic<int> &failures)
+{
+    int socket = connectLoopback(port);
+    if (socket < 0)
+    {
+        failures += requests;
+        return;
+    }
+
+    std::string pending;
+    for (int i = 0; i < requests; i++)
+    {
+        char request[256];
+        if (i % 4 == 3)
+        {
+            snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: clock\r\n\r\n", i % 8 == 3 ? "/state" : "/ringtones");
+        }
+        else
+        {
+            char body[96];
+            int length = snprintf(body, sizeof(body), "{\"id\":\"lan%d\",\"hour\":%d,\"minute\":%d,\"days\":127,\"active\":true,\"sound\":\"gentle\"}",
+                                  client, (i / 60) % 24, i % 60);
+            snprintf(request, sizeof(request), "PUT /alarms/lan%dx%d HTTP/1.1\r\nHost: clock\r\nContent-Length: %d\r\n\r\n%s",
+                     client, i % 8, length, body);
+        }
+
+        auto sent = std::chrono::steady_clock::now();
+        if (send(socket, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request) || readResponse(socket, pending) != 200)
+        {
+            failures++;
+            continue;
+        }
+        latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+    }
+    close(socket);
+}
+
+// Edits of Alarms the App Keeps as an Array, Returns how Many Answers weren't the Expected Status
+int arrayClient(uint16_t port)
+{
+    struct Step {
+        const char *request; // Method and Path
+        const char *body;
+        int status;
+    };
+    const Step STEPS[] = {
+        {"GET /alarms/0", "", 200},
+        {"PATCH /alarms/1", "{\"minute\":40}", 200},
+        {"DELETE /alarms/0", "", 200},
+        {"PUT /alarms/2", "{\"hour\":9,\"minute\":0,\"id\":\"array2\"}", 200},
+        {"PUT /alarms/9", "{\"hour\":9,\"minute\":0,\"id\":\"array9\"}", 400}, // Past the End
+        {"PUT /alarms/03", "{\"hour\":9,\"minute\":0,\"id\":\"array3\"}", 400}, // Not an Index Firebase Writes
+    };
+
+    int socket = connectLoopback(port);
+    if (socket < 0)
+    {
+        return sizeof(STEPS) / sizeof(STEPS[0]);
+    }
+
+    int wrong = 0;
+    std::string pending;
+    for (const Step &step : STEPS)
+    {
+        char request[256];
+        snprintf(request, sizeof(request), "%s HTTP/1.1\r\nHost: clock\r\nContent-Length: %zu\r\n\r\n%s", step.request,
+                 strlen(step.body), step.body);
+        if (send(socket, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request) ||
+            readResponse(socket, pending) != step.status)
+        {
+            wrong++;
+        }
+    }
+    close(socket);
+    return wrong;
+}
+
+// Content-Lengths that Don't Parse or Don't Fit, Each on its Own Connection since it's Closed after
+// Returns how Many weren't Refused with the Expected Status
+int badLengthClient(uint16_t port)
+{
+    struct Step {
+        const char *length;
+        int status;
+    };
+    const Step STEPS[] = {
+        {"18446744073709551615", 413}, // Wraps a size_t when Added to the Head
+        {"4294967295", 413},           // Wraps on the 32-Bit Device
+        {"12abc", 400},
+        {"-1", 400},
+    };
+
+    int wrong = 0;
+    for (const Step &step : STEPS)
+    {
+        int socket = connectLoopback(port);
+        char request[128];
+        snprintf(request, sizeof(request), "PUT /volume HTTP/1.1\r\nHost: clock\r\nContent-Length: %s\r\n\r\n{}", step.length);
+        std::string pending;
+        if (socket < 0 || send(socket, request, strlen(request), MSG_NOSIGNAL) != (ssize_t)strlen(request) ||
+            readResponse(socket, pending) != step.status)
+        {
+            wrong++;
+        }
+        if (socket >= 0)
+        {
+            close(socket);
+        }
+    }
+    return wrong;
+}
+
+// Event Socket, Checks the Handshake against RFC 6455's Example Key then Counts Frames until done
+void eventClient(uint16_t port, std::atomic<bool> &done, bool &accepted, uint32_t &frames)
+{
+    int socket = connectLoopback(port);
+    const char *upgrade = "GET /events HTTP/1.1\r\nHost: clock\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    if (socket < 0 || send(socket, upgrade, strlen(upgrade), MSG_NOSIGNAL) < 0)
+    {
+        return;
+    }
+
+    std::string pending;
+    while (!done && pending.find("\r\n\r\n") == std::string::npos)
+    {
+        char buffer[512];
+        ssize_t got = recv(socket, buffer, sizeof(buffer), 0);
+        if (got == 0)
+        {
+            close(socket);
+            return;
+        }
+        if (got > 0)
+        {
+            pending.append(buffer, got);
+        }
+    }
+    accepted = pending.compare(0, 12, "HTTP/1.1 101") == 0 && pending.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos;
+    pending.erase(0, pending.find("\r\n\r\n") + 4);
+
+    // Server Frames are Unmasked, with a 7 or 16 Bit Length
+    while (!done)
+    {
+        while (pending.size() >= 2)
+        {
+            size_t length = (uint8_t)pending[1] & 0x7F;
+            size_t head = 2;
+            if (length == 126)
+            {
+                if (pending.size() < 4)
+                {
+                    break;
+                }
+                length = ((uint8_t)pending[2] << 8) | (uint8_t)pending[3];
+                head = 4;
+            }
+            if (pending.size() < head + length)
+            {
+                break;
+            }
+            frames++;
+            pending.erase(0, head + length);
+        }
+
+        char buffer[4096];
+        ssize_t got = recv(socket, buffer, sizeof(buffer), 0);
+        if (got == 0)
+        {
+            break;
+        }
+        if (got > 0)
+        {
+            pending.append(buffer, got);
+        }
+    }
+
+    const uint8_t closeFrame[] = {0x88, 0x80, 0, 0, 0, 0}; // Masked with Zeros, no Status
+    send(socket, closeFrame, sizeof(closeFrame), MSG_NOSIGNAL);
+    close(socket);
+}
+
+const uint16_t HOUSE_BASE_PORT = 43990;
+const int64_t MAX_HOUSE_SKEW = 50000; // Microseconds Clocks may Start or Stop a Shared Ring Apart
+
+// One Clock of the Simulated House, True Time is its Timer (they all Power on Together)
+struct HouseClock {
+    FakeClock clock;
+    FakeLcd lcd;
+    FakeAudio audio;
+    FakeButtons buttons;
+    FakeStorage storage;
+    FakeCloud cloud;
+    LoopbackLan lan;
+    LoopbackPeers peers;
+    Hal hal;
+    Alarm alarm;
+
+    bool ntp = true;      // Off Runs it on the DS1302 Alone
+    int64_t ntpError = 0; // What its NTP Replies Get Wrong
+    unsigned long nextNtpAt = 0;
+    int64_t lastRingStart = 0;
+    int64_t lastStop = 0;
+    std::vector<int64_t> starts; // True Microseconds of Every Ring Start
+    std::vector<int64_t> stops;
+
+    HouseClock(int index, int groupSize)
+        : audio(clock), buttons(clock), peers(index, groupSize, HOUSE_BASE_PORT),
+          hal{clock, lcd, audio, buttons, storage, cloud, lan, peers}, alarm(hal) {}
+};
+
+// Largest Gap between Clocks for Each Event, Events are Matched by Order
+std::vector<int64_t> houseSkews(std::vector<HouseClock *> &clocks, bool stops)
+{
+    std::vector<int64_t> skews;
+    for (size_t event = 0;; event++)
+    {
+        int64_t first = INT64_MAX;
+        int64_t last = INT64_MIN;
+        for (HouseClock *house : clocks)
+        {
+            std::vector<int64_t> &times = stops ? house->stops : house->starts;
+            if (event >= times.size())
+            {
+                return skews;
+            }
+            first = times[event] < first ? times[event] : first;
+            last = times[event] > last ? times[event] : last;
+        }
+        skews.push_back(last - first);
+    }
+}
+
+// Shared Alarms Ringing on Several Clocks over Loopback UDP
+int simulateHouse(int clockCount, int hours, bool shared, bool mixed)
+{
+    const int64_t NTP_ERRORS[] = {0, 35000, 0, -40000}; // Third Clock has no NTP
+    clockCount = clockCount < 2 ? 2 : (clockCount > HOUSE_PEERS ? HOUSE_PEERS : clockCount);
+    hours = hours < 1 ? 1 : hours;
+
+    uint32_t compiled = parseCompileTime(__DATE__, __TIME__);
+    uint32_t start = compiled - compiled % SECONDS_PER_DAY + SECONDS_PER_DAY;
+
+    // Daily Alarms every 20 Minutes, Shared by Every Clock through the Same Firebase List
+    // The odd clock's list has the same keys, with every third alarm moved from :45 to :55
+    const int ODD_CLOCK = 1;
+    int alarmCount = hours * 3 < MAX_ALARMS ? hours * 3 : MAX_ALARMS;
+    String json = "[";
+    String oddJson = "[";
+    for (int i = 0; i < alarmCount; i++)
+    {
+        char entry[96];
+        snprintf(entry, sizeof(entry), "%s{\"active\":true,\"hour\":%d,\"id\":\"house%d\",\"minute\":%d}",
+                 i > 0 ? "," : "", i / 3, i, 5 + (i % 3) * 20);
+        json += entry;
+        snprintf(entry, sizeof(entry), "%s{\"active\":true,\"hour\":%d,\"id\":\"house%d\",\"minute\":%d}",
+                 i > 0 ? "," : "", i / 3, i, i % 3 == 2 ? 55 : 5 + (i % 3) * 20);
+        oddJson += entry;
+    }
+    json += "]";
+    oddJson += "]";
+
+    std::vector<HouseClock *> clocks;
+    for (int i = 0; i < clockCount; i++)
+    {
+        HouseClock *house = new HouseClock(i, shared ? clockCount : 0);
+        house->ntp = i % 4 != 2;
+        house->ntpError = NTP_ERRORS[i % 4];
+        house->clock.writeRtc(house->ntp ? start : start - 2);
+        house->alarm.initAll();
+        house->cloud.publishAlarmJson(mixed && i == ODD_CLOCK ? oddJson : json);
+        clocks.push_back(house);
+    }
+
+    // Always Runs the Clock Furthest Behind, so a Message is Never Read before it was Sent
+    auto wallStart = std::chrono::steady_clock::now();
+    int64_t endAt = (int64_t)hours * 3600 * 1000000;
+    uint32_t loops = 0;
+    int presses = 0;
+    while (true)
+    {
+        HouseClock *house = clocks[0];
+        for (HouseClock *other : clocks)
+        {
+            house = other->clock.micros() < house->clock.micros() ? other : house;
+        }
+        if (house->clock.micros() >= endAt)
+        {
+            break;
+        }
+
+        if (house->ntp && house->clock.millis() >= house->nextNtpAt)
+        {
+            NtpSample sample;
+            sample.takenAt = house->clock.micros();
+            sample.epochMicros = (int64_t)start * 1000000 + sample.takenAt + house->ntpError;
+            sample.roundTrip = NTP_ROUND_TRIP;
+            house->cloud.publishNtp(sample);
+            house->nextNtpAt = house->clock.millis() + NTP_EVERY;
+        }
+
+        house->alarm.updateAll();
+        loops++;
+
+        FakeAudio &audio = house->audio;
+        if (audio.ringStartedAt != house->lastRingStart)
+        {
+            house->lastRingStart = audio.ringStartedAt;
+            house->starts.push_back(audio.ringStartedAt);
+        }
+        if (audio.stoppedAt != house->lastStop && !house->starts.empty())
+        {
+            house->lastStop = audio.stoppedAt;
+            house->stops.push_back(audio.stoppedAt);
+        }
+
+        // Even Rings are Dismissed a few Seconds in, each Time on the Next Clock, Odd Ones Time Out
+        size_t ring = house->starts.size() - 1;
+        int index = std::find(clocks.begin(), clocks.end(), house) - clocks.begin();
+        if (house->buttons.isPressed(STOP_PIN))
+        {
+            house->buttons.release(STOP_PIN);
+        }
+        else if (!audio.stopped && ring % 2 == 0 && (int)(ring / 2 % clockCount) == index &&
+                 house->clock.micros() - audio.ringStartedAt > (int64_t)PRESS_AFTER * 1000 && presses <= (int)ring / 2)
+        {
+            house->buttons.press(STOP_PIN);
+            presses++;
+        }
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+
+    printf("Simulated %d hour(s) with %d clocks, house sync %s\n", hours, clockCount, shared ? "on" : "off");
+    printf("Clock  Time from         Rings  Stops  Clock error\n");
+    bool missed = false;
+    for (int i = 0; i < clockCount; i++)
+    {
+        HouseClock *house = clocks[i];
+        int64_t error = house->alarm.rtc->getEpochMicros() - ((int64_t)start * 1000000 + house->clock.micros());
+        char source[24];
+        snprintf(source, sizeof(source), house->ntp ? "NTP %+.0fms" : "DS1302 alone", house->ntpError / 1000.0);
+        printf("%5d  %-16s  %5zu  %5zu  %+9.1f ms\n", i, source, house->starts.size(), house->stops.size(), error / 1000.0);
+        missed |= house->starts.size() != (size_t)alarmCount;
+    }
+
+    // Rings the Odd Clock Started more than 10s from an Alarm Time on its Own List
+    int strayRings = 0;
+    if (mixed)
+    {
+        for (int64_t ringAt : clocks[ODD_CLOCK]->starts)
+        {
+            int64_t second = ringAt / 1000000 % 3600;
+            bool ownTime = false;
+            for (int minute : {5, 25, 55})
+            {
+                ownTime |= second > minute * 60 - 10 && second < minute * 60 + 10;
+            }
+            strayRings += ownTime ? 0 : 1;
+        }
+        printf("Clock %d rang %d alarm(s) at a time its own list doesn't have\n", ODD_CLOCK, strayRings);
+    }
+
+    // Skews are Measured across the Clocks with the Same List
+    std::vector<HouseClock *> sameList;
+    for (int i = 0; i < clockCount; i++)
+    {
+        if (!mixed || i != ODD_CLOCK)
+        {
+            sameList.push_back(clocks[i]);
+        }
+    }
+    std::vector<int64_t> startSkews = houseSkews(sameList, false);
+    std::vector<int64_t> stopSkews = houseSkews(sameList, true);
+    int64_t worstStart = startSkews.empty() ? 0 : *std::max_element(startSkews.begin(), startSkews.end());
+    int64_t worstStop = stopSkews.empty() ? 0 : *std::max_element(stopSkews.begin(), stopSkews.end());
+    std::sort(startSkews.begin(), startSkews.end());
+    std::sort(stopSkews.begin(), stopSkews.end());
+    printf("Start skew:      p50 %.1f ms, max %.1f ms over %zu rings\n",
+           startSkews.empty() ? 0 : startSkews[startSkews.size() / 2] / 1000.0, worstStart / 1000.0, startSkews.size());
+    printf("Stop skew:       p50 %.1f ms, max %.1f ms (%d dismissed on one clock)\n",
+           stopSkews.empty() ? 0 : stopSkews[stopSkews.size() / 2] / 1000.0, worstStop / 1000.0, presses);
+    printf("Wall time:       %.1f ms, %u loop iterations\n", wallMs, loops);
+
+    Serial.enabled = true;
+    for (int i = 0; i < clockCount; i++)
+    {
+        printf("Clock %d ", i);
+        clocks[i]->alarm.houseSync->printStats();
+    }
+    for (HouseClock *house : clocks)
+    {
+        delete house;
+    }
+
+    bool tooFar = worstStart > MAX_HOUSE_SKEW || worstStop > MAX_HOUSE_SKEW;
+    if (missed)
+    {
+        printf("A clock missed a ring (expected %d each)\n", alarmCount);
+    }
+    if (tooFar && shared)
+    {
+        printf("Clocks were more than %lld ms apart\n", (long long)MAX_HOUSE_SKEW / 1000);
+    }
+    return missed || strayRings > 0 || (tooFar && shared) ? 1 : 0;
+}
+
+// Requests per Second and Edit Round Trips against the LAN API on a Loopback Socket
+int benchLan(int requests, int clientCount)
+{
+    clientCount = clientCount < 1 ? 1 : (clientCount > LAN_CONNECTIONS - 1 ? LAN_CONNECTIONS - 1 : clientCount); // One Connection is the Event Socket
+
+    FakeClock clock;
+    FakeLcd lcd;
+    FakeAudio audio(clock);
+    FakeButtons buttons(clock);
+    FakeStorage storage;
+    FakeCloud cloud;
+    LoopbackLan lan;
+    lan.enabled = true;
+    LoopbackPeers peers;
+    Hal hal = {clock, lcd, audio, buttons, storage, cloud, lan, peers};
+
+    uint32_t compiled = parseCompileTime(__DATE__, __TIME__);
+    clock.writeRtc(compiled - compiled % SECONDS_PER_DAY + SECONDS_PER_DAY);
+
+    Alarm alarm(hal);
+    alarm.initAll();
+    if (lan.boundPort == 0)
+    {
+        return 1;
+    }
+
+    // Two Alarms the App Made, Kept as an Array like Firebase Returns Them
+    cloud.publishAlarmJson("[{\"hour\":7,\"minute\":0,\"id\":\"array0\"},{\"hour\":8,\"minute\":0,\"id\":\"array1\"}]");
+    alarm.updateAll();
+
+    std::atomic<bool> done{false};
+    std::atomic<int> finished{0};
+    std::atomic<int> failures{0};
+    bool accepted = false;
+    uint32_t frames = 0;
+    std::vector<std::vector<double>> latencies(clientCount);
+
+    std::thread events(eventClient, lan.boundPort, std::ref(done), std::ref(accepted), std::ref(frames));
+    std::vector<std::thread> clients;
+    for (int i = 0; i < clientCount; i++)
+    {
+        clients.emplace_back([&, i]() {
+            lanClient(lan.boundPort, i, requests / clientCount, latencies[i], failures);
+            finished++;
+        });
+    }
+
+    // Virtual Time Kept to Real Time, so the Loop Polls the Socket as Often as on the Device
+    auto wallStart = std::chrono::steady_clock::now();
+    int64_t clockStart = clock.micros();
+    while (finished < clientCount)
+    {
+        alarm.updateAll();
+        std::this_thread::sleep_until(wallStart + std::chrono::microseconds(clock.micros() - clockStart));
+    }
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+
+    // Array Alarms are Read, Edited and Deleted by Index, a New One only Goes on the End
+    std::atomic<int> arrayWrong{-1};
+    std::atomic<int> lengthsWrong{0};
+    std::thread array([&]() {
+        lengthsWrong = badLengthClient(lan.boundPort);
+        arrayWrong = arrayClient(lan.boundPort);
+    });
+    while (arrayWrong < 0)
+    {
+        alarm.updateAll();
+        std::this_thread::sleep_until(wallStart + std::chrono::microseconds(clock.micros() - clockStart));
+    }
+    array.join();
+
+    // A Few More Loops so the Last Pushes Go Out
+    unsigned long drainUntil = clock.millis() + 200;
+    while (clock.millis() < drainUntil)
+    {
+        alarm.updateAll();
+        std::this_thread::sleep_until(wallStart + std::chrono::microseconds(clock.micros() - clockStart));
+    }
+    done = true;
+    for (std::thread &client : clients)
+    {
+        client.join();
+    }
+    events.join();
+
+    // Firebase now Holds what the Edits Wrote Back, so a Full Sync from it must Keep Every One
+    size_t writtenBack = cloud.written.size();
+    bool synced = cloud.publishAlarmJson(cloud.writtenJson());
+    for (int i = 0; i < 10; i++)
+    {
+        alarm.updateAll();
+    }
+
+    std::vector<double> all;
+    for (std::vector<double> &client : latencies)
+    {
+        all.insert(all.end(), client.begin(), client.end());
+    }
+    std::sort(all.begin(), all.end());
+    double p50 = all.empty() ? 0 : all[all.size() / 2];
+    double p99 = all.empty() ? 0 : all[all.size() * 99 / 100];
+    double worst = all.empty() ? 0 : all.back();
+
+    // Every Alarm a Client Edited is in the Table, and so in the Calendar, with the Sound it Named
+    int missing = 0;
+    for (int client = 0; client < clientCount; client++)
+    {
+        for (int i = 0; i < 8 && i < requests / clientCount; i++)
+        {
+            if (i % 4 == 3)
+            {
+                continue; // Requests that Read the State or Ringtones
+            }
+            char key[24];
+            snprintf(key, sizeof(key), "lan%dx%d", client, i);
+            int slot = alarm.getAlarms().find(key);
+            missing += slot < 0 || alarm.getAlarms()[slot].sound != 1 ? 1 : 0;
+        }
+    }
+
+    printf("LAN API over loopback, %d clients on keep-alive connections\n", clientCount);
+    printf("Requests:        %zu ok, %d failed, %.0f per second\n", all.size(), failures.load(), all.size() / (wallMs / 1000));
+    printf("Round trip:      p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", p50, p99, worst);
+    printf("Edit to armed:   p50 %u us, p99 %u us on the device side\n",
+           alarm.localApi->editToArmed.percentile(50), alarm.localApi->editToArmed.percentile(99));
+    printf("Event socket:    handshake %s, %u frames pushed\n", accepted ? "ok" : "FAILED", frames);
+    printf("Written back:    %zu alarms, full sync from them %s\n", writtenBack, synced ? "applied" : "FAILED to parse");
+    printf("Edited alarms:   %d missing from the table or with the wrong sound\n", missing);
+
+    // After the Sync, Index 0 is Gone, 1 Kept its New Minute and 2 was Added
+    AlarmTable &alarms = alarm.getAlarms();
+    bool arrayKept = alarms.find("0") < 0 && alarms.find("1") >= 0 && alarms[alarms.find("1")].minute == 40 &&
+                     alarms.find("2") >= 0;
+    printf("Bad lengths:     %d not refused as expected\n", lengthsWrong.load());
+    printf("Array alarms:    %d answers not as expected, edits %s after the sync\n", arrayWrong.load(),
+           arrayKept ? "kept" : "LOST");
+    Serial.enabled = true;
+    alarm.localApi->printStats();
+
+    return failures == 0 && missing == 0 && arrayWrong == 0 && lengthsWrong == 0 && arrayKept && synced && accepted && frames > 1 && p99 < 100 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "parse") == 0)
+    {
+        return benchParser();
+    }
+
+    if (argc > 1 && strcmp(argv[1], "house") == 0)
+    {
+        Serial.enabled = false;
+        bool shared = !(argc > 4 && strcmp(argv[4], "-n") == 0);
+        bool mixed = argc > 4 && strcmp(argv[4], "-m") == 0;
+        return simulateHouse(argc > 2 ? atoi(argv[2]) : 3, argc > 3 ? atoi(argv[3]) : 3, shared, mixed);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "lan") == 0)
+    {
+        Serial.enabled = false;
+        return benchLan(argc > 2 ? atoi(argv[2]) : 600, argc > 3 ? atoi(argv[3]) : 3);
+    }
+
+    if (argc > 2 && strcmp(argv[1], "scenario") == 0)
+    {
+        bool sleep = true;
+        Serial.enabled = false;
+        for (int i = 3; i < argc; i++)
+        {
+            Serial.enabled |= strcmp(argv[i], "-v") == 0;
+            sleep &= strcmp(argv[i], "-a") != 0;
+        }
+
+        uint32_t compiled = parseCompileTime(__DATE__, __TIME__);
+        Scenario scenario;
+        if (!loadScenario(argv[2], compiled - compiled % SECONDS_PER_DAY + SECONDS_PER_DAY, scenario))
+        {
+            return 2;
+        }
+        return runScenario(scenario, sleep);
+    }
+
+    int alarmCount = argc > 1 ? atoi(argv[1]) : 10;
+    int days = argc > 2 ? atoi(argv[2]) : 1;
+    bool sleep = false;
+    bool drift = false;
+    Serial.enabled = false;
+    for (int i = 3; i < argc; i++)
+    {
+        Serial.enabled |= strcmp(argv[i], "-v") == 0;
+        sleep |= strcmp(argv[i], "-s") == 0;
+        drift |= strcmp(argv[i], "-d") == 0;
+    }
+
+    FakeClock clock;
+    FakeLcd lcd;
+    FakeAudio audio(clock);
+    FakeButtons buttons(clock);
+    FakeStorage storage;
+    FakeCloud cloud;
+    LoopbackLan lan;
+    LoopbackPeers peers;
+    Hal hal = {clock, lcd, audio, buttons, storage, cloud, lan, peers};
+
+    // Start the RTC at the Midnight after the Build, so it's Newer than Compile Time
+    uint32_t compiled = parseCompileTime(__DATE__, __TIME__);
+    uint32_t start = compiled - compiled % SECONDS_PER_DAY + SECONDS_PER_DAY;
+    clock.writeRtc(start);
+    clock.rtcDriftPpm = drift ? DRIFTING_RTC_PPM : 0;
+
+    Alarm alarm(hal);
+    alarm.initAll();
+    alarm.power->setSleep(sleep);
+
+    cloud.publishAlarmJson(alarmListJson(alarmCount));
+
+    unsigned long endAt = clock.millis() + (unsigned long)days * SECONDS_PER_DAY * 1000;
+    unsigned long ringingSince = 0;
+    uint32_t loops = 0;
+    uint32_t stopPresses = 0;
+
+    // NTP Replies, True Time is the Fake Timer since the RTC was Set
+    unsigned long nextNtpAt = 0;
+    unsigned long ntpUntil = drift ? SECONDS_PER_DAY * 1000UL : endAt;
+    uint32_t ntpReplies = 0;
+    int64_t maxClockError = 0;
+
+    auto wallStart = std::chrono::steady_clock::now();
+
+    while (clock.millis() < endAt)
+    {
+        if (clock.millis() >= nextNtpAt && clock.millis() < ntpUntil)
+        {
+            NtpSample sample;
+            sample.takenAt = clock.micros();
+            sample.epochMicros = (int64_t)start * 1000000 + sample.takenAt;
+            sample.roundTrip = NTP_ROUND_TRIP;
+            cloud.publishNtp(sample);
+            ntpReplies++;
+            nextNtpAt = clock.millis() + NTP_EVERY;
+        }
+
+        alarm.updateAll();
+        loops++;
+
+        if (alarm.rtc->isNtpFresh() || ntpReplies > 0)
+        {
+            int64_t error = alarm.rtc->getEpochMicros() - ((int64_t)start * 1000000 + clock.micros());
+            error = error < 0 ? -error : error;
+            maxClockError = error > maxClockError ? error : maxClockError;
+        }
+
+        // Press Stop a Few Seconds into Each Ring, Release it on the Next Loop
+        if (buttons.isPressed(STOP_PIN))
+        {
+            buttons.release(STOP_PIN);
+        }
+        else if (audio.stopped)
+        {
+            ringingSince = 0;
+        }
+        else if (ringingSince == 0)
+        {
+            ringingSince = clock.millis();
+        }
+        else if (clock.millis() - ringingSince > PRESS_AFTER)
+        {
+            buttons.press(STOP_PIN);
+            stopPresses++;
+            ringingSince = 0;
+        }
+    }
+
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+
+    // Every Daily Alarm that Fits the Table Once per Day (the Alarm Set Replaces the Startup Alarm before it Rings)
+    uint32_t expected = (uint32_t)(alarmCount < MAX_ALARMS ? alarmCount : MAX_ALARMS) * days;
+
+    printf("Simulated %d day(s) with %d daily alarms\n", days, alarmCount);
+    printf("Alarms fired:    %u (expected %u)\n", audio.plays, expected);
+    printf("Tracks played:   %u, %u volume commands, loudest %u\n", audio.tracks, audio.volumeCommands, audio.loudest);
+    printf("Stop presses:    %u (press to stop p99 %u us)\n", stopPresses, alarm.stopLatency.percentile(99));
+    printf("Alarm lateness:  p99 %u ms, max %u ms\n", alarm.fireLateness.percentile(99), alarm.fireLateness.getMax());
+    printf("Loop iterations: %u\n", loops);
+    printf("LCD writes:      %u\n", lcd.writes);
+    printf("DS1302 reads:    %u\n", clock.rtcReads);
+    printf("NTP replies:     %u, clock off by at most %.1f ms\n", ntpReplies, maxClockError / 1000.0);
+    printf("Flash writes:    %u\n", storage.writes);
+    printf("Cloud updates:   %u (%zu bytes), last %s\n", cloud.updates, cloud.updateBytes, cloud.lastUpdate.c_str());
+    printf("Wall time:       %.1f ms (%.2f us per loop, %.0f loops/s, %.0fx real time)\n",
+           wallMs, wallMs * 1000 / loops, loops / (wallMs / 1000), (double)days * SECONDS_PER_DAY * 1000 / wallMs);
+
+    // Per-Task Timing, Measured in Real Time on this Machine
+    Serial.enabled = true;
+    alarm.scheduler.printStats();
+    alarm.uplink.printStats();
+    alarm.power->printStats(); // Simulated time only moves while idle, so only wakeups/min means anything here
+    alarm.rtc->printClock();
+    logger.printStats();
+
+    bool late = sleep && alarm.fireLateness.getMax() > MAX_LATE_MS;
+    if (late)
+    {
+        printf("Light sleep made an alarm %u ms late\n", alarm.fireLateness.getMax());
+    }
+    bool offTime = maxClockError > MAX_CLOCK_ERROR;
+    if (offTime)
+    {
+        printf("Software clock was %.1f ms off\n", maxClockError / 1000.0);
+    }
+    return audio.plays == expected && !late && !offTime ? 0 : 1;
+}